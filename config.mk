@@ -16,6 +16,7 @@ CFLAGS=\
 	-I/usr/$(TOOLCHAIN)/include\
 	-I/usr/$(TOOLCHAIN)/include/libxml2\
 	-O2\
+	-fno-trapping-math\
 	-pedantic-errors\
 	-std=c99\
 	-Wall\
@@ -26,3 +27,4 @@ SRCS=\
 	$(wildcard src/tmx/*.c)\
 	$(wildcard src/inih/*.c)
 OBJS=$(patsubst %.c, %.o, $(SRCS))
+MAPS=$(patsubst %.tmx, %.tmb, $(wildcard res/maps/*.tmx))
@@ -0,0 +1,352 @@
+/** @file archive.c
+ * @ingroup   Archive
+ * @defgroup  Archive
+ * @brief     Read-only asset archive.  All files under res/ are packed into a
+ *            single file by tools/pack.c, which is mapped into memory at
+ *            startup.  Files are served directly from the mapping without
+ *            opening or copying anything.
+ *
+ *            File layout, all values little-endian:
+ *            - header: "RJPK", version, number of entries, size of the index
+ *            - index entries sorted by path hash
+ *            - NUL-terminated paths, relative to the working directory
+ *            - file data, every file aligned to ARCHIVE_ALIGN bytes
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "archive.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static Archive *archive;
+
+/**
+ * @brief   Read a little-endian 32-bit value.
+ * @param   data pointer to the value.
+ * @return  The value.
+ * @ingroup Archive
+ */
+static uint32_t archiveRead32(const uint8_t *data)
+{
+    return
+        (uint32_t)data[0]         |
+        ((uint32_t)data[1] <<  8) |
+        ((uint32_t)data[2] << 16) |
+        ((uint32_t)data[3] << 24);
+}
+
+/**
+ * @brief   Map a file into memory.  On Windows, the file is read instead.
+ * @param   filename the file to map.
+ * @param   size     the size of the file.
+ * @return  The mapped file on success, NULL on error.
+ * @ingroup Archive
+ */
+static const uint8_t *archiveMap(const char *filename, size_t *size)
+{
+#ifdef _WIN32
+    FILE *file = fopen(filename, "rb");
+    if (NULL == file)
+    {
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    *size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    uint8_t *data = malloc(*size);
+    if ((NULL == data) || (*size != fread(data, 1, *size, file)))
+    {
+        free(data);
+        data = NULL;
+    }
+    fclose(file);
+
+    return data;
+#else
+    struct stat info;
+    void        *data;
+
+    int fd = open(filename, O_RDONLY);
+    if (-1 == fd)
+    {
+        return NULL;
+    }
+
+    if ((0 != fstat(fd, &info)) || (0 == info.st_size))
+    {
+        close(fd);
+        return NULL;
+    }
+    *size = info.st_size;
+
+    data = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (MAP_FAILED == data)
+    {
+        return NULL;
+    }
+
+    return data;
+#endif
+}
+
+/**
+ * @brief   Unmap a file mapped by archiveMap().
+ * @param   data the mapped file.
+ * @param   size the size of the file.
+ * @ingroup Archive
+ */
+static void archiveUnmap(const uint8_t *data, size_t size)
+{
+#ifdef _WIN32
+    (void)size;
+    free((void*)data);
+#else
+    munmap((void*)data, size);
+#endif
+}
+
+/**
+ * @brief   Look up a file in the mounted archive.
+ * @param   path path to the file.  Paths are normalised, e.g.
+ *               "res/maps/../tilesets/tileset.tsx" is found as
+ *               "res/tilesets/tileset.tsx".
+ * @param   size the size of the file.
+ * @return  The file data on success, NULL if no archive is mounted or the
+ *          file isn't archived.
+ * @ingroup Archive
+ */
+const void *archiveFind(const char *path, size_t *size)
+{
+    char name[256];
+
+    if ((NULL == archive) || (-1 == archiveNormalise(path, name, sizeof(name))))
+    {
+        return NULL;
+    }
+
+    // Find the first entry with a matching hash.
+    uint32_t hash  = archiveHash(name);
+    uint32_t first = 0;
+    uint32_t last  = archive->numEntries;
+    while (first < last)
+    {
+        uint32_t middle = first + (last - first) / 2;
+        if (archiveRead32(archive->index + middle * ARCHIVE_ENTRY_SIZE) < hash)
+        {
+            first = middle + 1;
+        }
+        else
+        {
+            last = middle;
+        }
+    }
+
+    for (uint32_t i = first; i < archive->numEntries; i++)
+    {
+        const uint8_t *entry = archive->index + i * ARCHIVE_ENTRY_SIZE;
+        if (archiveRead32(entry) != hash)
+        {
+            break;
+        }
+
+        if (0 == strcmp(name, (const char*)archive->data + archiveRead32(entry + 4)))
+        {
+            *size = archiveRead32(entry + 12);
+            return archive->data + archiveRead32(entry + 8);
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief   Hash a normalised path.
+ * @param   path the path.
+ * @return  32-bit FNV-1a hash of the path.
+ * @ingroup Archive
+ */
+uint32_t archiveHash(const char *path)
+{
+    uint32_t hash = 0x811c9dc5;
+
+    while (*path)
+    {
+        hash ^= (uint8_t)*path++;
+        hash *= 0x01000193;
+    }
+
+    return hash;
+}
+
+/**
+ * @brief   Mount an archive.  Files which are not found in it are still read
+ *          from disk.
+ * @param   filename the archive file.
+ * @return  0 on success, 1 if the archive doesn't exist, -1 on error.
+ * @ingroup Archive
+ */
+int8_t archiveMount(const char *filename)
+{
+    size_t        size = 0;
+    const uint8_t *data;
+
+    archiveUnmount();
+
+    data = archiveMap(filename, &size);
+    if (NULL == data)
+    {
+        return 1;
+    }
+
+    if ((size < ARCHIVE_HEADER_SIZE) ||
+        (0 != memcmp(data, "RJPK", 4)) ||
+        (ARCHIVE_VERSION != archiveRead32(data + 4)) ||
+        (size < ARCHIVE_HEADER_SIZE + (size_t)archiveRead32(data + 8) * ARCHIVE_ENTRY_SIZE))
+    {
+        fprintf(stderr, "archiveMount(): %s is not a valid archive.\n", filename);
+        archiveUnmap(data, size);
+        return -1;
+    }
+
+    // Every path and every file has to lie within the archive, so
+    // archiveFind() never reads past the mapping.
+    for (uint32_t i = 0; i < archiveRead32(data + 8); i++)
+    {
+        const uint8_t *entry     = data + ARCHIVE_HEADER_SIZE + (size_t)i * ARCHIVE_ENTRY_SIZE;
+        size_t        pathOffset = archiveRead32(entry + 4);
+        size_t        dataOffset = archiveRead32(entry + 8);
+        size_t        dataSize   = archiveRead32(entry + 12);
+
+        if ((pathOffset >= size) ||
+            (NULL == memchr(data + pathOffset, '\0', size - pathOffset)) ||
+            (dataOffset > size) ||
+            (dataSize > size - dataOffset))
+        {
+            fprintf(stderr, "archiveMount(): %s has an invalid index entry.\n", filename);
+            archiveUnmap(data, size);
+            return -1;
+        }
+    }
+
+    archive = malloc(sizeof(struct archive_t));
+    if (NULL == archive)
+    {
+        fprintf(stderr, "archiveMount(): error allocating memory.\n");
+        archiveUnmap(data, size);
+        return -1;
+    }
+
+    archive->data       = data;
+    archive->size       = size;
+    archive->numEntries = archiveRead32(data + 8);
+    archive->index      = data + ARCHIVE_HEADER_SIZE;
+
+    return 0;
+}
+
+/**
+ * @brief   Normalise a path: "." segments and duplicate separators are
+ *          removed and ".." segments are resolved.  Leading ".." segments
+ *          are kept, e.g. "../../x" stays "../../x".
+ * @param   path       the path.
+ * @param   buffer     buffer for the normalised path.
+ * @param   bufferSize size of the buffer.
+ * @return  0 on success, -1 if the path is too long.
+ * @ingroup Archive
+ */
+int8_t archiveNormalise(const char *path, char *buffer, size_t bufferSize)
+{
+    size_t length = 0;
+
+    while (*path)
+    {
+        size_t segment  = strcspn(path, "/\\");
+        size_t previous = length;
+
+        while ((previous > 0) && ('/' != buffer[previous - 1]))
+        {
+            previous--;
+        }
+
+        if ((2 == segment) && (0 == strncmp(path, "..", 2)) &&
+            (length > 0) && !((2 == length - previous) && (0 == strncmp(buffer + previous, "..", 2))))
+        {
+            // Drop the previous segment, unless it is a leading ".." itself.
+            length = (previous > 0) ? previous - 1 : 0;
+        }
+        else if ((segment > 0) && !((1 == segment) && ('.' == *path)))
+        {
+            if (length + segment + 2 > bufferSize)
+            {
+                return -1;
+            }
+
+            if (length > 0)
+            {
+                buffer[length++] = '/';
+            }
+            memcpy(buffer + length, path, segment);
+            length += segment;
+        }
+
+        path += segment;
+        if (*path)
+        {
+            path++;
+        }
+    }
+
+    buffer[length] = '\0';
+
+    return 0;
+}
+
+/**
+ * @brief   Open a file for reading.  Archived files are read from memory,
+ *          everything else from disk.
+ * @param   path path to the file.
+ * @return  SDL_RWops on success, NULL on error.
+ * @ingroup Archive
+ */
+SDL_RWops *archiveRW(const char *path)
+{
+    size_t     size;
+    const void *data = archiveFind(path, &size);
+
+    if (data)
+    {
+        return SDL_RWFromConstMem(data, size);
+    }
+
+    return SDL_RWFromFile(path, "rb");
+}
+
+/**
+ * @brief   Unmount the archive.  Everything loaded from it has to be freed
+ *          before.
+ * @ingroup Archive
+ */
+void archiveUnmount(void)
+{
+    if (NULL == archive)
+    {
+        return;
+    }
+
+    archiveUnmap(archive->data, archive->size);
+    free(archive);
+    archive = NULL;
+}
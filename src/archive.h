@@ -0,0 +1,60 @@
+/** @file archive.h
+ * @ingroup Archive
+ */
+
+#ifndef ARCHIVE_h
+#define ARCHIVE_h
+
+#include <SDL2/SDL.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @def     ARCHIVE_VERSION
+ *          File format version.
+ * @ingroup Archive
+ */
+#define ARCHIVE_VERSION 1
+
+/**
+ * @def     ARCHIVE_ALIGN
+ *          Alignment of the file data within the archive.
+ * @ingroup Archive
+ */
+#define ARCHIVE_ALIGN 16
+
+/**
+ * @def     ARCHIVE_HEADER_SIZE
+ *          Size of the archive header: magic, version, number of entries and
+ *          size of the index, each 32 bits.
+ * @ingroup Archive
+ */
+#define ARCHIVE_HEADER_SIZE 16
+
+/**
+ * @def     ARCHIVE_ENTRY_SIZE
+ *          Size of an index entry: path hash, path offset, data offset and
+ *          data size, each 32 bits.
+ * @ingroup Archive
+ */
+#define ARCHIVE_ENTRY_SIZE 16
+
+/**
+ * @ingroup Archive
+ */
+typedef struct archive_t
+{
+    const uint8_t *data;
+    size_t        size;
+    uint32_t      numEntries;
+    const uint8_t *index;
+} Archive;
+
+const void *archiveFind(const char *path, size_t *size);
+uint32_t   archiveHash(const char *path);
+int8_t     archiveMount(const char *filename);
+int8_t     archiveNormalise(const char *path, char *buffer, size_t bufferSize);
+SDL_RWops  *archiveRW(const char *path);
+void       archiveUnmount(void);
+
+#endif
@@ -0,0 +1,277 @@
+/** @file asset.c
+ * @ingroup   Asset
+ * @defgroup  Asset
+ * @brief     Asset cache.  Textures, sound effects and music are loaded once
+ *            per file and shared by everyone who requests the same path.
+ *            Every request has to be paired with assetRelease(); the asset
+ *            is freed with the last release.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <SDL2/SDL_image.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "archive.h"
+#include "asset.h"
+
+static Asset    *assets;
+static uint32_t numAssets;
+
+/**
+ * @brief   Free the data of an asset.
+ * @param   type the asset type.  See ASSET_TEXTURE etc.
+ * @param   data the texture, sound effect or music.
+ * @ingroup Asset
+ */
+static void assetDestroy(uint8_t type, void *data)
+{
+    switch (type)
+    {
+        case ASSET_TEXTURE:
+            SDL_DestroyTexture(data);
+            break;
+        case ASSET_SFX:
+            Mix_FreeChunk(data);
+            break;
+        default:
+            Mix_FreeMusic(data);
+            break;
+    }
+}
+
+/**
+ * @brief   Find a cached asset.
+ * @param   renderer SDL's rendering context, NULL for sounds and music.
+ * @param   path     path to the file.
+ * @param   type     the asset type.  See ASSET_TEXTURE etc.
+ * @return  The asset if cached, NULL otherwise.
+ * @ingroup Asset
+ */
+static Asset *assetFind(SDL_Renderer *renderer, const char *path, uint8_t type)
+{
+    for (uint32_t i = 0; i < numAssets; i++)
+    {
+        if ((assets[i].type == type) && (assets[i].renderer == renderer) && (0 == strcmp(path, assets[i].path)))
+        {
+            return &assets[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief   Add an asset to the cache with a reference count of one.
+ * @param   renderer SDL's rendering context, NULL for sounds and music.
+ * @param   path     path to the file.
+ * @param   type     the asset type.  See ASSET_TEXTURE etc.
+ * @return  The new cache entry with data set to NULL, NULL on error.
+ * @ingroup Asset
+ */
+static Asset *assetAppend(SDL_Renderer *renderer, const char *path, uint8_t type)
+{
+    Asset *cache = realloc(assets, (numAssets + 1) * sizeof(struct asset_t));
+    if (NULL == cache)
+    {
+        fprintf(stderr, "assetAppend(): error allocating memory.\n");
+        return NULL;
+    }
+    assets = cache;
+
+    Asset *asset = &assets[numAssets];
+    asset->path  = malloc(strlen(path) + 1);
+    if (NULL == asset->path)
+    {
+        fprintf(stderr, "assetAppend(): error allocating memory.\n");
+        return NULL;
+    }
+    strcpy(asset->path, path);
+
+    asset->type     = type;
+    asset->renderer = renderer;
+    asset->data     = NULL;
+    asset->refCount = 1;
+    numAssets++;
+
+    return asset;
+}
+
+/**
+ * @brief   Remove the last added asset from the cache, e.g. if it couldn't
+ *          be loaded.
+ * @ingroup Asset
+ */
+static void assetDropLast(void)
+{
+    numAssets--;
+    free(assets[numAssets].path);
+}
+
+/**
+ * @brief   Look up an asset or load it if it isn't cached yet.
+ * @param   renderer SDL's rendering context.  Only used for textures, which
+ *                   are cached per renderer.
+ * @param   path     path to the file.
+ * @param   type     the asset type.  See ASSET_TEXTURE etc.
+ * @return  The asset data on success, NULL on error.
+ * @ingroup Asset
+ */
+static void *assetGet(SDL_Renderer *renderer, const char *path, uint8_t type)
+{
+    Asset *asset = assetFind(renderer, path, type);
+    if (asset)
+    {
+        asset->refCount++;
+        return asset->data;
+    }
+
+    asset = assetAppend(renderer, path, type);
+    if (NULL == asset)
+    {
+        return NULL;
+    }
+
+    switch (type)
+    {
+        case ASSET_TEXTURE:
+            asset->data = IMG_LoadTexture_RW(renderer, archiveRW(path), 1);
+            if (NULL == asset->data)
+            {
+                fprintf(stderr, "%s\n", SDL_GetError());
+            }
+            break;
+        case ASSET_SFX:
+            asset->data = Mix_LoadWAV_RW(archiveRW(path), 1);
+            if (NULL == asset->data)
+            {
+                fprintf(stderr, "%s\n", Mix_GetError());
+            }
+            break;
+        default:
+            asset->data = Mix_LoadMUS_RW(archiveRW(path), 1);
+            if (NULL == asset->data)
+            {
+                fprintf(stderr, "%s\n", Mix_GetError());
+            }
+            break;
+    }
+
+    if (NULL == asset->data)
+    {
+        assetDropLast();
+        return NULL;
+    }
+
+    return asset->data;
+}
+
+/**
+ * @brief   Add an asset which has been loaded elsewhere, e.g. by the
+ *          asynchronous loader, to the cache.  The caller holds one
+ *          reference to the returned asset.
+ * @param   renderer SDL's rendering context, NULL for sounds and music.
+ * @param   path     path to the file.
+ * @param   type     the asset type.  See ASSET_TEXTURE etc.
+ * @param   data     the texture, sound effect or music.  The cache takes
+ *                   ownership.  If the path is already cached, data is freed.
+ * @return  The cached asset data on success, NULL on error.
+ * @ingroup Asset
+ */
+void *assetInsert(SDL_Renderer *renderer, const char *path, uint8_t type, void *data)
+{
+    Asset *asset = assetFind(renderer, path, type);
+    if (asset)
+    {
+        assetDestroy(type, data);
+        asset->refCount++;
+        return asset->data;
+    }
+
+    asset = assetAppend(renderer, path, type);
+    if (NULL == asset)
+    {
+        assetDestroy(type, data);
+        return NULL;
+    }
+    asset->data = data;
+
+    return data;
+}
+
+/**
+ * @brief   Get music.
+ * @param   path path to the music file.
+ * @return  Mix_Music on success, NULL on error.
+ * @ingroup Asset
+ */
+Mix_Music *assetMusic(const char *path)
+{
+    return assetGet(NULL, path, ASSET_MUSIC);
+}
+
+/**
+ * @brief   Release an asset.  It is freed when it has been released as often
+ *          as it has been requested.
+ * @param   data the texture, sound effect or music.  May be NULL.
+ * @ingroup Asset
+ */
+void assetRelease(void *data)
+{
+    if (NULL == data)
+    {
+        return;
+    }
+
+    for (uint32_t i = 0; i < numAssets; i++)
+    {
+        if (assets[i].data != data)
+        {
+            continue;
+        }
+
+        assets[i].refCount--;
+        if (assets[i].refCount)
+        {
+            return;
+        }
+
+        assetDestroy(assets[i].type, assets[i].data);
+        free(assets[i].path);
+        numAssets--;
+        assets[i] = assets[numAssets];
+
+        if (0 == numAssets)
+        {
+            free(assets);
+            assets = NULL;
+        }
+        return;
+    }
+
+    fprintf(stderr, "assetRelease(): unknown asset.\n");
+}
+
+/**
+ * @brief   Get sound effect.
+ * @param   path path to the sound file.
+ * @return  Mix_Chunk on success, NULL on error.
+ * @ingroup Asset
+ */
+Mix_Chunk *assetSFX(const char *path)
+{
+    return assetGet(NULL, path, ASSET_SFX);
+}
+
+/**
+ * @brief   Get texture.
+ * @param   renderer SDL's rendering context.  See @ref struct Video.
+ * @param   path     path to the image file.
+ * @return  SDL_Texture on success, NULL on error.
+ * @ingroup Asset
+ */
+SDL_Texture *assetTexture(SDL_Renderer *renderer, const char *path)
+{
+    return assetGet(renderer, path, ASSET_TEXTURE);
+}
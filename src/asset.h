@@ -0,0 +1,35 @@
+/** @file asset.h
+ * @ingroup Asset
+ */
+
+#ifndef ASSET_h
+#define ASSET_h
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_mixer.h>
+#include <stdint.h>
+
+// Asset types.
+#define ASSET_TEXTURE  0
+#define ASSET_SFX      1
+#define ASSET_MUSIC    2
+
+/**
+ * @ingroup Asset
+ */
+typedef struct asset_t
+{
+    char         *path;
+    uint8_t      type;
+    SDL_Renderer *renderer;
+    void         *data;
+    uint32_t     refCount;
+} Asset;
+
+void        *assetInsert(SDL_Renderer *renderer, const char *path, uint8_t type, void *data);
+Mix_Music   *assetMusic(const char *path);
+void        assetRelease(void *data);
+Mix_Chunk   *assetSFX(const char *path);
+SDL_Texture *assetTexture(SDL_Renderer *renderer, const char *path);
+
+#endif
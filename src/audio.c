@@ -8,6 +8,7 @@
 
 #include <SDL2/SDL.h>
 #include <stdio.h>
+#include "asset.h"
 #include "audio.h"
 
 /**
@@ -84,6 +85,22 @@ int8_t musicFadeIn(Music *music, int8_t loops, uint16_t ms)
     return 0;
 }
 
+/**
+ * @brief   Free music.
+ * @param   music the music structure.  See @ref struct Music.
+ * @ingroup Audio
+ */
+void musicFree(Music *music)
+{
+    if (NULL == music)
+    {
+        return;
+    }
+
+    assetRelease(music->music);
+    free(music);
+}
+
 /**
  * @brief   Initialise Music.
  * @return  Music on success, NULL on error.  See @ref struct Music.
@@ -99,11 +116,10 @@ Music *musicInit(const char *filename)
         return NULL;
     }
 
-    music->music = Mix_LoadMUS(filename);
+    music->music = assetMusic(filename);
 
     if (NULL == music->music)
     {
-        fprintf(stderr, "%s\n", Mix_GetError());
         free(music);
         return NULL;
     }
@@ -146,6 +162,22 @@ void musicToggle()
     }
 }
 
+/**
+ * @brief   Free sound effect.
+ * @param   sfx the sfx structure.  See @ref struct SFX.
+ * @ingroup Audio
+ */
+void sfxFree(SFX *sfx)
+{
+    if (NULL == sfx)
+    {
+        return;
+    }
+
+    assetRelease(sfx->sfx);
+    free(sfx);
+}
+
 /**
  * @brief   Initialise sound effect.
  * @param   sfx the sound sfx structure.  See @ref struct SFX.
@@ -162,11 +194,10 @@ SFX *sfxInit(const char *filename)
         return NULL;
     }
 
-    sfx->sfx = Mix_LoadWAV(filename);
+    sfx->sfx = assetSFX(filename);
 
     if (NULL == sfx->sfx)
     {
-        fprintf(stderr, "%s\n", Mix_GetError());
         free(sfx);
         return NULL;
     }
@@ -8,13 +8,6 @@
 #include <SDL2/SDL_mixer.h>
 #include <stdint.h>
 
-/**
- * @def     musicFree()
- *          Free music structure.
- * @ingroup Audio
- */
-#define musicFree(music) free(music)
-
 /**
  * @def     musicHalt()
  *          Halt music playback.
@@ -36,13 +29,6 @@
  */
 #define musicResume() Mix_ResumeMusic()
 
-/**
- * @def     sfxFree()
- *          Free sfx structure.
- * @ingroup Audio
- */
-#define sfxFree(sfx) free(sfx)
-
 #define NUM_SFX      5
 #define SFX_DEAD     0
 #define SFX_IMPACT   1
@@ -82,9 +68,11 @@ typedef struct sfx_t {
 void   mixerFree(Mixer *mixer);
 Mixer  *mixerInit();
 int8_t musicFadeIn(Music *music, int8_t loops, uint16_t ms);
+void   musicFree(Music *music);
 Music *musicInit(const char *filename);
 int8_t musicPlay(Music *music, int8_t loops);
 void   musicToggle();
+void   sfxFree(SFX *sfx);
 SFX   *sfxInit(const char *filename);
 int8_t sfxPlay(SFX *sfx, int8_t channel, int8_t loops);
 
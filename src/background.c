@@ -6,10 +6,32 @@
  * @copyright "THE BEER-WARE LICENCE" (Revision 42)
  */
 
-#include <SDL2/SDL_image.h>
+#include <SDL2/SDL.h>
 #include <stdio.h>
+#include "asset.h"
 #include "background.h"
 
+/**
+ * @brief   Free background.
+ * @param   background the background structure.  See @ref struct Background.
+ * @ingroup Background
+ */
+void backgroundFree(Background *background)
+{
+    if (NULL == background)
+    {
+        return;
+    }
+
+    if (background->background)
+    {
+        SDL_DestroyTexture(background->background);
+    }
+
+    assetRelease(background->image);
+    free(background);
+}
+
 /**
  * @brief   Initialise background structure.  See @ref struct Background.
  * @param   filename   the image file to load.
@@ -34,10 +56,9 @@ Background *backgroundInit(SDL_Renderer *renderer, const char *filename, int32_t
     background->worldPosX  = 0;
     background->worldPosY  = 0;
 
-    background->image = IMG_LoadTexture(renderer, background->filename);
+    background->image = assetTexture(renderer, background->filename);
     if (NULL == background->image)
     {
-        fprintf(stderr, "%s\n", SDL_GetError());
         free(background);
         return NULL;
     }
@@ -45,7 +66,7 @@ Background *backgroundInit(SDL_Renderer *renderer, const char *filename, int32_t
     if (0 != SDL_QueryTexture(background->image, NULL, NULL, &background->imageWidth, &background->imageHeight))
     {
         fprintf(stderr, "%s\n", SDL_GetError());
-        free(background);
+        backgroundFree(background);
         return NULL;
     }
 
@@ -8,13 +8,6 @@
 #include <SDL2/SDL.h>
 #include <stdint.h>
 
-/**
- * @def     backgroundFree()
- *          Free background structure.
- * @ingroup Background
- */
-#define backgroundFree(background) free(background)
-
 /**
  * @def     NUM_BACKGROUNDS
  *          The overall number of backgrounds used in the main program.
@@ -39,6 +32,7 @@ typedef struct background_t
     double      worldPosY;
 } Background;
 
+void       backgroundFree(Background *background);
 Background *backgroundInit(SDL_Renderer *renderer, const char *filename, int32_t mapWidth);
 int8_t     backgroundRender(SDL_Renderer *renderer, Background *background, double cameraPosX, double cameraPosY);
 
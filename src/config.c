@@ -20,12 +20,19 @@ static int32_t handler(void* cfg, const char *section, const char *name, const c
 
     int32_t val = atoi(value);
 
-    if      (MATCH("Audio", "enabled"))    config->audio.enabled    = val;
-    else if (MATCH("Video", "fullscreen")) config->video.fullscreen = val;
-    else if (MATCH("Video", "height"))     config->video.height     = val;
-    else if (MATCH("Video", "width"))      config->video.width      = val;
-    else if (MATCH("Video", "limitFPS"))   config->video.limitFPS   = val;
-    else if (MATCH("Video", "fps"))        config->video.fps        = val;
+    if      (MATCH("Audio", "enabled"))       config->audio.enabled       = val;
+    else if (MATCH("Headless", "enabled"))    config->headless.enabled    = val;
+    else if (MATCH("Headless", "ticks"))      config->headless.ticks      = val;
+    else if (MATCH("Headless", "entities"))   config->headless.entities   = val;
+    else if (MATCH("Profiler", "enabled"))    config->profiler.enabled    = val;
+    else if (MATCH("Profiler", "frames"))     config->profiler.frames     = val;
+    else if (MATCH("Simulation", "tickRate")) config->simulation.tickRate = val;
+    else if (MATCH("Simulation", "maxSteps")) config->simulation.maxSteps = val;
+    else if (MATCH("Video", "fullscreen"))    config->video.fullscreen    = val;
+    else if (MATCH("Video", "height"))        config->video.height        = val;
+    else if (MATCH("Video", "width"))         config->video.width         = val;
+    else if (MATCH("Video", "limitFPS"))      config->video.limitFPS      = val;
+    else if (MATCH("Video", "fps"))           config->video.fps           = val;
     else
     {
         return 0;
@@ -45,20 +52,34 @@ Config configInit(const char *filename)
 {
     static Config config;
 
-    config.video.fps        =  60;
-    config.video.fullscreen =   0;
-    config.video.height     = 600;
-    config.video.limitFPS   =   1;
-    config.video.width      = 800;
+    config.headless.enabled    =     0;
+    config.headless.entities   =     7;
+    config.headless.ticks      = 10000;
+    config.profiler.enabled    =     0;
+    config.profiler.frames     =  4096;
+    config.simulation.maxSteps =     5;
+    config.simulation.tickRate =    60;
+    config.video.fps           =    60;
+    config.video.fullscreen    =     0;
+    config.video.height        =   600;
+    config.video.limitFPS      =     1;
+    config.video.width         =   800;
 
     if (0 > ini_parse(filename, handler, &config))
     {
         fprintf(stderr, "Couldn't load configuration file: %s\n", filename);
     }
 
-    if (0 > config.video.fps)    config.video.fps    = abs(config.video.fps);
-    if (0 > config.video.height) config.video.height = abs(config.video.height);
-    if (0 > config.video.width)  config.video.width  = abs(config.video.width);
+    if (0 >  config.headless.entities)   config.headless.entities   = abs(config.headless.entities);
+    if (0 >= config.headless.ticks)      config.headless.ticks      = 10000;
+    if (0 >= config.profiler.frames)     config.profiler.frames     = 4096;
+    if (0 >  config.simulation.maxSteps) config.simulation.maxSteps = abs(config.simulation.maxSteps);
+    if (0 >  config.simulation.tickRate) config.simulation.tickRate = abs(config.simulation.tickRate);
+    if (0 == config.simulation.maxSteps) config.simulation.maxSteps = 1;
+    if (0 == config.simulation.tickRate) config.simulation.tickRate = 60;
+    if (0 >  config.video.fps)           config.video.fps           = abs(config.video.fps);
+    if (0 >  config.video.height)        config.video.height        = abs(config.video.height);
+    if (0 >  config.video.width)         config.video.width         = abs(config.video.width);
 
     return config;
 }
@@ -14,6 +14,31 @@ typedef struct audioConfig_t {
     int8_t enabled;
 } AudioConfig;
 
+/**
+ * @ingroup Config
+ */
+typedef struct headlessConfig_t {
+    int8_t  enabled;
+    int32_t ticks;
+    int32_t entities;
+} HeadlessConfig;
+
+/**
+ * @ingroup Config
+ */
+typedef struct profilerConfig_t {
+    int8_t  enabled;
+    int32_t frames;
+} ProfilerConfig;
+
+/**
+ * @ingroup Config
+ */
+typedef struct simulationConfig_t {
+    int16_t tickRate;
+    int8_t  maxSteps;
+} SimulationConfig;
+
 /**
  * @ingroup Config
  */
@@ -30,8 +55,11 @@ typedef struct videoConfig_t {
  */
 typedef struct cfg_t
 {
-    AudioConfig audio;
-    VideoConfig video;
+    AudioConfig      audio;
+    HeadlessConfig   headless;
+    ProfilerConfig   profiler;
+    SimulationConfig simulation;
+    VideoConfig      video;
 } Config;
 
 Config configInit(const char *filename);
@@ -8,48 +8,39 @@
  */
 
 #include <SDL2/SDL_image.h>
+#include <math.h>
 #include <stdio.h>
+#include "asset.h"
 #include "entity.h"
 
+/* The batch kernels must not be inlined into entityFrameBlock(); the compiler
+ * only vectorises them with their restrict-qualified parameters intact. */
+#ifdef __GNUC__
+#define ENTITY_KERNEL static __attribute__((__noinline__))
+#else
+#define ENTITY_KERNEL static
+#endif
+
 /**
- * @brief   Update entity.  Thie function has to be called every frame.
- * @param   entity the entity to update.  See @ref struct Entity.
- * @param   dTime  delta time; time passed since last frame in seconds.
+ * @brief   Update the frame animation of an entity.  Shared by the scalar and
+ *          the batched update.
+ * @param   entity  the entity.  See @ref struct Entity.
+ * @param   flags   the entity flags before the position update.
+ * @param   stopped 1 if the entity came to a halt during this tick.
+ * @param   dTime   delta time; time passed since last frame in seconds.
  * @ingroup Entity
  */
-void entityFrame(Entity *entity, double dTime)
+static void entityAnimate(Entity *entity, uint16_t flags, uint8_t stopped, double dTime)
 {
-    // Update bounding box.
-    entity->bb.b = entity->worldPosY + entity->height;
-    entity->bb.l = entity->worldPosX;
-    entity->bb.r = entity->worldPosX + entity->width;
-    entity->bb.t = entity->worldPosY;
-
-    // Increase/decrease vertical velocity if player is in motion.
-    if ((entity->flags >> IN_MOTION)  & 1)
-    {
-        entity->velocity += entity->acceleration * dTime;
-    }
-    else
-    {
-        entity->velocity -= entity->deceleration * dTime;
-    }
-
-    // Set vertical velocity limits.
-    if (entity->velocity > entity->velocityMax)
-    {
-        entity->velocity = entity->velocityMax;
-    }
-    if (entity->velocity < 0)
+    // Reset frame animation when standing still.
+    if (stopped)
     {
-        entity->velocity = 0;
-        // Reset frame animation when standing still.
-        entity->frame    = entity->frameStart;
+        entity->frame = entity->frameStart;
     }
 
     // Update frame.
-    if (((entity->flags >> IN_MOTION)  & 1) ||
-        ((entity->flags >> IN_MID_AIR) & 1))
+    if (((flags >> IN_MOTION)  & 1) ||
+        ((flags >> IN_MID_AIR) & 1))
     {
         entity->frameTime += dTime;
 
@@ -66,155 +57,479 @@ void entityFrame(Entity *entity, double dTime)
         entity->frame = entity->frameStart;
     }
 
+    // Select the animation for the next frame.
+    if (((flags >> IN_MID_AIR) & 1) || ((flags >> IS_JUMPING) & 1))
+    {
+        if ((flags >> IS_JUMPING) & 1)
+        {
+            entity->frameStart = JUMP;
+            entity->frameEnd   = JUMP_MAX;
+        }
+        else
+        {
+            entity->frameStart = FALL;
+            entity->frameEnd   = FALL_MAX;
+        }
+    }
+    else
+    {
+        entity->frameStart = WALK;
+        entity->frameEnd   = WALK_MAX;
+    }
+}
+
+/**
+ * @brief   Batch kernel: update the bounding boxes.
+ * @ingroup Entity
+ */
+ENTITY_KERNEL void entityKernelBounds(
+    AABB          *restrict bb,
+    const double  *restrict worldPosX,
+    const double  *restrict worldPosY,
+    const uint8_t *restrict width,
+    const uint8_t *restrict height)
+{
+    for (uint32_t i = 0; i < ENTITY_BATCH_SIZE; i++)
+    {
+        bb[i].b = worldPosY[i] + height[i];
+        bb[i].l = worldPosX[i];
+        bb[i].r = worldPosX[i] + width[i];
+        bb[i].t = worldPosY[i];
+    }
+}
+
+/**
+ * @brief   Batch kernel: update the flags, connect the map borders and kill
+ *          entities which fell out of the map.
+ * @ingroup Entity
+ */
+ENTITY_KERNEL void entityKernelFlags(
+    uint16_t      *restrict flags,
+    double        *restrict worldPosX,
+    double        *restrict worldPosY,
+    const double  *restrict jumpElapsed,
+    const double  *restrict jumpTimeMax,
+    const uint8_t *restrict width,
+    const uint8_t *restrict height,
+    double        worldWidth,
+    double        worldHeight)
+{
+    for (uint32_t i = 0; i < ENTITY_BATCH_SIZE; i++)
+    {
+        uint16_t f       = flags[i];
+        uint16_t jumping = (f >> IS_JUMPING) & 1;
+        uint16_t midAir  = ((f >> IN_MID_AIR) & 1) | jumping;
+        uint16_t expired = jumping & (jumpElapsed[i] > jumpTimeMax[i]);
+        double   posX    = worldPosX[i];
+        double   posY    = worldPosY[i];
+        int32_t  half    = width[i] / 2;
+        double   bottom  = worldHeight + height[i];
+
+        f  |= midAir << IN_MID_AIR;
+        f   = (expired | !midAir) ? (f & ~(1 << IS_JUMPING)) : f;
+
+        // Connect left and right border of the map and vice versa.
+        posX = (posX < 0 - half)          ? worldWidth - half : posX;
+        posX = (posX > worldWidth - half) ? 0 - half          : posX;
+
+        // Kill entities falling out of the map.
+        f   |= (posY >= bottom) << IS_DEAD;
+        posY = (posY > bottom) ? bottom : posY;
+
+        flags[i]     = f;
+        worldPosX[i] = posX;
+        worldPosY[i] = posY;
+    }
+}
+
+/**
+ * @brief   Batch kernel: move the entities and apply gravity.  jumpElapsed
+ *          receives the jump time before it is reset.
+ * @ingroup Entity
+ */
+ENTITY_KERNEL void entityKernelMove(
+    double         *restrict worldPosX,
+    double         *restrict worldPosY,
+    double         *restrict velocityFall,
+    double         *restrict distanceFall,
+    double         *restrict jumpTime,
+    double         *restrict jumpElapsed,
+    const double   *restrict jumpTimeMax,
+    const double   *restrict velocity,
+    const double   *restrict velocityJump,
+    const double   *restrict jumpGravityFactor,
+    const uint16_t *restrict flags,
+    double         gravity,
+    double         dTime)
+{
+    for (uint32_t i = 0; i < ENTITY_BATCH_SIZE; i++)
+    {
+        uint16_t f       = flags[i];
+        uint16_t left    = (f >> DIRECTION)  & 1;
+        uint16_t jumping = (f >> IS_JUMPING) & 1;
+        uint16_t midAir  = ((f >> IN_MID_AIR) & 1) | jumping;
+        double   v       = velocity[i];
+        double   step    = v * dTime;
+        double   posX    = worldPosX[i];
+        double   posY    = worldPosY[i];
+        double   fall    = velocityFall[i];
+        double   dist    = distanceFall[i];
+        double   last    = jumpTime[i];
+        double   time    = last + dTime;
+        double   jump    = -(gravity + velocityJump[i]) * jumpGravityFactor[i];
+        double   g       = jumping ? jump : gravity;
+        double   d       = g * dTime * dTime;
+        double   moved   = left ? posX - step : posX + step;
+
+        time            = jumping ? time : last;
+        jumpElapsed[i]  = time;
+        time            = (time > jumpTimeMax[i]) ? 0 : time;
+        jumpTime[i]     = jumping ? time : last;
+        worldPosX[i]    = (v > 0) ? moved : posX;
+        fall            = fall + d;
+        distanceFall[i] = midAir ? d : dist;
+        velocityFall[i] = midAir ? fall : 0;
+        worldPosY[i]    = midAir ? posY + fall : posY;
+    }
+}
+
+/**
+ * @brief   Batch kernel: accelerate or decelerate the entities.  speed
+ *          receives the velocity before it is clamped at zero.
+ * @ingroup Entity
+ */
+ENTITY_KERNEL void entityKernelVelocity(
+    double         *restrict velocity,
+    double         *restrict speed,
+    const double   *restrict acceleration,
+    const double   *restrict deceleration,
+    const double   *restrict velocityMax,
+    const uint16_t *restrict flags,
+    double         dTime)
+{
+    for (uint32_t i = 0; i < ENTITY_BATCH_SIZE; i++)
+    {
+        double up   = velocity[i] + (acceleration[i] * dTime);
+        double down = velocity[i] - (deceleration[i] * dTime);
+        double vMax = velocityMax[i];
+        double v    = ((flags[i] >> IN_MOTION) & 1) ? up : down;
+
+        v           = (v > vMax) ? vMax : v;
+        speed[i]    = v;
+        velocity[i] = (v < 0) ? 0 : v;
+    }
+}
+
+/**
+ * @brief   Update one block of ENTITY_BATCH_SIZE entities.  The branches of
+ *          entityFrame() are replaced by selects in a few kernels with a
+ *          fixed trip count, so the compiler can vectorise them.  Only the
+ *          frame animation is updated per entity.
+ * @param   store the entity store.  See @ref struct EntityStore.
+ * @param   start index of the first entity of the block.
+ * @param   dTime delta time; time passed since last frame in seconds.
+ * @ingroup Entity
+ */
+static void entityFrameBlock(EntityStore *store, uint32_t start, double dTime)
+{
+    double speed[ENTITY_BATCH_SIZE];
+    double jumpElapsed[ENTITY_BATCH_SIZE];
+
+    entityKernelBounds(
+        store->bb        + start,
+        store->worldPosX + start,
+        store->worldPosY + start,
+        store->width     + start,
+        store->height    + start);
+
+    entityKernelVelocity(
+        store->velocity     + start,
+        speed,
+        store->acceleration + start,
+        store->deceleration + start,
+        store->velocityMax  + start,
+        store->flags        + start,
+        dTime);
+
+    for (uint32_t i = 0; i < ENTITY_BATCH_SIZE; i++)
+    {
+        entityAnimate(&store->entity[start + i], store->flags[start + i], (speed[i] < 0), dTime);
+    }
+
+    entityKernelMove(
+        store->worldPosX         + start,
+        store->worldPosY         + start,
+        store->velocityFall      + start,
+        store->distanceFall      + start,
+        store->jumpTime          + start,
+        jumpElapsed,
+        store->jumpTimeMax       + start,
+        store->velocity          + start,
+        store->velocityJump      + start,
+        store->jumpGravityFactor + start,
+        store->flags             + start,
+        store->worldMeterInPixel * store->worldGravitation,
+        dTime);
+
+    entityKernelFlags(
+        store->flags       + start,
+        store->worldPosX   + start,
+        store->worldPosY   + start,
+        jumpElapsed,
+        store->jumpTimeMax + start,
+        store->width       + start,
+        store->height      + start,
+        store->worldWidth,
+        store->worldHeight);
+}
+
+/**
+ * @brief   Resolve collisions between an entity and the map.  The movement of
+ *          the last entityFrame() call is swept through the tile grid, so
+ *          entities can't tunnel through thin floors at low frame rates or high
+ *          fall speeds.  This function has to be called after entityFrame().
+ * @param   store the entity store.  See @ref struct EntityStore.
+ * @param   i     index of the entity.
+ * @param   map   the map.  See @ref struct Map.
+ * @ingroup Entity
+ */
+void entityCollide(EntityStore *store, uint32_t i, Map *map)
+{
+    MapContact contact;
+    AABB       box = store->bb[i];
+    double     dx  = store->worldPosX[i] - box.l;
+    double     dy  = store->worldPosY[i] - box.t;
+
+    // Don't sweep across the map when the entity has been wrapped around.
+    if (fabs(dx) > (store->worldWidth / 2))
+    {
+        box.l = store->worldPosX[i];
+        box.r = store->worldPosX[i] + store->width[i];
+        dx    = 0;
+    }
+
+    mapSweep(map, box, dx, dy, &contact);
+    store->worldPosX[i] = box.l + contact.dx;
+    store->worldPosY[i] = box.t + contact.dy;
+
+    // Wall.
+    if (contact.normalX)
+    {
+        store->velocity[i] = 0;
+    }
+
+    // Ceiling.
+    if (contact.normalY > 0)
+    {
+        store->velocityFall[i]  = 0;
+        store->jumpTime[i]      = 0;
+        store->flags[i]        &= ~(1 << IS_JUMPING);
+    }
+
+    // Floor; either landed during this frame or standing on it.
+    if (contact.normalY < 0)
+    {
+        store->velocityFall[i]  = 0;
+        store->flags[i]        &= ~(1 << IN_MID_AIR);
+        return;
+    }
+
+    box.l = store->worldPosX[i];
+    box.r = store->worldPosX[i] + store->width[i];
+    box.t = store->worldPosY[i];
+    box.b = store->worldPosY[i] + store->height[i];
+    mapSweep(map, box, 0, 1, &contact);
+
+    if ((contact.normalY < 0) && (0 == contact.dy))
+    {
+        store->flags[i] &= ~(1 << IN_MID_AIR);
+    }
+    else
+    {
+        store->flags[i] |= 1 << IN_MID_AIR;
+    }
+}
+
+/**
+ * @brief   Update entity.  Thie function has to be called every frame.  Use
+ *          entityFrameBatch() to update many entities at once.
+ * @param   store the entity store.  See @ref struct EntityStore.
+ * @param   i     index of the entity to update.
+ * @param   dTime delta time; time passed since last frame in seconds.
+ * @ingroup Entity
+ */
+void entityFrame(EntityStore *store, uint32_t i, double dTime)
+{
+    uint8_t stopped = 0;
+
+    // Update bounding box.
+    store->bb[i].b = store->worldPosY[i] + store->height[i];
+    store->bb[i].l = store->worldPosX[i];
+    store->bb[i].r = store->worldPosX[i] + store->width[i];
+    store->bb[i].t = store->worldPosY[i];
+
+    // Increase/decrease vertical velocity if player is in motion.
+    if ((store->flags[i] >> IN_MOTION)  & 1)
+    {
+        store->velocity[i] += store->acceleration[i] * dTime;
+    }
+    else
+    {
+        store->velocity[i] -= store->deceleration[i] * dTime;
+    }
+
+    // Set vertical velocity limits.
+    if (store->velocity[i] > store->velocityMax[i])
+    {
+        store->velocity[i] = store->velocityMax[i];
+    }
+    if (store->velocity[i] < 0)
+    {
+        store->velocity[i] = 0;
+        stopped            = 1;
+    }
+
+    entityAnimate(&store->entity[i], store->flags[i], stopped, dTime);
+
     // Set vertical player position.
-    if (entity->velocity > 0)
+    if (store->velocity[i] > 0)
     {
-        if ((entity->flags >> DIRECTION) & 1)
+        if ((store->flags[i] >> DIRECTION) & 1)
         {
-            entity->worldPosX -= (entity->velocity * dTime);
+            store->worldPosX[i] -= (store->velocity[i] * dTime);
         }
         else
         {
-            entity->worldPosX += (entity->velocity * dTime);
+            store->worldPosX[i] += (store->velocity[i] * dTime);
         }
     }
 
     // Set horizontal player position.
-    if ((entity->flags >> IS_JUMPING) & 1)
+    if ((store->flags[i] >> IS_JUMPING) & 1)
     {
-        entity->jumpTime += dTime;
-        entity->flags    |= 1 << IN_MID_AIR;
+        store->jumpTime[i] += dTime;
+        store->flags[i]    |= 1 << IN_MID_AIR;
     }
 
     // Handle falling, jumping, gravity, etc.
-    if ((entity->flags >> IN_MID_AIR) & 1)
+    if ((store->flags[i] >> IN_MID_AIR) & 1)
     {
-        double g = (entity->worldMeterInPixel * entity->worldGravitation);
-        if ((entity->flags >> IS_JUMPING) & 1)
+        double g = (store->worldMeterInPixel * store->worldGravitation);
+        if ((store->flags[i] >> IS_JUMPING) & 1)
         {
-            entity->frameStart = JUMP;
-            entity->frameEnd   = JUMP_MAX;
-            g += entity->velocityJump;
-            g = -g * entity->jumpGravityFactor;
+            g += store->velocityJump[i];
+            g = -g * store->jumpGravityFactor[i];
 
-            if (entity->jumpTime > entity->jumpTimeMax)
+            if (store->jumpTime[i] > store->jumpTimeMax[i])
             {
-                entity->jumpTime = 0;
-                entity->flags &= ~(1 << IS_JUMPING);
+                store->jumpTime[i] = 0;
+                store->flags[i] &= ~(1 << IS_JUMPING);
             }
         }
-        else
-        {
-            entity->frameStart = FALL;
-            entity->frameEnd   = FALL_MAX;
-        }
 
-        entity->distanceFall  = g * dTime * dTime;
-        entity->velocityFall += entity->distanceFall;
-        entity->worldPosY    += entity->velocityFall;
+        store->distanceFall[i]  = g * dTime * dTime;
+        store->velocityFall[i] += store->distanceFall[i];
+        store->worldPosY[i]    += store->velocityFall[i];
     }
     else
     {
-        entity->frameStart    = WALK;
-        entity->frameEnd      = WALK_MAX;
-        entity->flags        &= ~(1 << IS_JUMPING);
-        entity->velocityFall  = 0;
+        store->flags[i]        &= ~(1 << IS_JUMPING);
+        store->velocityFall[i]  = 0;
     }
 
     // Connect left and right border of the map and vice versa.
-    if (entity->worldPosX < 0 - (entity->width / 2))
+    if (store->worldPosX[i] < 0 - (store->width[i] / 2))
     {
-        entity->worldPosX = entity->worldWidth - (entity->width / 2);
+        store->worldPosX[i] = store->worldWidth - (store->width[i] / 2);
     }
 
-    if (entity->worldPosX > entity->worldWidth - (entity->width / 2))
+    if (store->worldPosX[i] > store->worldWidth - (store->width[i] / 2))
     {
-        entity->worldPosX = 0 - (entity->width / 2);
+        store->worldPosX[i] = 0 - (store->width[i] / 2);
     }
 
     // Kill player when he falls out of the map.
-    if (entity->worldPosY >= entity->worldHeight + entity->height)
+    if (store->worldPosY[i] >= store->worldHeight + store->height[i])
     {
-        entity->flags |= 1 << IS_DEAD;
+        store->flags[i] |= 1 << IS_DEAD;
     }
 
-    if (entity->worldPosY > entity->worldHeight + entity->height)
+    if (store->worldPosY[i] > store->worldHeight + store->height[i])
     {
-        entity->worldPosY = entity->worldHeight + entity->height;
+        store->worldPosY[i] = store->worldHeight + store->height[i];
     }
 }
 
 /**
- * @brief   Initialise entity.
- * @return  Entity on success, NULL on error.  See @ref struct Entity.
+ * @brief   Update a range of entities.  Produces the same result as calling
+ *          entityFrame() for every entity.  Full blocks are handled by
+ *          entityFrameBlock(), the remainder by entityFrame().
+ * @param   store the entity store.  See @ref struct EntityStore.
+ * @param   first index of the first entity to update.
+ * @param   count number of entities to update.
+ * @param   dTime delta time; time passed since last frame in seconds.
  * @ingroup Entity
  */
-Entity *entityInit()
+void entityFrameBatch(EntityStore *store, uint32_t first, uint32_t count, double dTime)
 {
-    static Entity *entity;
-    entity = malloc(sizeof(struct entity_t));
-    if (NULL == entity)
+    uint32_t i   = first;
+    uint32_t end = first + count;
+
+    for (; end - i >= ENTITY_BATCH_SIZE; i += ENTITY_BATCH_SIZE)
     {
-        fprintf(stderr, "entityInit(): error allocating memory.\n");
-        return NULL;
+        entityFrameBlock(store, i, dTime);
     }
 
-    // Default values.
-    entity->height            =  32;
-    entity->width             =  32;
-    entity->bb.b              =   0;
-    entity->bb.l              =   entity->height;
-    entity->bb.r              =   entity->width;
-    entity->bb.t              =   0;
-    entity->acceleration      = 400;
-    entity->deceleration      = 200;
-    entity->distanceFall      =   0;
-    entity->flags             =   0;
-    entity->fps               =  12;
-    entity->frame             =   0;
-    entity->frameEnd          =   WALK_MAX;
-    entity->frameStart        =   WALK;
-    entity->frameTime         =   0.0;
-    entity->frameYoffset      =  32;
-    entity->jumpGravityFactor =   4.0;
-    entity->jumpTime          =   0.0;
-    entity->jumpTimeMax       =   0.12;
-    entity->respawnPosX       =   0.0;
-    entity->respawnPosY       =   0.0;
-    entity->sprite            =   NULL;
-    entity->velocity          =   0.0;
-    entity->velocityFall      =   0.0;
-    entity->velocityJump      =   0.0;
-    entity->velocityMax       = 100.0;
-    entity->worldHeight       =   0;
-    entity->worldGravitation  =   9.81;
-    entity->worldMeterInPixel =  32;
-    entity->worldPosX         =   0.0;
-    entity->worldPosY         =   0.0;
-    entity->worldWidth        =   0;
-
-    return entity;
+    for (; i < end; i++)
+    {
+        entityFrame(store, i, dTime);
+    }
 }
 
 /**
- * @brief
- * @param   entity
- * @param   renderer
- * @param   filename
- * @return  0 on success, -1 on error.
+ * @brief   Get the render position of an entity between the previous and the
+ *          current tick.  Teleports, e.g. wrapping around the map border, are
+ *          not interpolated.
+ * @param   store the entity store.  See @ref struct EntityStore.
+ * @param   i     index of the entity.
+ * @param   alpha blend factor between the previous (0) and the current (1)
+ *                tick.
+ * @param   posX  receives the position along the x-axis.
+ * @param   posY  receives the position along the y-axis.
  * @ingroup Entity
  */
-int8_t entityLoadSprite(Entity *entity, SDL_Renderer *renderer, const char *filename)
+void entityInterpolate(EntityStore *store, uint32_t i, double alpha, double *posX, double *posY)
 {
-    if (NULL != entity->sprite)
+    double dx = store->worldPosX[i] - store->prevPosX[i];
+    double dy = store->worldPosY[i] - store->prevPosY[i];
+
+    if (fabs(dx) > (store->worldWidth / 2))
     {
-        SDL_DestroyTexture(entity->sprite);
+        dx = 0;
     }
 
-    entity->sprite = IMG_LoadTexture(renderer, filename);
+    *posX = store->worldPosX[i] - (dx * (1 - alpha));
+    *posY = store->worldPosY[i] - (dy * (1 - alpha));
+}
+
+/**
+ * @brief   Load the sprite sheet of an entity.
+ * @param   store    the entity store.  See @ref struct EntityStore.
+ * @param   i        index of the entity.
+ * @param   renderer SDL's rendering context.  See @ref struct Video.
+ * @param   filename the image file to load.
+ * @return  0 on success, -1 on error.
+ * @ingroup Entity
+ */
+int8_t entityLoadSprite(EntityStore *store, uint32_t i, SDL_Renderer *renderer, const char *filename)
+{
+    Entity *entity = &store->entity[i];
+
+    // All entities using the same sprite sheet share one texture.
+    assetRelease(entity->sprite);
+    entity->sprite = assetTexture(renderer, filename);
     if (NULL == entity->sprite)
     {
-        fprintf(stderr, "%s\n", SDL_GetError());
         return -1;
     }
 
@@ -224,41 +539,50 @@ int8_t entityLoadSprite(Entity *entity, SDL_Renderer *renderer, const char *file
 /**
  * @brief   Render entity on screen.
  * @param   renderer   SDL's rendering context.  See @ref struct Video.
- * @param   entity     the entity to render.  See @ref struct Entity.
+ * @param   store      the entity store.  See @ref struct EntityStore.
+ * @param   i          index of the entity to render.
+ * @param   alpha      blend factor between the previous and the current tick.
+ *                     See entityInterpolate().
  * @param   cameraPosX camera position along the x-axis.
  * @param   cameraPosY camera position along the y-axis.
  * @return  0 on success, -1 on error.
  * @ingroup Entity
  */
-int8_t entityRender(SDL_Renderer *renderer, Entity *entity, double cameraPosX, double cameraPosY)
+int8_t entityRender(SDL_Renderer *renderer, EntityStore *store, uint32_t i, double alpha, double cameraPosX, double cameraPosY)
 {
+    Entity *entity = &store->entity[i];
+
     if (NULL == entity->sprite)
     {
         fprintf(stderr, "%s\n", SDL_GetError());
         return -1;
     }
 
-    double renderPosX = entity->worldPosX - cameraPosX;
-    double renderPosY = entity->worldPosY - cameraPosY;
+    double renderPosX;
+    double renderPosY;
+
+    entityInterpolate(store, i, alpha, &renderPosX, &renderPosY);
+    renderPosX -= cameraPosX;
+    renderPosY -= cameraPosY;
 
     SDL_Rect dst =
     {
         renderPosX,
         renderPosY,
-        entity->width,
-        entity->height
+        store->width[i],
+        store->height[i]
     };
     SDL_Rect src =
     {
-        entity->frame * entity->width,
+        entity->frame * store->width[i],
         entity->frameYoffset,
-        entity->width,
-        entity->height
+        store->width[i],
+        store->height[i]
     };
 
     SDL_RendererFlip flip;
 
-    if ((entity->flags >> DIRECTION) & 1)
+    if ((store->flags[i] >> DIRECTION) & 1)
     {
         flip = SDL_FLIP_HORIZONTAL;
     }
@@ -278,13 +602,164 @@ int8_t entityRender(SDL_Renderer *renderer, Entity *entity, double cameraPosX, d
 
 /**
  * @brief   Respawn entity.
- * @param   entity the entity to respawn.  See @ref struct Entity.
+ * @param   store the entity store.  See @ref struct EntityStore.
+ * @param   i     index of the entity to respawn.
  * @ingroup Entity
  */
-void entityRespawn(Entity *entity)
+void entityRespawn(EntityStore *store, uint32_t i)
 {
-    entity->flags     &= ~(1 << IS_DEAD);
-    entity->flags     &= ~(1 << IN_MOTION);
-    entity->worldPosX  = entity->respawnPosX;
-    entity->worldPosY  = entity->respawnPosY;
+    store->flags[i]     &= ~(1 << IS_DEAD);
+    store->flags[i]     &= ~(1 << IN_MOTION);
+    store->worldPosX[i]  = store->entity[i].respawnPosX;
+    store->worldPosY[i]  = store->entity[i].respawnPosY;
+    store->prevPosX[i]   = store->worldPosX[i];
+    store->prevPosY[i]   = store->worldPosY[i];
+}
+
+/**
+ * @brief   Free entity store.
+ * @param   store the entity store.  See @ref struct EntityStore.
+ * @ingroup Entity
+ */
+void entityStoreFree(EntityStore *store)
+{
+    if (NULL == store)
+    {
+        return;
+    }
+
+    if (store->entity)
+    {
+        for (uint32_t i = 0; i < store->count; i++)
+        {
+            assetRelease(store->entity[i].sprite);
+        }
+    }
+
+    free(store->acceleration);
+    free(store->bb);
+    free(store->deceleration);
+    free(store->distanceFall);
+    free(store->flags);
+    free(store->height);
+    free(store->jumpGravityFactor);
+    free(store->jumpTime);
+    free(store->jumpTimeMax);
+    free(store->velocity);
+    free(store->velocityFall);
+    free(store->velocityJump);
+    free(store->velocityMax);
+    free(store->width);
+    free(store->worldPosX);
+    free(store->worldPosY);
+    free(store->prevPosX);
+    free(store->prevPosY);
+    free(store->entity);
+    free(store);
+}
+
+/**
+ * @brief   Initialise entity store.
+ * @param   count the number of entities.
+ * @return  EntityStore on success, NULL on error.  See @ref struct EntityStore.
+ * @ingroup Entity
+ */
+EntityStore *entityStoreInit(uint32_t count)
+{
+    EntityStore *store = calloc(1, sizeof(struct entityStore_t));
+    if (NULL == store)
+    {
+        fprintf(stderr, "entityStoreInit(): error allocating memory.\n");
+        return NULL;
+    }
+
+    store->count             = count;
+    store->worldHeight       = 0;
+    store->worldGravitation  = 9.81;
+    store->worldMeterInPixel = 32;
+    store->worldWidth        = 0;
+
+    store->acceleration      = malloc(count * sizeof(double));
+    store->bb                = malloc(count * sizeof(AABB));
+    store->deceleration      = malloc(count * sizeof(double));
+    store->distanceFall      = malloc(count * sizeof(double));
+    store->flags             = malloc(count * sizeof(uint16_t));
+    store->height            = malloc(count * sizeof(uint8_t));
+    store->jumpGravityFactor = malloc(count * sizeof(double));
+    store->jumpTime          = malloc(count * sizeof(double));
+    store->jumpTimeMax       = malloc(count * sizeof(double));
+    store->velocity          = malloc(count * sizeof(double));
+    store->velocityFall      = malloc(count * sizeof(double));
+    store->velocityJump      = malloc(count * sizeof(double));
+    store->velocityMax       = malloc(count * sizeof(double));
+    store->width             = malloc(count * sizeof(uint8_t));
+    store->worldPosX         = malloc(count * sizeof(double));
+    store->worldPosY         = malloc(count * sizeof(double));
+    store->prevPosX          = malloc(count * sizeof(double));
+    store->prevPosY          = malloc(count * sizeof(double));
+    store->entity            = malloc(count * sizeof(struct entity_t));
+
+    if ((NULL == store->acceleration)      ||
+        (NULL == store->bb)                ||
+        (NULL == store->deceleration)      ||
+        (NULL == store->distanceFall)      ||
+        (NULL == store->flags)             ||
+        (NULL == store->height)            ||
+        (NULL == store->jumpGravityFactor) ||
+        (NULL == store->jumpTime)          ||
+        (NULL == store->jumpTimeMax)       ||
+        (NULL == store->velocity)          ||
+        (NULL == store->velocityFall)      ||
+        (NULL == store->velocityJump)      ||
+        (NULL == store->velocityMax)       ||
+        (NULL == store->width)             ||
+        (NULL == store->worldPosX)         ||
+        (NULL == store->worldPosY)         ||
+        (NULL == store->prevPosX)          ||
+        (NULL == store->prevPosY)          ||
+        (NULL == store->entity))
+    {
+        fprintf(stderr, "entityStoreInit(): error allocating memory.\n");
+        store->count = 0;
+        entityStoreFree(store);
+        return NULL;
+    }
+
+    // Default values.
+    for (uint32_t i = 0; i < count; i++)
+    {
+        store->height[i]            =  32;
+        store->width[i]             =  32;
+        store->bb[i].b              =   0;
+        store->bb[i].l              =   store->height[i];
+        store->bb[i].r              =   store->width[i];
+        store->bb[i].t              =   0;
+        store->acceleration[i]      = 400;
+        store->deceleration[i]      = 200;
+        store->distanceFall[i]      =   0;
+        store->flags[i]             =   0;
+        store->jumpGravityFactor[i] =   4.0;
+        store->jumpTime[i]          =   0.0;
+        store->jumpTimeMax[i]       =   0.12;
+        store->velocity[i]          =   0.0;
+        store->velocityFall[i]      =   0.0;
+        store->velocityJump[i]      =   0.0;
+        store->velocityMax[i]       = 100.0;
+        store->worldPosX[i]         =   0.0;
+        store->worldPosY[i]         =   0.0;
+        store->prevPosX[i]          =   0.0;
+        store->prevPosY[i]          =   0.0;
+
+        store->entity[i].fps          =  12;
+        store->entity[i].frame        =   0;
+        store->entity[i].frameEnd     =   WALK_MAX;
+        store->entity[i].frameStart   =   WALK;
+        store->entity[i].frameTime    =   0.0;
+        store->entity[i].frameYoffset =  32;
+        store->entity[i].respawnPosX  =   0.0;
+        store->entity[i].respawnPosY  =   0.0;
+        store->entity[i].sprite       =   NULL;
+    }
+
+    return store;
 }
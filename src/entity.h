@@ -8,13 +8,14 @@
 #include <SDL2/SDL.h>
 #include <stdint.h>
 #include "aabb.h"
+#include "map.h"
 
 /**
- * @def     entityFree()
- *          Free entity structure.
+ * @def     ENTITY_BATCH_SIZE
+ *          The number of entities entityFrameBatch() processes per pass.
  * @ingroup Entity
  */
-#define entityFree(entity) free(entity)
+#define ENTITY_BATCH_SIZE 64
 
 /**
  * @def     NUM_ENTITIES
@@ -46,44 +47,60 @@
  */
 typedef struct entity_t
 {
-    double      acceleration;
-    double      deceleration;
-    uint16_t    flags;
     double      fps;
+    uint8_t     frame;
     uint8_t     frameEnd;
     uint8_t     frameStart;
+    double      frameTime;
     uint16_t    frameYoffset;
-    uint8_t     height;
-    double      jumpGravityFactor;
-    double      jumpTimeMax;
     double      respawnPosX;
     double      respawnPosY;
-    double      velocityMax;
-    uint8_t     width;
+    SDL_Texture *sprite;
+} Entity;
+
+/**
+ * @ingroup Entity
+ */
+typedef struct entityStore_t
+{
+    uint32_t    count;
     uint32_t    worldHeight;
     double      worldGravitation;
     double      worldMeterInPixel;
-    double      worldPosX;
-    double      worldPosY;
     uint32_t    worldWidth;
-    /* These variables are used internally to store volatile values and usually
-     * do not have to be changed manually. */
-    AABB        bb;
-    double      distanceFall;
-    uint8_t     frame;
-    double      frameTime;
-    double      jumpTime;
-    double      velocityJump;
-    SDL_Texture *sprite;
-    double      velocity;
-    double      velocityFall;
-
-} Entity;
+    /* Fields touched by the physics every tick are stored in one array per
+     * field, indexed by entity.  See entityFrameBatch(). */
+    double      *acceleration;
+    AABB        *bb;
+    double      *deceleration;
+    double      *distanceFall;
+    uint16_t    *flags;
+    uint8_t     *height;
+    double      *jumpGravityFactor;
+    double      *jumpTime;
+    double      *jumpTimeMax;
+    double      *velocity;
+    double      *velocityFall;
+    double      *velocityJump;
+    double      *velocityMax;
+    uint8_t     *width;
+    double      *worldPosX;
+    double      *worldPosY;
+    // Position before the last tick, used to interpolate rendering.
+    double      *prevPosX;
+    double      *prevPosY;
+    // Animation and rendering.
+    Entity      *entity;
+} EntityStore;
 
-void   entityFrame(Entity *entity, double dTime);
-Entity *entityInit();
-int8_t entityLoadSprite(Entity *entity, SDL_Renderer *renderer, const char *filename);
-int8_t entityRender(SDL_Renderer *renderer, Entity *entity, double cameraPosX, double cameraPosY);
-void   entityRespawn(Entity *entity);
+void        entityCollide(EntityStore *store, uint32_t i, Map *map);
+void        entityFrame(EntityStore *store, uint32_t i, double dTime);
+void        entityFrameBatch(EntityStore *store, uint32_t first, uint32_t count, double dTime);
+void        entityInterpolate(EntityStore *store, uint32_t i, double alpha, double *posX, double *posY);
+int8_t      entityLoadSprite(EntityStore *store, uint32_t i, SDL_Renderer *renderer, const char *filename);
+int8_t      entityRender(SDL_Renderer *renderer, EntityStore *store, uint32_t i, double alpha, double cameraPosX, double cameraPosY);
+void        entityRespawn(EntityStore *store, uint32_t i);
+void        entityStoreFree(EntityStore *store);
+EntityStore *entityStoreInit(uint32_t count);
 
 #endif
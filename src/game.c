@@ -0,0 +1,335 @@
+/** @file game.c
+ * @ingroup   Game
+ * @defgroup  Game
+ * @brief     Game simulation.  Advances the game world by one fixed time step
+ *            and is independent from rendering and audio.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "game.h"
+
+/**
+ * @brief   Add the time passed since a timestamp to a subsystem timer.
+ * @param   game  the game.  See @ref struct Game.
+ * @param   timer the subsystem.  See TIMER_PHYSICS etc.
+ * @param   start timestamp returned by SDL_GetPerformanceCounter().  Updated
+ *                to the current time.
+ * @ingroup Game
+ */
+static void gameTime(Game *game, uint8_t timer, uint64_t *start)
+{
+    uint64_t now;
+
+    if (0 == game->timing)
+    {
+        return;
+    }
+
+    now                 = SDL_GetPerformanceCounter();
+    game->time[timer]  += (double)(now - *start) / SDL_GetPerformanceFrequency();
+    *start              = now;
+}
+
+/**
+ * @brief   Get a checksum of the simulation state.  Two runs with the same
+ *          input produce the same checksum.
+ * @param   game the game.  See @ref struct Game.
+ * @return  64-bit FNV-1a hash of the entity state.
+ * @ingroup Game
+ */
+uint64_t gameChecksum(Game *game)
+{
+    EntityStore *entity = game->entity;
+    uint64_t    hash    = 0xcbf29ce484222325;
+
+    const void *field[] =
+    {
+        entity->worldPosX,
+        entity->worldPosY,
+        entity->velocity,
+        entity->velocityFall,
+        entity->flags
+    };
+    const size_t size[] =
+    {
+        sizeof(double),
+        sizeof(double),
+        sizeof(double),
+        sizeof(double),
+        sizeof(uint16_t)
+    };
+
+    for (uint8_t f = 0; f < sizeof(size) / sizeof(size[0]); f++)
+    {
+        const uint8_t *byte = field[f];
+        for (size_t i = 0; i < entity->count * size[f]; i++)
+        {
+            hash ^= byte[i];
+            hash *= 0x100000001b3;
+        }
+    }
+
+    return hash;
+}
+
+/**
+ * @brief   Free game.  The map is not freed.
+ * @param   game the game.  See @ref struct Game.
+ * @ingroup Game
+ */
+void gameFree(Game *game)
+{
+    if (NULL == game)
+    {
+        return;
+    }
+
+    entityStoreFree(game->entity);
+    gridFree(game->grid);
+    free(game->contact);
+    free(game);
+}
+
+/**
+ * @brief   Initialise game and place the entities.
+ * @param   map         the map to play on.  See @ref struct Map.
+ * @param   numEntities the number of entities.  At least NUM_ENTITIES;
+ *                      additional entities are spread across the map.
+ * @return  Game on success, NULL on error.  See @ref struct Game.
+ * @ingroup Game
+ */
+Game *gameInit(Map *map, uint32_t numEntities)
+{
+    Game *game = malloc(sizeof(struct game_t));
+    if (NULL == game)
+    {
+        fprintf(stderr, "gameInit(): error allocating memory.\n");
+        return NULL;
+    }
+
+    if (numEntities < NUM_ENTITIES)
+    {
+        numEntities = NUM_ENTITIES;
+    }
+
+    game->map     = map;
+    game->delay   = 0;
+    game->events  = 0;
+    game->tick    = 0;
+    game->timing  = 0;
+    game->entity  = entityStoreInit(numEntities);
+    game->grid    = gridInit(map->width, map->height, GRID_CELL_SIZE);
+    game->contact = malloc(numEntities * sizeof(uint32_t));
+
+    for (uint8_t i = 0; i < NUM_TIMERS; i++)
+    {
+        game->time[i] = 0;
+    }
+
+    if ((NULL == game->entity) || (NULL == game->grid) || (NULL == game->contact))
+    {
+        fprintf(stderr, "gameInit(): error allocating memory.\n");
+        gameFree(game);
+        return NULL;
+    }
+
+    EntityStore *entity = game->entity;
+    entity->worldWidth  = map->width;
+    entity->worldHeight = map->height;
+
+    // Set up individual entities.
+    // Player.
+    entity->entity[PLAYER_ENTITY].frameYoffset =  64;
+    entity->entity[PLAYER_ENTITY].respawnPosX  =  32;
+    entity->entity[PLAYER_ENTITY].respawnPosY  = 608;
+    // NPCs.
+    entity->entity[1].frameYoffset =   64;
+    entity->entity[3].frameYoffset =   64;
+    entity->entity[5].frameYoffset =    0;
+    entity->entity[6].frameYoffset =    0;
+    entity->entity[1].respawnPosX  =  144;
+    entity->entity[1].respawnPosY  =  432;
+    entity->entity[2].respawnPosX  =  256;
+    entity->entity[2].respawnPosY  =   80;
+    entity->entity[3].respawnPosX  =  496;
+    entity->entity[3].respawnPosY  =  160;
+    entity->entity[4].respawnPosX  = 1776;
+    entity->entity[4].respawnPosY  =   80;
+    entity->entity[5].respawnPosX  = 1200;
+    entity->entity[5].respawnPosY  =   32;
+    entity->entity[6].respawnPosX  =  672;
+    entity->entity[6].respawnPosY  =  656;
+    // Additional NPCs; dropped from the sky on a fixed grid.
+    for (uint32_t i = NUM_ENTITIES; i < entity->count; i++)
+    {
+        uint32_t columns = map->width / entity->width[i];
+        entity->entity[i].frameYoffset = 32 * (i % 3);
+        entity->entity[i].respawnPosX  = (i % columns) * entity->width[i];
+        entity->entity[i].respawnPosY  = ((i / columns) % 4) * entity->height[i];
+    }
+
+    for (uint32_t i = 0; i < entity->count; i++)
+    {
+        entityRespawn(entity, i);
+    }
+
+    return game;
+}
+
+/**
+ * @brief   Advance the game by one time step.
+ * @param   game  the game.  See @ref struct Game.
+ * @param   input bit mask of the pressed buttons.  See INPUT_LEFT etc.
+ * @param   dTime the time step in seconds.
+ * @return  0 on success, -1 on error.
+ * @ingroup Game
+ */
+int8_t gameTick(Game *game, uint16_t input, double dTime)
+{
+    EntityStore *entity = game->entity;
+    uint64_t    start   = 0;
+
+    game->events = 0;
+    if (game->timing)
+    {
+        start = SDL_GetPerformanceCounter();
+    }
+
+    // Keep the previous state for render interpolation.
+    memcpy(entity->prevPosX, entity->worldPosX, entity->count * sizeof(double));
+    memcpy(entity->prevPosY, entity->worldPosY, entity->count * sizeof(double));
+
+    entityFrameBatch(entity, 0, entity->count, dTime);
+    gameTime(game, TIMER_PHYSICS, &start);
+
+    for (uint32_t i = 0; i < entity->count; i++)
+    {
+        entityCollide(entity, i, game->map);
+        if ((entity->flags[i] >> IS_DEAD) & 1)
+        {
+            if (PLAYER_ENTITY != i)
+            {
+                game->events |= 1 << EVENT_IMPACT;
+                entityRespawn(entity, i);
+            }
+        }
+    }
+
+    gameTime(game, TIMER_COLLISION, &start);
+
+    if ((entity->flags[PLAYER_ENTITY] >> IS_DEAD) & 1)
+    {
+        if (0 == game->delay)
+        {
+            game->events |= 1 << EVENT_DEAD;
+        }
+        game->delay += dTime;
+
+        if (game->delay > 2)
+        {
+            entity->flags[PLAYER_ENTITY] &= ~(1 << IS_DEAD);
+            for (uint32_t i = 0; i < entity->count; i++)
+                entityRespawn(entity, i);
+            game->delay =  0;
+        }
+    }
+
+    // Process input.
+    // Reset IN_MOTION flag (in case no button is pressed).
+    entity->flags[PLAYER_ENTITY] &= ~(1 << IN_MOTION);
+
+    if ((input >> INPUT_RUN) & 1)
+    {
+        // Allow running only when not in mid-air.
+        if (0 == ((entity->flags[PLAYER_ENTITY] >> IN_MID_AIR) & 1))
+        {
+            entity->velocityMax[PLAYER_ENTITY]       = 250;
+            entity->entity[PLAYER_ENTITY].frameStart = RUN;
+            entity->entity[PLAYER_ENTITY].frameEnd   = RUN_MAX;
+        }
+    }
+    else
+    {
+        // Don't allow to slow down in mid-air.
+        if (0 == ((entity->flags[PLAYER_ENTITY] >> IN_MID_AIR) & 1))
+        {
+            entity->velocityMax[PLAYER_ENTITY]       = 100;
+            entity->entity[PLAYER_ENTITY].frameStart = WALK;
+            entity->entity[PLAYER_ENTITY].frameEnd   = WALK_MAX;
+        }
+    }
+
+    if ((input >> INPUT_LEFT) & 1)
+    {
+        if (0 == ((entity->flags[PLAYER_ENTITY] >> DIRECTION) & 1))
+        {
+            entity->velocity[PLAYER_ENTITY] = -entity->velocity[PLAYER_ENTITY];
+        }
+        entity->flags[PLAYER_ENTITY] |= 1 << IN_MOTION;
+        entity->flags[PLAYER_ENTITY] |= 1 << DIRECTION;
+    }
+
+    if ((input >> INPUT_RIGHT) & 1)
+    {
+        if ((entity->flags[PLAYER_ENTITY] >> DIRECTION) & 1)
+        {
+            entity->velocity[PLAYER_ENTITY] = -entity->velocity[PLAYER_ENTITY];
+        }
+
+        entity->flags[PLAYER_ENTITY] |= 1   << IN_MOTION;
+        entity->flags[PLAYER_ENTITY] &= ~(1 << DIRECTION);
+    }
+
+    if (0 == ((entity->flags[PLAYER_ENTITY] >> IN_MID_AIR) & 1))
+    {
+        if ((input >> INPUT_JUMP) & 1)
+        {
+            game->events                        |= 1 << EVENT_JUMP;
+            entity->flags[PLAYER_ENTITY]        |= 1 << IS_JUMPING;
+            entity->velocityJump[PLAYER_ENTITY]  = entity->velocity[PLAYER_ENTITY];
+        }
+    }
+
+    gameTime(game, TIMER_LOGIC, &start);
+
+    // Set NPC behavior.
+    gridClear(game->grid);
+    for (uint32_t i = 0; i < entity->count; i++)
+    {
+        if (-1 == gridInsert(game->grid, i, entity->bb[i]))
+        {
+            return -1;
+        }
+    }
+
+    uint32_t numContacts = gridQuery(game->grid, entity->bb[PLAYER_ENTITY], game->contact, entity->count);
+    for (uint32_t j = 0; j < numContacts; j++)
+    {
+        uint32_t i = game->contact[j];
+        if (PLAYER_ENTITY == i)
+        {
+            continue;
+        }
+
+        if (entity->worldPosX[PLAYER_ENTITY] > entity->worldPosX[i])
+        {
+            entity->flags[i] |= 1 << DIRECTION;
+        }
+        else
+        {
+            entity->flags[i] &= ~(1 << DIRECTION);
+        }
+
+        entity->flags[i] |= 1 << IN_MOTION;
+    }
+
+    gameTime(game, TIMER_BROADPHASE, &start);
+    game->tick++;
+
+    return 0;
+}
@@ -0,0 +1,54 @@
+/** @file game.h
+ * @ingroup Game
+ */
+
+#ifndef GAME_h
+#define GAME_h
+
+#include <stdint.h>
+#include "entity.h"
+#include "grid.h"
+#include "map.h"
+
+// Input bits.
+#define INPUT_LEFT   0
+#define INPUT_RIGHT  1
+#define INPUT_JUMP   2
+#define INPUT_RUN    3
+
+// Event bits.
+#define EVENT_DEAD    0
+#define EVENT_IMPACT  1
+#define EVENT_JUMP    2
+
+// Subsystem timers.
+#define TIMER_PHYSICS      0
+#define TIMER_COLLISION    1
+#define TIMER_BROADPHASE   2
+#define TIMER_LOGIC        3
+#define NUM_TIMERS         4
+
+/**
+ * @ingroup Game
+ */
+typedef struct game_t
+{
+    EntityStore *entity;
+    Grid        *grid;
+    Map         *map;
+    uint32_t    *contact;
+    double      delay;
+    uint16_t    events;
+    uint32_t    tick;
+    /* Time spent per subsystem in seconds.  Only measured if timing is
+     * enabled. */
+    uint8_t     timing;
+    double      time[NUM_TIMERS];
+} Game;
+
+uint64_t gameChecksum(Game *game);
+void     gameFree(Game *game);
+Game     *gameInit(Map *map, uint32_t numEntities);
+int8_t   gameTick(Game *game, uint16_t input, double dTime);
+
+#endif
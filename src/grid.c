@@ -0,0 +1,301 @@
+/** @file grid.c
+ * @ingroup   Grid
+ * @defgroup  Grid
+ * @brief     Uniform grid broadphase to find overlapping bounding boxes
+ *            without testing every box against every other box.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "grid.h"
+
+/**
+ * @brief   Get the range of cells covered by a bounding box.  Boxes outside
+ *          the grid are clamped to its border cells.
+ * @param   grid the grid.
+ * @param   bb   the bounding box.  See @ref struct AABB.
+ * @param   x0   first column.
+ * @param   y0   first row.
+ * @param   x1   last column.
+ * @param   y1   last row.
+ * @ingroup Grid
+ */
+static void gridCellRange(Grid *grid, AABB bb, uint32_t *x0, uint32_t *y0, uint32_t *x1, uint32_t *y1)
+{
+    double l = bb.l / grid->cellSize;
+    double t = bb.t / grid->cellSize;
+    double r = bb.r / grid->cellSize;
+    double b = bb.b / grid->cellSize;
+
+    *x0 = (l < 0) ? 0 : (l >= grid->cellsX) ? grid->cellsX - 1 : (uint32_t)l;
+    *y0 = (t < 0) ? 0 : (t >= grid->cellsY) ? grid->cellsY - 1 : (uint32_t)t;
+    *x1 = (r < 0) ? 0 : (r >= grid->cellsX) ? grid->cellsX - 1 : (uint32_t)r;
+    *y1 = (b < 0) ? 0 : (b >= grid->cellsY) ? grid->cellsY - 1 : (uint32_t)b;
+}
+
+/**
+ * @brief   Remove all items from the grid.  Only the cells which have been
+ *          used since the last call are reset.
+ * @param   grid the grid.
+ * @ingroup Grid
+ */
+void gridClear(Grid *grid)
+{
+    for (uint32_t i = 0; i < grid->numUsedCells; i++)
+    {
+        grid->cellHead[grid->usedCell[i]] = -1;
+    }
+
+    grid->numUsedCells = 0;
+    grid->numNodes     = 0;
+}
+
+/**
+ * @brief   Free grid.
+ * @param   grid the grid.
+ * @ingroup Grid
+ */
+void gridFree(Grid *grid)
+{
+    if (NULL == grid)
+    {
+        return;
+    }
+
+    free(grid->cellHead);
+    free(grid->usedCell);
+    free(grid->node);
+    free(grid->bb);
+    free(grid->stamp);
+    free(grid);
+}
+
+/**
+ * @brief   Initialise grid.
+ * @param   width    width of the covered area in pixels.
+ * @param   height   height of the covered area in pixels.
+ * @param   cellSize edge length of a cell.  See @ref GRID_CELL_SIZE.
+ * @return  Grid on success, NULL on error.  See @ref struct Grid.
+ * @ingroup Grid
+ */
+Grid *gridInit(double width, double height, double cellSize)
+{
+    Grid *grid = malloc(sizeof(struct grid_t));
+    if (NULL == grid)
+    {
+        fprintf(stderr, "gridInit(): error allocating memory.\n");
+        return NULL;
+    }
+
+    grid->cellSize     = cellSize;
+    grid->cellsX       = (width  / cellSize) + 1;
+    grid->cellsY       = (height / cellSize) + 1;
+    grid->numUsedCells = 0;
+    grid->node         = NULL;
+    grid->numNodes     = 0;
+    grid->maxNodes     = 0;
+    grid->bb           = NULL;
+    grid->stamp        = NULL;
+    grid->maxItems     = 0;
+    grid->queryStamp   = 0;
+
+    grid->cellHead = malloc(grid->cellsX * grid->cellsY * sizeof(int32_t));
+    grid->usedCell = malloc(grid->cellsX * grid->cellsY * sizeof(uint32_t));
+    if ((NULL == grid->cellHead) || (NULL == grid->usedCell))
+    {
+        fprintf(stderr, "gridInit(): error allocating memory.\n");
+        gridFree(grid);
+        return NULL;
+    }
+
+    for (uint32_t i = 0; i < grid->cellsX * grid->cellsY; i++)
+    {
+        grid->cellHead[i] = -1;
+    }
+
+    return grid;
+}
+
+/**
+ * @brief   Insert an item into every cell its bounding box overlaps.
+ * @param   grid the grid.
+ * @param   id   ID of the item, e.g. the entity index.  IDs should be dense
+ *               as per-item data is stored in arrays indexed by ID.
+ * @param   bb   bounding box of the item.  See @ref struct AABB.
+ * @return  0 on success, -1 on error.
+ * @ingroup Grid
+ */
+int8_t gridInsert(Grid *grid, uint32_t id, AABB bb)
+{
+    uint32_t x0, y0, x1, y1;
+
+    if (id >= grid->maxItems)
+    {
+        uint32_t maxItems = grid->maxItems ? grid->maxItems : 64;
+        while (id >= maxItems)
+        {
+            maxItems *= 2;
+        }
+
+        AABB     *itemBB    = realloc(grid->bb,    maxItems * sizeof(AABB));
+        if (NULL == itemBB)
+        {
+            fprintf(stderr, "gridInsert(): error allocating memory.\n");
+            return -1;
+        }
+        grid->bb = itemBB;
+
+        uint32_t *itemStamp = realloc(grid->stamp, maxItems * sizeof(uint32_t));
+        if (NULL == itemStamp)
+        {
+            fprintf(stderr, "gridInsert(): error allocating memory.\n");
+            return -1;
+        }
+        grid->stamp = itemStamp;
+
+        for (uint32_t i = grid->maxItems; i < maxItems; i++)
+        {
+            grid->stamp[i] = 0;
+        }
+        grid->maxItems = maxItems;
+    }
+
+    grid->bb[id] = bb;
+    gridCellRange(grid, bb, &x0, &y0, &x1, &y1);
+
+    for (uint32_t y = y0; y <= y1; y++)
+    {
+        for (uint32_t x = x0; x <= x1; x++)
+        {
+            uint32_t cell = (y * grid->cellsX) + x;
+
+            if (grid->numNodes == grid->maxNodes)
+            {
+                uint32_t maxNodes = grid->maxNodes ? grid->maxNodes * 2 : 256;
+                GridNode *node    = realloc(grid->node, maxNodes * sizeof(struct gridNode_t));
+                if (NULL == node)
+                {
+                    fprintf(stderr, "gridInsert(): error allocating memory.\n");
+                    return -1;
+                }
+                grid->node     = node;
+                grid->maxNodes = maxNodes;
+            }
+
+            if (-1 == grid->cellHead[cell])
+            {
+                grid->usedCell[grid->numUsedCells] = cell;
+                grid->numUsedCells++;
+            }
+
+            grid->node[grid->numNodes].id   = id;
+            grid->node[grid->numNodes].next = grid->cellHead[cell];
+            grid->cellHead[cell]            = grid->numNodes;
+            grid->numNodes++;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Report every pair of overlapping items exactly once.  A pair that
+ *          shares several cells is only reported in the first cell both items
+ *          cover.
+ * @param   grid     the grid.
+ * @param   callback function called for every overlapping pair.
+ * @param   userdata passed through to callback.
+ * @ingroup Grid
+ */
+void gridPairs(Grid *grid, void (*callback)(uint32_t idA, uint32_t idB, void *userdata), void *userdata)
+{
+    for (uint32_t i = 0; i < grid->numUsedCells; i++)
+    {
+        uint32_t cell  = grid->usedCell[i];
+        uint32_t cellX = cell % grid->cellsX;
+        uint32_t cellY = cell / grid->cellsX;
+
+        for (int32_t a = grid->cellHead[cell]; -1 != a; a = grid->node[a].next)
+        {
+            uint32_t idA = grid->node[a].id;
+            uint32_t ax0, ay0, ax1, ay1;
+            gridCellRange(grid, grid->bb[idA], &ax0, &ay0, &ax1, &ay1);
+
+            for (int32_t b = grid->node[a].next; -1 != b; b = grid->node[b].next)
+            {
+                uint32_t idB = grid->node[b].id;
+                uint32_t bx0, by0, bx1, by1;
+
+                if ((idA == idB) || (0 == doIntersect(grid->bb[idA], grid->bb[idB])))
+                {
+                    continue;
+                }
+
+                gridCellRange(grid, grid->bb[idB], &bx0, &by0, &bx1, &by1);
+                if ((cellX != ((ax0 > bx0) ? ax0 : bx0)) || (cellY != ((ay0 > by0) ? ay0 : by0)))
+                {
+                    continue;
+                }
+
+                callback(idA, idB, userdata);
+            }
+        }
+    }
+}
+
+/**
+ * @brief   Find all items overlapping a region.
+ * @param   grid       the grid.
+ * @param   bb         the region.  See @ref struct AABB.
+ * @param   result     receives the IDs of the overlapping items.
+ * @param   maxResults capacity of result.
+ * @return  The number of IDs written to result.
+ * @ingroup Grid
+ */
+uint32_t gridQuery(Grid *grid, AABB bb, uint32_t *result, uint32_t maxResults)
+{
+    uint32_t x0, y0, x1, y1;
+    uint32_t numResults = 0;
+
+    grid->queryStamp++;
+    if (0 == grid->queryStamp)
+    {
+        // Stamp counter wrapped around; reset all stamps.
+        for (uint32_t i = 0; i < grid->maxItems; i++)
+        {
+            grid->stamp[i] = 0;
+        }
+        grid->queryStamp = 1;
+    }
+
+    gridCellRange(grid, bb, &x0, &y0, &x1, &y1);
+    for (uint32_t y = y0; y <= y1; y++)
+    {
+        for (uint32_t x = x0; x <= x1; x++)
+        {
+            for (int32_t n = grid->cellHead[(y * grid->cellsX) + x]; -1 != n; n = grid->node[n].next)
+            {
+                uint32_t id = grid->node[n].id;
+                if (grid->queryStamp == grid->stamp[id])
+                {
+                    continue;
+                }
+                grid->stamp[id] = grid->queryStamp;
+
+                if (doIntersect(bb, grid->bb[id]))
+                {
+                    result[numResults] = id;
+                    numResults++;
+                    if (numResults == maxResults)
+                    {
+                        return numResults;
+                    }
+                }
+            }
+        }
+    }
+
+    return numResults;
+}
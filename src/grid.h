@@ -0,0 +1,59 @@
+/** @file grid.h
+ * @ingroup Grid
+ */
+
+#ifndef GRID_h
+#define GRID_h
+
+#include <stdint.h>
+#include "aabb.h"
+
+/**
+ * @def     GRID_CELL_SIZE
+ *          Edge length of a grid cell in pixels.  Should be about twice the
+ *          size of a typical entity.
+ * @ingroup Grid
+ */
+#define GRID_CELL_SIZE 64
+
+/**
+ * @ingroup Grid
+ */
+typedef struct gridNode_t
+{
+    uint32_t id;
+    int32_t  next;
+} GridNode;
+
+/**
+ * @ingroup Grid
+ */
+typedef struct grid_t
+{
+    double   cellSize;
+    uint32_t cellsX;
+    uint32_t cellsY;
+    /* Every cell holds a linked list of nodes; cellHead is -1 for empty cells.
+     * usedCell lists the non-empty cells so gridClear() doesn't have to visit
+     * the whole grid. */
+    int32_t  *cellHead;
+    uint32_t *usedCell;
+    uint32_t numUsedCells;
+    GridNode *node;
+    uint32_t numNodes;
+    uint32_t maxNodes;
+    /* Bounding box and query stamp of every item, indexed by its ID. */
+    AABB     *bb;
+    uint32_t *stamp;
+    uint32_t maxItems;
+    uint32_t queryStamp;
+} Grid;
+
+void     gridClear(Grid *grid);
+void     gridFree(Grid *grid);
+Grid     *gridInit(double width, double height, double cellSize);
+int8_t   gridInsert(Grid *grid, uint32_t id, AABB bb);
+void     gridPairs(Grid *grid, void (*callback)(uint32_t idA, uint32_t idB, void *userdata), void *userdata);
+uint32_t gridQuery(Grid *grid, AABB bb, uint32_t *result, uint32_t maxResults);
+
+#endif
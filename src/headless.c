@@ -0,0 +1,132 @@
+/** @file headless.c
+ * @ingroup   Headless
+ * @defgroup  Headless
+ * @brief     Run the simulation without video and audio.  Used to benchmark
+ *            the simulation and to compare world states between builds.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <SDL2/SDL.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "game.h"
+#include "headless.h"
+#include "map.h"
+
+/**
+ * @brief   Get the scripted input for a tick.  The player runs back and
+ *          forth across the map and jumps at regular intervals.
+ * @param   tick the current tick.
+ * @return  Input bits.  See INPUT_LEFT etc.
+ * @ingroup Headless
+ */
+static uint16_t headlessInput(uint32_t tick)
+{
+    uint16_t input = 0;
+
+    if ((tick / 600) % 2)
+    {
+        input |= 1 << INPUT_LEFT;
+    }
+    else
+    {
+        input |= 1 << INPUT_RIGHT;
+    }
+
+    if ((tick / 240) % 2)
+    {
+        input |= 1 << INPUT_RUN;
+    }
+
+    if (tick % 90 < 15)
+    {
+        input |= 1 << INPUT_JUMP;
+    }
+
+    return input;
+}
+
+/**
+ * @brief   Load the map and advance the simulation as fast as possible.
+ *          Prints ticks per second, the time spent per subsystem and a
+ *          checksum of the final world state.
+ * @param   mapFilename the map to simulate.
+ * @param   config      the configuration.  The Headless and Simulation
+ *                      sections are used.  See @ref struct Config.
+ * @param   replay      recording to play instead of the scripted input, or
+ *                      to record the scripted input to.  May be NULL.  See
+ *                      @ref struct Replay.
+ * @return  0 on success, -1 on error.
+ * @ingroup Headless
+ */
+int8_t headlessRun(const char *mapFilename, const Config *config, Replay *replay)
+{
+    int8_t   execStatus  = 0;
+    double   step        = 1.0 / config->simulation.tickRate;
+    double   frequency   = SDL_GetPerformanceFrequency();
+    uint32_t ticks       = config->headless.ticks;
+    uint32_t numEntities = config->headless.entities;
+    Game     *game       = NULL;
+    uint64_t timeA;
+    uint64_t timeB;
+
+    if (replay && (REPLAY_PLAY == replay->mode))
+    {
+        step        = 1.0 / replay->tickRate;
+        ticks       = replay->numTicks;
+        numEntities = replay->numEntities;
+    }
+
+    timeA = SDL_GetPerformanceCounter();
+    Map *map = mapInit(NULL, mapFilename);
+    if (NULL == map)
+    {
+        return -1;
+    }
+
+    game = gameInit(map, numEntities);
+    if (NULL == game)
+    {
+        execStatus = -1;
+        goto quit;
+    }
+    timeB = SDL_GetPerformanceCounter();
+    printf("Loaded %s with %" PRIu32 " entities in %.3f ms.\n",
+           mapFilename, game->entity->count, (timeB - timeA) / frequency * 1000);
+
+    game->timing = 1;
+    timeA        = SDL_GetPerformanceCounter();
+    for (uint32_t tick = 0; tick < ticks; tick++)
+    {
+        if (-1 == gameTick(game, replayInput(replay, headlessInput(tick)), step))
+        {
+            execStatus = -1;
+            goto quit;
+        }
+
+        if (-1 == replayVerify(replay, game))
+        {
+            execStatus = -1;
+            goto quit;
+        }
+    }
+    timeB = SDL_GetPerformanceCounter();
+
+    double seconds = (timeB - timeA) / frequency;
+    printf("Ticks:      %" PRIu32 "\n", ticks);
+    printf("Time:       %.3f s\n", seconds);
+    printf("Ticks/sec:  %.1f\n", ticks / seconds);
+    printf("Physics:    %.3f ms\n", game->time[TIMER_PHYSICS]    * 1000);
+    printf("Collision:  %.3f ms\n", game->time[TIMER_COLLISION]  * 1000);
+    printf("Logic:      %.3f ms\n", game->time[TIMER_LOGIC]      * 1000);
+    printf("Broadphase: %.3f ms\n", game->time[TIMER_BROADPHASE] * 1000);
+    printf("Checksum:   %016" PRIx64 "\n", gameChecksum(game));
+
+    quit:
+    gameFree(game);
+    mapFree(map);
+
+    return execStatus;
+}
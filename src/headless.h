@@ -0,0 +1,14 @@
+/** @file headless.h
+ * @ingroup Headless
+ */
+
+#ifndef HEADLESS_h
+#define HEADLESS_h
+
+#include <stdint.h>
+#include "config.h"
+#include "replay.h"
+
+int8_t headlessRun(const char *mapFilename, const Config *config, Replay *replay);
+
+#endif
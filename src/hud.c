@@ -6,10 +6,78 @@
  * @copyright "THE BEER-WARE LICENCE" (Revision 42)
  */
 
-#include <SDL2/SDL_image.h>
+#include <SDL2/SDL.h>
 #include <stdio.h>
+#include "asset.h"
 #include "hud.h"
 
+/**
+ * @brief   Render a progress bar, e.g. while loading.  Can be used as
+ *          progress callback of the loader.  See @ref struct Loader.
+ * @param   done     finished steps.
+ * @param   total    overall number of steps.
+ * @param   renderer SDL's rendering context.  See @ref struct Video.
+ * @ingroup HUD
+ */
+void hudProgress(uint32_t done, uint32_t total, void *renderer)
+{
+    int32_t width;
+    int32_t height;
+
+    SDL_RenderGetLogicalSize(renderer, &width, &height);
+
+    SDL_Rect frame =
+    {
+        width  / 4,
+        height / 2 - 4,
+        width  / 2,
+        8
+    };
+    SDL_Rect inner =
+    {
+        frame.x + 1,
+        frame.y + 1,
+        frame.w - 2,
+        frame.h - 2
+    };
+    SDL_Rect bar =
+    {
+        frame.x + 2,
+        frame.y + 2,
+        total ? (frame.w - 4) * done / total : 0,
+        frame.h - 4
+    };
+
+    SDL_SetRenderDrawColor(renderer, 0x00, 0x00, 0x00, 0xff);
+    SDL_RenderClear(renderer);
+    SDL_SetRenderDrawColor(renderer, 0xff, 0xff, 0xff, 0xff);
+    SDL_RenderFillRect(renderer, &frame);
+    SDL_SetRenderDrawColor(renderer, 0x00, 0x00, 0x00, 0xff);
+    SDL_RenderFillRect(renderer, &inner);
+    SDL_SetRenderDrawColor(renderer, 0xff, 0xff, 0xff, 0xff);
+    SDL_RenderFillRect(renderer, &bar);
+    SDL_RenderPresent(renderer);
+
+    // Leave the default draw colour for SDL_RenderClear().
+    SDL_SetRenderDrawColor(renderer, 0x00, 0x00, 0x00, 0xff);
+}
+
+/**
+ * @brief   Free icon.
+ * @param   icon the icon structure.  See @ref struct Icon.
+ * @ingroup HUD
+ */
+void iconFree(Icon *icon)
+{
+    if (NULL == icon)
+    {
+        return;
+    }
+
+    assetRelease(icon->icon);
+    free(icon);
+}
+
 /**
  * @brief   Initialise icon.  See @ref struct Icon.
  * @param   filename the image file to load.
@@ -30,10 +98,9 @@ Icon *iconInit(SDL_Renderer *renderer, const char *filename)
     icon->height = 32;
     icon->width  = 32;
 
-    icon->icon = IMG_LoadTexture(renderer, filename);
+    icon->icon = assetTexture(renderer, filename);
     if (NULL == icon->icon)
     {
-        fprintf(stderr, "%s\n", SDL_GetError());
         free(icon);
         return NULL;
     }
@@ -8,13 +8,6 @@
 #include <SDL2/SDL.h>
 #include <stdint.h>
 
-/**
- * @def     iconFree()
- *          Free icon structure.
- * @ingroup HUD
- */
-#define iconFree(icon) free(icon)
-
 /**
  * @ingroup HUD
  */
@@ -26,6 +19,8 @@ typedef struct icon_t {
     uint8_t     width;
 } Icon;
 
+void   hudProgress(uint32_t done, uint32_t total, void *renderer);
+void   iconFree(Icon *icon);
 Icon   *iconInit(SDL_Renderer *renderer, const char *filename);
 int8_t iconRender(SDL_Renderer *renderer, Icon *icon, double cameraPosX, double cameraPosY);
 
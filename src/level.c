@@ -0,0 +1,214 @@
+/** @file level.c
+ * @ingroup   Level
+ * @defgroup  Level
+ * @brief     Level manager.  All maps of a session share one tileset
+ *            manager, and the next map is loaded on a background thread
+ *            while the current one is played, so switching levels only
+ *            swaps pointers and uploads the few images that are new.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "level.h"
+#include "trace.h"
+
+/**
+ * @brief   Preload thread.  Parses the next map, decodes its tile layers and
+ *          compiles its attributes.
+ * @param   data the level manager.  See @ref struct Level.
+ * @return  Always 0.
+ * @ingroup Level
+ */
+static int levelWorker(void *data)
+{
+    Level *level = data;
+
+    traceBegin("levelPreload");
+    level->next = mapInitShared(level->tilesets, level->nextFilename);
+    traceEnd("levelPreload");
+
+    SDL_AtomicSet(&level->ready, 1);
+
+    return 0;
+}
+
+/**
+ * @brief   Wait for the preload thread.  The tileset manager may be used
+ *          again afterwards.
+ * @param   level the level manager.  See @ref struct Level.
+ * @ingroup Level
+ */
+static void levelWait(Level *level)
+{
+    if (NULL == level->thread)
+    {
+        return;
+    }
+
+    traceBegin("levelWait");
+    SDL_WaitThread(level->thread, NULL);
+    traceEnd("levelWait");
+    level->thread = NULL;
+}
+
+/**
+ * @brief   Free level manager and a preloaded map that hasn't been switched
+ *          to.  All maps returned by the level manager have to be freed
+ *          before, since they share its tilesets.
+ * @param   level the level manager.  See @ref struct Level.
+ * @ingroup Level
+ */
+void levelFree(Level *level)
+{
+    if (NULL == level)
+    {
+        return;
+    }
+
+    levelWait(level);
+    mapFree(level->next);
+    tmx_free_tileset_manager(level->tilesets);
+    free(level);
+}
+
+/**
+ * @brief   Initialise level manager.  Has to be called on the thread that
+ *          owns the renderer.
+ * @param   renderer SDL's rendering context used to load the tileset
+ *                   images.  See @ref struct Video.
+ * @return  Level on success, NULL on error.  See @ref struct Level.
+ * @ingroup Level
+ */
+Level *levelInit(SDL_Renderer *renderer)
+{
+    Level *level = malloc(sizeof(struct level_t));
+    if (NULL == level)
+    {
+        fprintf(stderr, "levelInit(): error allocating memory.\n");
+        return NULL;
+    }
+
+    level->renderer     = renderer;
+    level->thread       = NULL;
+    level->nextFilename = NULL;
+    level->next         = NULL;
+    SDL_AtomicSet(&level->ready, 0);
+
+    mapInitContext(&level->ctx, &level->images, renderer);
+    level->tilesets = tmx_ctx_make_tileset_manager(&level->ctx);
+    if (NULL == level->tilesets)
+    {
+        fprintf(stderr, "%s\n", tmx_ctx_strerr(&level->ctx));
+        free(level);
+        return NULL;
+    }
+
+    return level;
+}
+
+/**
+ * @brief   Load a map right away, e.g. the first level.  Waits for a
+ *          running preload, which is kept.
+ * @param   level    the level manager.  See @ref struct Level.
+ * @param   filename the TMX map file to load.
+ * @return  Map on success, NULL on error.
+ * @ingroup Level
+ */
+Map *levelLoad(Level *level, const char *filename)
+{
+    levelWait(level);
+
+    Map *map = mapInitShared(level->tilesets, filename);
+    if (map)
+    {
+        mapUpload(&level->images, map);
+    }
+
+    return map;
+}
+
+/**
+ * @brief   Start loading the next map on a background thread.
+ * @param   level    the level manager.  See @ref struct Level.
+ * @param   filename the TMX map file to load.  Has to stay valid until the
+ *                   map is switched to or the level manager is freed.
+ * @return  0 on success, -1 on error.
+ * @ingroup Level
+ */
+int8_t levelPreload(Level *level, const char *filename)
+{
+    if (level->nextFilename)
+    {
+        fprintf(stderr, "levelPreload(): %s is already preloaded.\n", level->nextFilename);
+        return -1;
+    }
+
+    level->nextFilename = filename;
+    level->next         = NULL;
+    SDL_AtomicSet(&level->ready, 0);
+
+    level->thread = SDL_CreateThread(levelWorker, "level", level);
+    if (NULL == level->thread)
+    {
+        fprintf(stderr, "%s\n", SDL_GetError());
+        level->nextFilename = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Check whether the preloaded map is ready, so that switching to it
+ *          won't block.
+ * @param   level the level manager.  See @ref struct Level.
+ * @return  1 if the preload has finished, 0 otherwise.
+ * @ingroup Level
+ */
+int8_t levelReady(Level *level)
+{
+    return SDL_AtomicGet(&level->ready);
+}
+
+/**
+ * @brief   Switch to the next map.  The preloaded map is taken over if it is
+ *          the requested one, waiting for it if it isn't ready yet.
+ *          Otherwise the preload is dropped and the map is loaded right
+ *          away.  The previous map has to be freed by the caller.
+ * @param   level    the level manager.  See @ref struct Level.
+ * @param   filename the TMX map file to switch to.
+ * @return  Map on success, NULL on error.
+ * @ingroup Level
+ */
+Map *levelSwitch(Level *level, const char *filename)
+{
+    levelWait(level);
+
+    Map        *map          = level->next;
+    const char *nextFilename = level->nextFilename;
+
+    level->next         = NULL;
+    level->nextFilename = NULL;
+    SDL_AtomicSet(&level->ready, 0);
+
+    if ((NULL == nextFilename) || (0 != strcmp(filename, nextFilename)))
+    {
+        mapFree(map);
+        return levelLoad(level, filename);
+    }
+
+    // The preload failed, its error has already been reported.
+    if (NULL == map)
+    {
+        return NULL;
+    }
+
+    traceBegin("mapUpload");
+    mapUpload(&level->images, map);
+    traceEnd("mapUpload");
+
+    return map;
+}
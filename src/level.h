@@ -0,0 +1,40 @@
+/** @file level.h
+ * @ingroup Level
+ */
+
+#ifndef LEVEL_h
+#define LEVEL_h
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include "map.h"
+#include "tmx/tmx.h"
+#include "tmx/tsx.h"
+
+/**
+ * @ingroup Level
+ */
+typedef struct level_t
+{
+    SDL_Renderer        *renderer;
+    /* One tileset manager for the whole session.  Every map is loaded with
+     * it, so tilesets are parsed and uploaded once.  It must never be used
+     * by two threads at once, see levelWait(). */
+    tmx_ctx             ctx;
+    MapImages           images;
+    tmx_tileset_manager *tilesets;
+    // Preload of the next map.  See levelPreload().
+    SDL_Thread          *thread;
+    const char          *nextFilename;
+    Map                 *next;
+    SDL_atomic_t        ready;
+} Level;
+
+void   levelFree(Level *level);
+Level  *levelInit(SDL_Renderer *renderer);
+Map    *levelLoad(Level *level, const char *filename);
+int8_t levelPreload(Level *level, const char *filename);
+int8_t levelReady(Level *level);
+Map    *levelSwitch(Level *level, const char *filename);
+
+#endif
@@ -0,0 +1,338 @@
+/** @file loader.c
+ * @ingroup   Loader
+ * @defgroup  Loader
+ * @brief     Asynchronous asset loader.  Image files are decoded into
+ *            surfaces and sound files into Mix_Chunks and Mix_Music on a pool
+ *            of worker threads.  The main thread only uploads the surfaces
+ *            to the GPU and adds everything to the asset cache, so later
+ *            requests for the same files are cache hits.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <SDL2/SDL_image.h>
+#include <SDL2/SDL_mixer.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "archive.h"
+#include "asset.h"
+#include "loader.h"
+#include "trace.h"
+
+/**
+ * @brief   Decode a file.  Runs on a worker thread.
+ * @param   job the job.  See @ref struct LoaderJob.
+ * @ingroup Loader
+ */
+static void loaderDecode(LoaderJob *job)
+{
+    traceBegin("loaderDecode");
+    switch (job->type)
+    {
+        case ASSET_TEXTURE:
+            job->data = IMG_Load_RW(archiveRW(job->path), 1);
+            break;
+        case ASSET_SFX:
+            job->data = Mix_LoadWAV_RW(archiveRW(job->path), 1);
+            break;
+        default:
+            job->data = Mix_LoadMUS_RW(archiveRW(job->path), 1);
+            break;
+    }
+    traceEnd("loaderDecode");
+
+    if (NULL == job->data)
+    {
+        fprintf(stderr, "%s: %s\n", job->path, SDL_GetError());
+    }
+}
+
+/**
+ * @brief   Upload a decoded file and add it to the asset cache.  Runs on the
+ *          main thread.
+ * @param   loader the loader.  See @ref struct Loader.
+ * @param   job    the job.  See @ref struct LoaderJob.
+ * @ingroup Loader
+ */
+static void loaderUpload(Loader *loader, LoaderJob *job)
+{
+    void *data = job->data;
+
+    job->data = NULL;
+    if (NULL == data)
+    {
+        return;
+    }
+
+    if (ASSET_TEXTURE == job->type)
+    {
+        traceBegin("loaderUpload");
+        SDL_Texture *texture = SDL_CreateTextureFromSurface(loader->renderer, data);
+        SDL_FreeSurface(data);
+        traceEnd("loaderUpload");
+
+        if (NULL == texture)
+        {
+            fprintf(stderr, "%s\n", SDL_GetError());
+            return;
+        }
+        job->asset = assetInsert(loader->renderer, job->path, job->type, texture);
+    }
+    else
+    {
+        job->asset = assetInsert(NULL, job->path, job->type, data);
+    }
+}
+
+/**
+ * @brief   Worker thread.  Decodes queued files until the loader is freed.
+ * @param   data the loader.  See @ref struct Loader.
+ * @return  Always 0.
+ * @ingroup Loader
+ */
+static int loaderWorker(void *data)
+{
+    Loader *loader = data;
+
+    SDL_LockMutex(loader->mutex);
+    while (1)
+    {
+        while (loader->running && (loader->nextJob == loader->numJobs))
+        {
+            SDL_CondWait(loader->queued, loader->mutex);
+        }
+
+        if (loader->nextJob == loader->numJobs)
+        {
+            break;
+        }
+
+        LoaderJob *job = &loader->job[loader->nextJob];
+        loader->nextJob++;
+        SDL_UnlockMutex(loader->mutex);
+
+        loaderDecode(job);
+
+        SDL_LockMutex(loader->mutex);
+        job->state = LOADER_DECODED;
+        SDL_CondSignal(loader->decoded);
+    }
+    SDL_UnlockMutex(loader->mutex);
+
+    return 0;
+}
+
+/**
+ * @brief   Queue a file for loading.
+ * @param   loader the loader.  See @ref struct Loader.
+ * @param   path   path to the file.  Has to stay valid until the loader is
+ *                 freed.
+ * @param   type   the asset type.  See ASSET_TEXTURE etc.
+ * @return  0 on success, -1 on error.
+ * @ingroup Loader
+ */
+int8_t loaderAdd(Loader *loader, const char *path, uint8_t type)
+{
+    SDL_LockMutex(loader->mutex);
+    if (LOADER_MAX_JOBS == loader->numJobs)
+    {
+        SDL_UnlockMutex(loader->mutex);
+        fprintf(stderr, "loaderAdd(): too many files.\n");
+        return -1;
+    }
+
+    LoaderJob *job = &loader->job[loader->numJobs];
+    job->path      = path;
+    job->type      = type;
+    job->state     = LOADER_QUEUED;
+    job->data      = NULL;
+    job->asset     = NULL;
+    loader->numJobs++;
+
+    SDL_CondSignal(loader->queued);
+    SDL_UnlockMutex(loader->mutex);
+
+    return 0;
+}
+
+/**
+ * @brief   Stop the worker threads and free loader.  The loaded assets stay
+ *          cached as long as someone else holds a reference.
+ * @param   loader the loader.  See @ref struct Loader.
+ * @ingroup Loader
+ */
+void loaderFree(Loader *loader)
+{
+    if (NULL == loader)
+    {
+        return;
+    }
+
+    /* Queued files are still decoded by the workers; their data is freed
+     * below without being uploaded. */
+    SDL_LockMutex(loader->mutex);
+    loader->running = 0;
+    SDL_CondBroadcast(loader->queued);
+    SDL_UnlockMutex(loader->mutex);
+
+    for (uint8_t i = 0; i < loader->numThreads; i++)
+    {
+        SDL_WaitThread(loader->thread[i], NULL);
+    }
+
+    for (uint32_t i = 0; i < loader->numJobs; i++)
+    {
+        LoaderJob *job = &loader->job[i];
+
+        if (job->data)
+        {
+            switch (job->type)
+            {
+                case ASSET_TEXTURE:
+                    SDL_FreeSurface(job->data);
+                    break;
+                case ASSET_SFX:
+                    Mix_FreeChunk(job->data);
+                    break;
+                default:
+                    Mix_FreeMusic(job->data);
+                    break;
+            }
+        }
+        assetRelease(job->asset);
+    }
+
+    SDL_DestroyCond(loader->decoded);
+    SDL_DestroyCond(loader->queued);
+    SDL_DestroyMutex(loader->mutex);
+    free(loader);
+}
+
+/**
+ * @brief   Initialise loader and start the worker threads.
+ * @param   renderer SDL's rendering context.  See @ref struct Video.
+ * @param   progress called after every finished file.  May be NULL.
+ * @param   userdata passed to progress.
+ * @return  Loader on success, NULL on error.  See @ref struct Loader.
+ * @ingroup Loader
+ */
+Loader *loaderInit(SDL_Renderer *renderer, LoaderProgress progress, void *userdata)
+{
+    Loader *loader = malloc(sizeof(struct loader_t));
+    if (NULL == loader)
+    {
+        fprintf(stderr, "loaderInit(): error allocating memory.\n");
+        return NULL;
+    }
+
+    loader->renderer   = renderer;
+    loader->progress   = progress;
+    loader->userdata   = userdata;
+    loader->numThreads = 0;
+    loader->running    = 1;
+    loader->numJobs    = 0;
+    loader->nextJob    = 0;
+    loader->numDone    = 0;
+    loader->mutex      = SDL_CreateMutex();
+    loader->queued     = SDL_CreateCond();
+    loader->decoded    = SDL_CreateCond();
+    if ((NULL == loader->mutex) || (NULL == loader->queued) || (NULL == loader->decoded))
+    {
+        fprintf(stderr, "%s\n", SDL_GetError());
+        loaderFree(loader);
+        return NULL;
+    }
+
+    // Leave one core to the main thread.
+    int32_t numThreads = SDL_GetCPUCount() - 1;
+    if (numThreads < 1)
+    {
+        numThreads = 1;
+    }
+    if (numThreads > LOADER_MAX_THREADS)
+    {
+        numThreads = LOADER_MAX_THREADS;
+    }
+
+    for (int32_t i = 0; i < numThreads; i++)
+    {
+        loader->thread[i] = SDL_CreateThread(loaderWorker, "loader", loader);
+        if (NULL == loader->thread[i])
+        {
+            fprintf(stderr, "%s\n", SDL_GetError());
+            loaderFree(loader);
+            return NULL;
+        }
+        loader->numThreads++;
+    }
+
+    return loader;
+}
+
+/**
+ * @brief   Upload all files decoded so far without waiting for the others.
+ *          Call regularly from the main thread.
+ * @param   loader the loader.  See @ref struct Loader.
+ * @return  1 if all queued files are done, 0 otherwise.
+ * @ingroup Loader
+ */
+int8_t loaderPoll(Loader *loader)
+{
+    SDL_LockMutex(loader->mutex);
+    for (uint32_t i = 0; i < loader->numJobs; i++)
+    {
+        LoaderJob *job = &loader->job[i];
+        if (LOADER_DECODED != job->state)
+        {
+            continue;
+        }
+        job->state = LOADER_DONE;
+        SDL_UnlockMutex(loader->mutex);
+
+        loaderUpload(loader, job);
+
+        SDL_LockMutex(loader->mutex);
+        loader->numDone++;
+        if (loader->progress)
+        {
+            uint32_t done  = loader->numDone;
+            uint32_t total = loader->numJobs;
+            SDL_UnlockMutex(loader->mutex);
+            loader->progress(done, total, loader->userdata);
+            SDL_LockMutex(loader->mutex);
+        }
+    }
+
+    int8_t done = (loader->numDone == loader->numJobs);
+    SDL_UnlockMutex(loader->mutex);
+
+    return done;
+}
+
+/**
+ * @brief   Upload the queued files as they are decoded until all are done.
+ * @param   loader the loader.  See @ref struct Loader.
+ * @ingroup Loader
+ */
+void loaderWait(Loader *loader)
+{
+    while (0 == loaderPoll(loader))
+    {
+        SDL_LockMutex(loader->mutex);
+        uint8_t pending = 1;
+        for (uint32_t i = 0; i < loader->numJobs; i++)
+        {
+            if (LOADER_DECODED == loader->job[i].state)
+            {
+                pending = 0;
+                break;
+            }
+        }
+
+        if (pending)
+        {
+            SDL_CondWait(loader->decoded, loader->mutex);
+        }
+        SDL_UnlockMutex(loader->mutex);
+    }
+}
@@ -0,0 +1,77 @@
+/** @file loader.h
+ * @ingroup Loader
+ */
+
+#ifndef LOADER_h
+#define LOADER_h
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+
+/**
+ * @def     LOADER_MAX_JOBS
+ *          Maximum number of files per loader.
+ * @ingroup Loader
+ */
+#define LOADER_MAX_JOBS 64
+
+/**
+ * @def     LOADER_MAX_THREADS
+ *          Maximum number of worker threads.
+ * @ingroup Loader
+ */
+#define LOADER_MAX_THREADS 8
+
+// Job states.
+#define LOADER_QUEUED   0
+#define LOADER_DECODED  1
+#define LOADER_DONE     2
+
+/**
+ * @brief   Called on the main thread after every finished file.
+ * @ingroup Loader
+ */
+typedef void (*LoaderProgress)(uint32_t done, uint32_t total, void *userdata);
+
+/**
+ * @ingroup Loader
+ */
+typedef struct loaderJob_t
+{
+    const char *path;
+    uint8_t    type;
+    uint8_t    state;
+    /* Set by the worker: an SDL_Surface for images, the Mix_Chunk or
+     * Mix_Music for sounds. */
+    void       *data;
+    // Reference to the cached asset.  Released by loaderFree().
+    void       *asset;
+} LoaderJob;
+
+/**
+ * @ingroup Loader
+ */
+typedef struct loader_t
+{
+    SDL_Renderer   *renderer;
+    LoaderProgress progress;
+    void           *userdata;
+    SDL_Thread     *thread[LOADER_MAX_THREADS];
+    uint8_t        numThreads;
+    SDL_mutex      *mutex;
+    SDL_cond       *queued;
+    SDL_cond       *decoded;
+    uint8_t        running;
+    LoaderJob      job[LOADER_MAX_JOBS];
+    uint32_t       numJobs;
+    uint32_t       nextJob;
+    uint32_t       numDone;
+} Loader;
+
+int8_t loaderAdd(Loader *loader, const char *path, uint8_t type);
+void   loaderFree(Loader *loader);
+Loader *loaderInit(SDL_Renderer *renderer, LoaderProgress progress, void *userdata);
+int8_t loaderPoll(Loader *loader);
+void   loaderWait(Loader *loader);
+
+#endif
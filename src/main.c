@@ -5,47 +5,126 @@
 
 #include <SDL2/SDL.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "aabb.h"
+#include "archive.h"
+#include "asset.h"
 #include "audio.h"
 #include "background.h"
 #include "config.h"
 #include "entity.h"
+#include "game.h"
+#include "headless.h"
 #include "hud.h"
+#include "level.h"
+#include "loader.h"
 #include "map.h"
+#include "profiler.h"
+#include "replay.h"
+#include "trace.h"
 #include "video.h"
 
 int32_t main(int32_t argc, char *argv[])
 {
     int32_t execStatus  = EXIT_SUCCESS;
 
-    const char *configFilename;
-    if (argc > 1)
+    const char *configFilename = "default.ini";
+    const char *recordFilename = NULL;
+    const char *replayFilename = NULL;
+    const char *csvFilename    = NULL;
+    const char *traceFilename  = NULL;
+    uint8_t    headless        = 0;
+    uint8_t    profile         = 0;
+    for (int32_t i = 1; i < argc; i++)
     {
-        configFilename = argv[1];
+        if (0 == strcmp(argv[i], "--headless"))
+        {
+            headless = 1;
+        }
+        else if ((0 == strcmp(argv[i], "--record")) && (i + 1 < argc))
+        {
+            recordFilename = argv[++i];
+        }
+        else if ((0 == strcmp(argv[i], "--replay")) && (i + 1 < argc))
+        {
+            replayFilename = argv[++i];
+        }
+        else if (0 == strcmp(argv[i], "--profile"))
+        {
+            profile = 1;
+        }
+        else if ((0 == strcmp(argv[i], "--profile-csv")) && (i + 1 < argc))
+        {
+            profile     = 1;
+            csvFilename = argv[++i];
+        }
+        else if ((0 == strcmp(argv[i], "--trace")) && (i + 1 < argc))
+        {
+            traceFilename = argv[++i];
+        }
+        else
+        {
+            configFilename = argv[i];
+        }
     }
-    else
+
+    Config config  = configInit(configFilename);
+    Replay *replay = NULL;
+    if (traceFilename && (-1 == traceInit(traceFilename)))
     {
-        configFilename = "default.ini";
+        return EXIT_FAILURE;
     }
 
-    Config config  = configInit(configFilename);
-    Video  *video  = NULL;
-    Map    *map    = NULL;
-    Mixer  *mixer  = NULL;
-    Music  *music  = NULL;
-    Icon   *iconFC = NULL;
+    // Use the asset archive if it has been built; see tools/pack.c.
+    if (-1 == archiveMount("res.pak"))
+    {
+        traceFree();
+        return EXIT_FAILURE;
+    }
 
-    Background *bg[NUM_BACKGROUNDS];
-    for (uint32_t i = 0; i < NUM_BACKGROUNDS; i++)
+    if (headless || config.headless.enabled)
     {
-        bg[i] = NULL;
+        execStatus = EXIT_SUCCESS;
+        if (replayFilename)
+        {
+            replay = replayOpen(replayFilename);
+        }
+        else if (recordFilename)
+        {
+            replay = replayRecord(recordFilename, 0, config.simulation.tickRate, config.headless.entities);
+        }
+
+        if ((replayFilename || recordFilename) && (NULL == replay))
+        {
+            execStatus = EXIT_FAILURE;
+        }
+        else if (-1 == headlessRun("res/maps/01.tmx", &config, replay))
+        {
+            execStatus = EXIT_FAILURE;
+        }
+
+        replayFree(replay);
+        archiveUnmount();
+        traceFree();
+        return execStatus;
     }
 
-    Entity *entity[NUM_ENTITIES];
-    for (uint32_t i = 0; i < NUM_ENTITIES; i++)
+    Video    *video    = NULL;
+    Level    *level    = NULL;
+    Map      *map      = NULL;
+    Game     *game     = NULL;
+    Mixer    *mixer    = NULL;
+    Music    *music    = NULL;
+    Icon     *iconFC   = NULL;
+    Profiler *profiler = NULL;
+    Loader   *loader   = NULL;
+
+    Background *bg[NUM_BACKGROUNDS];
+    for (uint32_t i = 0; i < NUM_BACKGROUNDS; i++)
     {
-        entity[i] = NULL;
+        bg[i] = NULL;
     }
 
     SFX *sfx[NUM_SFX];
@@ -54,6 +133,36 @@ int32_t main(int32_t argc, char *argv[])
         sfx[i] = NULL;
     }
 
+    /* A recording always runs at the tick rate it has been recorded with,
+     * independent of the configuration. */
+    if (replayFilename)
+    {
+        replay = replayOpen(replayFilename);
+        if (NULL == replay)
+        {
+            execStatus = EXIT_FAILURE;
+            goto quit;
+        }
+
+        if (NUM_ENTITIES != replay->numEntities)
+        {
+            fprintf(stderr, "%s has been recorded with %u entities.\n", replayFilename, replay->numEntities);
+            execStatus = EXIT_FAILURE;
+            goto quit;
+        }
+        config.simulation.tickRate = replay->tickRate;
+    }
+    else if (recordFilename)
+    {
+        replay = replayRecord(recordFilename, 0, config.simulation.tickRate, NUM_ENTITIES);
+        if (NULL == replay)
+        {
+            execStatus = EXIT_FAILURE;
+            goto quit;
+        }
+    }
+
+    traceBegin("videoInit");
     video = videoInit(
         "Rainbow Joe",
         config.video.width,
@@ -67,31 +176,78 @@ int32_t main(int32_t argc, char *argv[])
         goto quit;
     }
     atexit(SDL_Quit);
+    traceEnd("videoInit");
+
+    // The mixer has to be opened before any sound can be decoded.
+    mixer = mixerInit();
 
-    map = mapInit("res/maps/01.tmx");
+    /* Decode the assets on worker threads while the map is loaded.  The
+     * loader keeps them in the asset cache, so the initialisation below only
+     * picks them up. */
+    loader = loaderInit(video->renderer, hudProgress, video->renderer);
+    if (NULL == loader)
+    {
+        execStatus = EXIT_FAILURE;
+        goto quit;
+    }
+    loaderAdd(loader, "res/sprites/characters.png",      ASSET_TEXTURE);
+    loaderAdd(loader, "res/backgrounds/sky.png",         ASSET_TEXTURE);
+    loaderAdd(loader, "res/backgrounds/clouds.png",      ASSET_TEXTURE);
+    loaderAdd(loader, "res/backgrounds/sea.png",         ASSET_TEXTURE);
+    loaderAdd(loader, "res/backgrounds/far-grounds.png", ASSET_TEXTURE);
+    loaderAdd(loader, "res/icons/telescope.png",         ASSET_TEXTURE);
+    if (mixer)
+    {
+        loaderAdd(loader, "res/music/01.ogg",    ASSET_MUSIC);
+        loaderAdd(loader, "res/sfx/dead.wav",    ASSET_SFX);
+        loaderAdd(loader, "res/sfx/impact.wav",  ASSET_SFX);
+        loaderAdd(loader, "res/sfx/jump.wav",    ASSET_SFX);
+        loaderAdd(loader, "res/sfx/pause.wav",   ASSET_SFX);
+        loaderAdd(loader, "res/sfx/unpause.wav", ASSET_SFX);
+    }
+
+    // The level manager shares its tilesets between all maps of the session.
+    level = levelInit(video->renderer);
+    if (NULL == level)
+    {
+        execStatus = EXIT_FAILURE;
+        goto quit;
+    }
+
+    traceBegin("mapInit");
+    map = levelLoad(level, "res/maps/01.tmx");
     if (NULL == map)
     {
         execStatus = EXIT_FAILURE;
         goto quit;
     }
+    traceEnd("mapInit");
+
+    traceBegin("loaderWait");
+    loaderWait(loader);
+    traceEnd("loaderWait");
 
-    // Audio mixer and music.
+    // Music.
     /* Note: The error handling isn't missing here.  There is simply no need to
      * quit the program if the music can't be played by some reason. */
-    mixer = mixerInit();
+    traceBegin("musicInit");
     music = musicInit("res/music/01.ogg");
+    traceEnd("musicInit");
     if (mixer && config.audio.enabled)
     {
         musicFadeIn(music, -1, 2000);
     }
 
+    traceBegin("iconInit");
     iconFC = iconInit(video->renderer, "res/icons/telescope.png");
     if (NULL == iconFC)
     {
         execStatus = EXIT_FAILURE;
         goto quit;
     }
+    traceEnd("iconInit");
 
+    traceBegin("backgroundInit");
     bg[0] = backgroundInit(video->renderer, "res/backgrounds/sky.png", map->width);
     if (NULL == bg[0])
     {
@@ -123,77 +279,64 @@ int32_t main(int32_t argc, char *argv[])
         goto quit;
     }
     bg[3]->worldPosY = map->height - bg[3]->height;
+    traceEnd("backgroundInit");
 
-    for (uint32_t i = 0; i < NUM_ENTITIES; i++)
+    game = gameInit(map, NUM_ENTITIES);
+    if (NULL == game)
     {
-        entity[i] = entityInit();
-        if (NULL == entity[i])
+        execStatus = EXIT_FAILURE;
+        goto quit;
+    }
+
+    // Frame stages are traced by the profiler.
+    if (profile || config.profiler.enabled || traceFilename)
+    {
+        profiler = profilerInit(config.profiler.frames, csvFilename);
+        if (NULL == profiler)
         {
             execStatus = EXIT_FAILURE;
             goto quit;
         }
-        if (-1 == entityLoadSprite(entity[i], video->renderer, "res/sprites/characters.png"))
+        game->timing = 1;
+    }
+
+    traceBegin("entityLoadSprite");
+    EntityStore *entity = game->entity;
+    for (uint32_t i = 0; i < NUM_ENTITIES; i++)
+    {
+        if (-1 == entityLoadSprite(entity, i, video->renderer, "res/sprites/characters.png"))
         {
             execStatus = EXIT_FAILURE;
             goto quit;
         }
-        entity[i]->worldWidth  = map->width;
-        entity[i]->worldHeight = map->height;
     }
+    traceEnd("entityLoadSprite");
 
-    // Set up individual entities.
-    // Player.
-    entity[PLAYER_ENTITY]->frameYoffset =  64;
-    entity[PLAYER_ENTITY]->respawnPosX  =  32;
-    entity[PLAYER_ENTITY]->respawnPosY  = 608;
-    entity[PLAYER_ENTITY]->worldPosX    =  32;
-    entity[PLAYER_ENTITY]->worldPosY    = 608;
-    // NPCs.
-    entity[1]->frameYoffset =   64;
-    entity[3]->frameYoffset =   64;
-    entity[5]->frameYoffset =    0;
-    entity[6]->frameYoffset =    0;
-    entity[1]->respawnPosX  =  144;
-    entity[1]->respawnPosY  =  432;
-    entity[2]->respawnPosX  =  256;
-    entity[2]->respawnPosY  =   80;
-    entity[3]->respawnPosX  =  496;
-    entity[3]->respawnPosY  =  160;
-    entity[4]->respawnPosX  = 1776;
-    entity[4]->respawnPosY  =   80;
-    entity[5]->respawnPosX  = 1200;
-    entity[5]->respawnPosY  =   32;
-    entity[6]->respawnPosX  =  672;
-    entity[6]->respawnPosY  =  656;
-    entity[1]->worldPosX    = entity[1]->respawnPosX;
-    entity[1]->worldPosY    = entity[1]->respawnPosY;
-    entity[2]->worldPosX    = entity[2]->respawnPosX;
-    entity[2]->worldPosY    = entity[2]->respawnPosY;
-    entity[3]->worldPosX    = entity[3]->respawnPosX;
-    entity[3]->worldPosY    = entity[3]->respawnPosY;
-    entity[4]->worldPosX    = entity[4]->respawnPosX;
-    entity[4]->worldPosY    = entity[4]->respawnPosY;
-    entity[5]->worldPosX    = entity[5]->respawnPosX;
-    entity[5]->worldPosY    = entity[5]->respawnPosY;
-    entity[6]->worldPosX    = entity[6]->respawnPosX;
-    entity[6]->worldPosY    = entity[6]->respawnPosY;
-
+    traceBegin("sfxInit");
     sfx[SFX_DEAD]           = sfxInit("res/sfx/dead.wav");
     sfx[SFX_IMPACT]         = sfxInit("res/sfx/impact.wav");
     sfx[SFX_JUMP]           = sfxInit("res/sfx/jump.wav");
     sfx[SFX_PAUSE]          = sfxInit("res/sfx/pause.wav");
     sfx[SFX_UNPAUSE]        = sfxInit("res/sfx/unpause.wav");
-
-    uint8_t pause           = 0;
-    double  cameraPosX      = 0;
-    double  cameraPosY      = map->height - video->windowHeight;
-    double  timeA           = SDL_GetTicks();
-    double  delay           = 0;
+    traceEnd("sfxInit");
+
+    // Everything has been picked up from the cache.
+    loaderFree(loader);
+    loader = NULL;
+
+    uint8_t  pause       = 0;
+    double   cameraPosX  = 0;
+    double   cameraPosY  = map->height - video->windowHeight;
+    double   frequency   = SDL_GetPerformanceFrequency();
+    double   step        = 1.0 / config.simulation.tickRate;
+    double   accumulator = 0;
+    uint64_t timeA       = SDL_GetPerformanceCounter();
     while (1)
     {
-        double timeB = SDL_GetTicks();
-        double dTime = (timeB - timeA) / 1000;
-        timeA        = timeB;
+        uint64_t timeB = SDL_GetPerformanceCounter();
+        double   dTime = (timeB - timeA) / frequency;
+        timeA          = timeB;
+        profilerBegin(profiler);
 
         // Handle keyboard input.
         const uint8_t *keyState;
@@ -230,102 +373,62 @@ int32_t main(int32_t argc, char *argv[])
 
         if (pause) continue;
 
-        // Limit FPS.
-        if (config.video.limitFPS)
-        {
-            SDL_Delay(1000 / config.video.fps - dTime);
-        }
-
-        for (uint32_t i = 0; i < NUM_ENTITIES; i++)
+        uint16_t input = 0;
+        if (keyState[SDL_SCANCODE_A])      input |= 1 << INPUT_LEFT;
+        if (keyState[SDL_SCANCODE_D])      input |= 1 << INPUT_RIGHT;
+        if (keyState[SDL_SCANCODE_SPACE])  input |= 1 << INPUT_JUMP;
+        if (keyState[SDL_SCANCODE_LSHIFT]) input |= 1 << INPUT_RUN;
+        profilerMark(profiler, PROFILER_INPUT);
+
+        /* Run the simulation in fixed steps.  If the frame took too long, at
+         * most maxSteps steps are run and the remaining time is dropped; the
+         * game slows down instead of falling further behind. */
+        uint16_t events = 0;
+        uint8_t  steps  = 0;
+        accumulator    += dTime;
+        while (accumulator >= step)
         {
-            entityFrame(entity[i], dTime);
-            if ((entity[i]->flags >> IS_DEAD) & 1)
+            if (steps == config.simulation.maxSteps)
             {
-                if (PLAYER_ENTITY != i)
-                {
-                    if (mixer && config.audio.enabled) sfxPlay(sfx[SFX_IMPACT], CH_IMPACT, 0);
-                    entityRespawn(entity[i]);
-                }
+                accumulator = 0;
+                break;
             }
-        }
 
-        if ((entity[PLAYER_ENTITY]->flags >> IS_DEAD) & 1)
-        {
-            if (0 == delay)
+            if (-1 == gameTick(game, replayInput(replay, input), step))
             {
-                if (mixer && config.audio.enabled)
-                {
-                    sfxPlay(sfx[SFX_DEAD], CH_DEAD, 0);
-                }
-            }
-            delay += dTime;
-
-            if (delay > 2)
-            {
-                entity[PLAYER_ENTITY]->flags &= ~(1 << IS_DEAD);
-                for (uint32_t i = 0; i < NUM_ENTITIES; i++)
-                    entityRespawn(entity[i]);
-                delay =  0;
+                execStatus = EXIT_FAILURE;
+                goto quit;
             }
-        }
 
-        // Process keyboard input.
-        // Reset IN_MOTION flag (in case no key is pressed).
-        entity[PLAYER_ENTITY]->flags &= ~(1 << IN_MOTION);
-
-        if (keyState[SDL_SCANCODE_LSHIFT])
-        {
-            // Allow running only when not in mid-air.
-            if (0 == ((entity[PLAYER_ENTITY]->flags >> IN_MID_AIR) & 1))
+            if (-1 == replayVerify(replay, game))
             {
-                entity[PLAYER_ENTITY]->velocityMax  = 250;
-                entity[PLAYER_ENTITY]->frameStart   = RUN;
-                entity[PLAYER_ENTITY]->frameEnd     = RUN_MAX;
-            }
-        }
-        else
-        {
-            // Don't allow to slow down in mid-air.
-            if (0 == ((entity[PLAYER_ENTITY]->flags >> IN_MID_AIR) & 1))
-            {
-                entity[PLAYER_ENTITY]->velocityMax  = 100;
-                entity[PLAYER_ENTITY]->frameStart   = WALK;
-                entity[PLAYER_ENTITY]->frameEnd     = WALK_MAX;
+                execStatus = EXIT_FAILURE;
+                goto quit;
             }
-        }
 
-        if (keyState[SDL_SCANCODE_A])
-        {
-            if (0 == ((entity[PLAYER_ENTITY]->flags >> DIRECTION) & 1))
+            if (replay && (REPLAY_PLAY == replay->mode) && replay->finished)
             {
-                entity[PLAYER_ENTITY]->velocity = -entity[PLAYER_ENTITY]->velocity;
+                goto quit;
             }
-            entity[PLAYER_ENTITY]->flags |= 1 << IN_MOTION;
-            entity[PLAYER_ENTITY]->flags |= 1 << DIRECTION;
+            events      |= game->events;
+            accumulator -= step;
+            steps++;
         }
+        double alpha = accumulator / step;
 
-        if (keyState[SDL_SCANCODE_D])
+        profilerMark(profiler, PROFILER_SIMULATION);
+        traceCounter("steps", steps);
+        for (uint8_t i = 0; i < NUM_TIMERS; i++)
         {
-            if ((entity[PLAYER_ENTITY]->flags >> DIRECTION) & 1)
-            {
-                entity[PLAYER_ENTITY]->velocity = -entity[PLAYER_ENTITY]->velocity;
-            }
-
-            entity[PLAYER_ENTITY]->flags |= 1   << IN_MOTION;
-            entity[PLAYER_ENTITY]->flags &= ~(1 << DIRECTION);
+            profilerAdd(profiler, PROFILER_PHYSICS + i, game->time[i]);
+            game->time[i] = 0;
         }
 
-        if (0 == ((entity[PLAYER_ENTITY]->flags >> IN_MID_AIR) & 1))
+        if (mixer && config.audio.enabled)
         {
-            if (keyState[SDL_SCANCODE_SPACE])
-            {
-                if (mixer && config.audio.enabled)
-                {
-                    sfxPlay(sfx[SFX_JUMP], CH_JUMP, 0);
-                }
-                entity[PLAYER_ENTITY]->flags        |= 1 << IS_JUMPING;
-                entity[PLAYER_ENTITY]->velocityJump  = entity[PLAYER_ENTITY]->velocity;
-            }
+            if ((events >> EVENT_IMPACT) & 1) sfxPlay(sfx[SFX_IMPACT], CH_IMPACT, 0);
+            if ((events >> EVENT_DEAD)   & 1) sfxPlay(sfx[SFX_DEAD],   CH_DEAD,   0);
+            if ((events >> EVENT_JUMP)   & 1) sfxPlay(sfx[SFX_JUMP],   CH_JUMP,   0);
         }
 
         if (keyState[SDL_SCANCODE_1])
@@ -352,39 +455,11 @@ int32_t main(int32_t argc, char *argv[])
         }
         else
         {
-            cameraPosX = entity[PLAYER_ENTITY]->worldPosX - video->windowWidth  / (video->zoomLevel * 2) + (entity[PLAYER_ENTITY]->width  / 2);
-            cameraPosY = entity[PLAYER_ENTITY]->worldPosY - video->windowHeight / (video->zoomLevel * 2) + (entity[PLAYER_ENTITY]->height / 2);
-        }
-
-        // Set up collision detection.
-        for (uint32_t i = 0; i < NUM_ENTITIES; i++)
-        {
-            if (mapCoordIsType(map, "floor", entity[i]->worldPosX, entity[i]->worldPosY + entity[i]->height))
-            {
-                entity[i]->flags &= ~(1 << IN_MID_AIR);
-            }
-            else
-            {
-                entity[i]->flags |= 1 << IN_MID_AIR;
-            }
-        }
-
-        // Set NPC behavior.
-        for (uint32_t i = 1; i < NUM_ENTITIES; i++)
-        {
-            if (doIntersect(entity[PLAYER_ENTITY]->bb, entity[i]->bb))
-            {
-                if (entity[PLAYER_ENTITY]->worldPosX > entity[i]->worldPosX)
-                {
-                    entity[i]->flags |= 1 << DIRECTION;
-                }
-                else
-                {
-                    entity[i]->flags &= ~(1 << DIRECTION);
-                }
-
-                entity[i]->flags |= 1 << IN_MOTION;
-            }
+            double playerPosX;
+            double playerPosY;
+            entityInterpolate(entity, PLAYER_ENTITY, alpha, &playerPosX, &playerPosY);
+            cameraPosX = playerPosX - video->windowWidth  / (video->zoomLevel * 2) + (entity->width[PLAYER_ENTITY]  / 2);
+            cameraPosY = playerPosY - video->windowHeight / (video->zoomLevel * 2) + (entity->height[PLAYER_ENTITY] / 2);
         }
 
         // Set camera boundaries to map size.
@@ -395,55 +470,73 @@ int32_t main(int32_t argc, char *argv[])
         if (cameraPosX > cameraMaxX) cameraPosX = cameraMaxX;
         if (cameraPosY > cameraMaxY) cameraPosY = cameraMaxY;
 
+        profilerMark(profiler, PROFILER_CAMERA);
+
+        // Advance tile animations.
+        if (-1 == mapFrame(video->renderer, map, dTime))
+        {
+            execStatus = EXIT_FAILURE;
+            goto quit;
+        }
+        profilerMark(profiler, PROFILER_MAP_FRAME);
+
         // Render scene.
         if (-1 == backgroundRender(video->renderer, bg[0], cameraPosX, cameraPosY))
         {
             execStatus = EXIT_FAILURE;
             goto quit;
         }
+        profilerMark(profiler, PROFILER_BACKGROUND_0);
 
         if (-1 == backgroundRender(video->renderer, bg[1], cameraPosX * 0.05, cameraPosY))
         {
             execStatus = EXIT_FAILURE;
             goto quit;
         }
+        profilerMark(profiler, PROFILER_BACKGROUND_1);
 
         if (-1 == backgroundRender(video->renderer, bg[2], cameraPosX * 0.15, cameraPosY))
         {
             execStatus = EXIT_FAILURE;
             goto quit;
         }
+        profilerMark(profiler, PROFILER_BACKGROUND_2);
 
         if (-1 == backgroundRender(video->renderer, bg[3], cameraPosX * 0.1, cameraPosY))
         {
             execStatus = EXIT_FAILURE;
             goto quit;
         }
+        profilerMark(profiler, PROFILER_BACKGROUND_3);
 
         if (-1 == mapRender(video->renderer, map, "Background", 1, 0, cameraPosX, cameraPosY))
         {
             execStatus = EXIT_FAILURE;
             goto quit;
         }
+        profilerMark(profiler, PROFILER_MAP_BACKGROUND);
 
         if (-1 == mapRender(video->renderer, map, "World", 1, 1, cameraPosX, cameraPosY))
         {
             execStatus = EXIT_FAILURE;
             goto quit;
         }
+        profilerMark(profiler, PROFILER_MAP_WORLD);
 
         for (uint32_t i = 0; i < NUM_ENTITIES; i++)
-            if (-1 == entityRender(video->renderer, entity[i], cameraPosX, cameraPosY))
+            if (-1 == entityRender(video->renderer, entity, i, alpha, cameraPosX, cameraPosY))
             {
                 execStatus = EXIT_FAILURE;
                 goto quit;
             }
+        profilerMark(profiler, PROFILER_ENTITY_RENDER);
 
         if (-1 == mapRender(video->renderer, map, "Overlay", 1, 2, cameraPosX, cameraPosY))
         {
             execStatus = EXIT_FAILURE;
             goto quit;
         }
+        profilerMark(profiler, PROFILER_MAP_OVERLAY);
 
         if (keyState[SDL_SCANCODE_F])
             if (-1 == iconRender(video->renderer, iconFC, video->windowWidth / video->zoomLevel - iconFC->width, 0))
@@ -451,22 +544,35 @@ int32_t main(int32_t argc, char *argv[])
                 execStatus = EXIT_FAILURE;
                 goto quit;
             }
+        profilerMark(profiler, PROFILER_HUD);
 
         SDL_RenderPresent(video->renderer);
         SDL_RenderClear(video->renderer);
+        profilerMark(profiler, PROFILER_PRESENT);
+        profilerEnd(profiler);
+
+        // Limit FPS.
+        if ((config.video.limitFPS) && (config.video.fps > 0))
+        {
+            double frameTime = (SDL_GetPerformanceCounter() - timeB) / frequency;
+            double frameMin  = 1.0 / config.video.fps;
+            if (frameTime < frameMin)
+            {
+                SDL_Delay((frameMin - frameTime) * 1000);
+            }
+        }
     }
 
     // Free allocated memory and exit.
     quit:
+    loaderFree(loader);
     for (uint32_t i = 0; i < NUM_SFX; i++)
     {
         sfxFree(sfx[i]);
     }
 
-    for (uint32_t i = 0; i < NUM_ENTITIES; i++)
-    {
-        entityFree(entity[i]);
-    }
+    profilerFree(profiler);
+    gameFree(game);
 
     for (uint32_t i = 0; i < NUM_BACKGROUNDS; i++)
     {
@@ -477,7 +583,11 @@ int32_t main(int32_t argc, char *argv[])
     musicFree(music);
     mixerFree(mixer);
     mapFree(map);
+    levelFree(level);
     videoTerminate(video);
+    replayFree(replay);
+    archiveUnmount();
+    traceFree();
 
     return execStatus;
 }
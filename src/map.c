@@ -8,12 +8,1198 @@
  */
 
 #include <SDL2/SDL_image.h>
+#include <math.h>
 #include <stdio.h>
+#include <string.h>
+#include "archive.h"
+#include "asset.h"
 #include "map.h"
 
+/**
+ * @brief   An image decoded by another thread than the one that set up the
+ *          loader context, waiting for mapUpload().  Stands in for the
+ *          texture in the TMX data.  See @ref struct MapImages.
+ * @ingroup Map
+ */
+typedef struct mapImage_t
+{
+    SDL_Surface       *surface;
+    char              *path;
+    struct mapImage_t *next;
+} MapImage;
+
+/**
+ * @brief   File hook for the TMX loader.  Maps and tilesets are read from
+ *          the asset archive if mounted.  See tmx_file_read_func.
+ * @param   path path to the file.
+ * @param   len  the size of the file.
+ * @return  The file content, NULL to read the file from disk.
+ * @ingroup Map
+ */
+static const char *mapFileRead(const char *path, int *len)
+{
+    size_t     size = 0;
+    const char *data = archiveFind(path, &size);
+
+    *len = size;
+    return data;
+}
+
+/**
+ * @brief   Image loader hook for the TMX loader.  The textures are shared
+ *          through the asset cache.  See tmx_img_load_func.
+ * @param   path path to the image file.
+ * @return  SDL_Texture on success, a MapImage if called on another thread
+ *          than the one that set up the loader context, NULL on error.
+ * @ingroup Map
+ */
+static void *mapImageLoad(const char *path)
+{
+    MapImages *images = tmx_ctx_userdata();
+
+    if (SDL_ThreadID() == images->thread)
+    {
+        return assetTexture(images->renderer, path);
+    }
+
+    MapImage *image = malloc(sizeof(struct mapImage_t));
+    if (NULL == image)
+    {
+        fprintf(stderr, "mapImageLoad(): error allocating memory.\n");
+        return NULL;
+    }
+
+    image->path = malloc(strlen(path) + 1);
+    if (NULL == image->path)
+    {
+        fprintf(stderr, "mapImageLoad(): error allocating memory.\n");
+        free(image);
+        return NULL;
+    }
+    strcpy(image->path, path);
+
+    image->surface = IMG_Load_RW(archiveRW(path), 1);
+    if (NULL == image->surface)
+    {
+        fprintf(stderr, "%s: %s\n", path, SDL_GetError());
+        free(image->path);
+        free(image);
+        return NULL;
+    }
+
+    SDL_AtomicLock(&images->lock);
+    image->next     = images->pending;
+    images->pending = image;
+    SDL_AtomicUnlock(&images->lock);
+
+    return image;
+}
+
+/**
+ * @brief   Take an image out of the list of images waiting for mapUpload().
+ * @param   images  the owner of the images.  See @ref struct MapImages.
+ * @param   address the address returned by mapImageLoad().
+ * @return  The MapImage, NULL if address is not a waiting image.
+ * @ingroup Map
+ */
+static MapImage *mapImageTake(MapImages *images, void *address)
+{
+    MapImage *image = NULL;
+
+    if (NULL == address)
+    {
+        return NULL;
+    }
+
+    SDL_AtomicLock(&images->lock);
+    for (MapImage **link = &images->pending; *link; link = &(*link)->next)
+    {
+        if (*link == address)
+        {
+            image = *link;
+            *link = image->next;
+            break;
+        }
+    }
+    SDL_AtomicUnlock(&images->lock);
+
+    return image;
+}
+
+/**
+ * @brief   Image free hook for the TMX loader.  See tmx_img_free_func.
+ * @param   address the texture or MapImage returned by mapImageLoad().
+ * @ingroup Map
+ */
+static void mapImageFree(void *address)
+{
+    MapImage *image = mapImageTake(tmx_ctx_userdata(), address);
+    if (NULL == image)
+    {
+        assetRelease(address);
+        return;
+    }
+
+    SDL_FreeSurface(image->surface);
+    free(image->path);
+    free(image);
+}
+
+/**
+ * @brief   Replace a decoded image by its texture.
+ * @param   images the owner of the images.  See @ref struct MapImages.
+ * @param   image  the TMX image, may be NULL.
+ * @ingroup Map
+ */
+static void mapUploadImage(MapImages *images, tmx_image *image)
+{
+    if (NULL == image)
+    {
+        return;
+    }
+
+    MapImage *decoded = mapImageTake(images, image->resource_image);
+    if (NULL == decoded)
+    {
+        return;
+    }
+
+    SDL_Texture *texture = SDL_CreateTextureFromSurface(images->renderer, decoded->surface);
+    if (NULL == texture)
+    {
+        fprintf(stderr, "%s\n", SDL_GetError());
+        image->resource_image = NULL;
+    }
+    else
+    {
+        image->resource_image = assetInsert(images->renderer, decoded->path, ASSET_TEXTURE, texture);
+    }
+
+    SDL_FreeSurface(decoded->surface);
+    free(decoded->path);
+    free(decoded);
+}
+
+/**
+ * @brief   Upload the decoded images of the image layers.
+ * @param   images the owner of the images.  See @ref struct MapImages.
+ * @param   layers the first layer.
+ * @ingroup Map
+ */
+static void mapUploadLayers(MapImages *images, tmx_layer *layers)
+{
+    for (; layers; layers = layers->next)
+    {
+        if (L_IMAGE == layers->type)
+        {
+            mapUploadImage(images, layers->content.image);
+        }
+        else if (L_GROUP == layers->type)
+        {
+            mapUploadLayers(images, layers->content.group_head);
+        }
+    }
+}
+
+/**
+ * @brief   Jobs handed out by mapParallel().
+ * @ingroup Map
+ */
+typedef struct mapJobs_t
+{
+    void         (*job)(int index, void *arg);
+    void         *arg;
+    int          count;
+    SDL_atomic_t next;
+} MapJobs;
+
+/**
+ * @brief   Worker thread of mapParallel().  Runs jobs until none are left.
+ * @param   data the jobs.  See @ref struct MapJobs.
+ * @return  Always 0.
+ * @ingroup Map
+ */
+static int mapWorker(void *data)
+{
+    MapJobs *jobs = data;
+    int     index;
+
+    while ((index = SDL_AtomicAdd(&jobs->next, 1)) < jobs->count)
+    {
+        jobs->job(index, jobs->arg);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Parallel hook for the TMX loader.  The tile layers are decoded on
+ *          a few short-lived threads and the calling one.  See
+ *          tmx_parallel_func.
+ * @param   job   called once for every index.
+ * @param   count the number of jobs.
+ * @param   arg   passed to job.
+ * @ingroup Map
+ */
+static void mapParallel(void (*job)(int index, void *arg), int count, void *arg)
+{
+    SDL_Thread *thread[MAP_MAX_THREADS];
+    MapJobs    jobs;
+    int32_t    numThreads = SDL_GetCPUCount() - 1;
+
+    jobs.job   = job;
+    jobs.arg   = arg;
+    jobs.count = count;
+    SDL_AtomicSet(&jobs.next, 0);
+
+    if (numThreads > MAP_MAX_THREADS)
+    {
+        numThreads = MAP_MAX_THREADS;
+    }
+    if (numThreads > count - 1)
+    {
+        numThreads = count - 1;
+    }
+
+    // Threads that fail to start are not needed, the calling thread does
+    // their share.
+    for (int32_t i = 0; i < numThreads; i++)
+    {
+        thread[i] = SDL_CreateThread(mapWorker, "map", &jobs);
+    }
+    mapWorker(&jobs);
+
+    for (int32_t i = 0; i < numThreads; i++)
+    {
+        SDL_WaitThread(thread[i], NULL);
+    }
+}
+
+/**
+ * @brief   Load a TMX map.  The compiled map next to it (same name with the
+ *          extension .tmb, see tools/mapc.c) is preferred if present, since
+ *          it is loaded without parsing any XML.
+ * @param   ctx      the loader context of the map, unused if a tileset
+ *                   manager is given.
+ * @param   tilesets the tileset manager, or NULL.
+ * @param   filename the TMX map file to load.
+ * @return  tmx_map on success, NULL on error.
+ * @ingroup Map
+ */
+static tmx_map *mapLoad(tmx_ctx *ctx, tmx_tileset_manager *tilesets, const char *filename)
+{
+    char       binFilename[256];
+    const char *extension = strrchr(filename, '.');
+    tmx_map    *map;
+
+    if ((NULL != extension) && ((size_t)(extension - filename) + 5 <= sizeof(binFilename)))
+    {
+        memcpy(binFilename, filename, extension - filename);
+        strcpy(binFilename + (extension - filename), ".tmb");
+
+        map = tilesets ? tmx_tsmgr_load_bin(tilesets, binFilename) : tmx_ctx_load_bin(ctx, binFilename);
+        if (NULL != map)
+        {
+            return map;
+        }
+        if (E_NOENT != tmx_errno)
+        {
+            fprintf(stderr, "%s, falling back to %s.\n", tmx_strerr(), filename);
+        }
+    }
+
+    return tilesets ? tmx_tsmgr_load(tilesets, filename) : tmx_ctx_load(ctx, filename);
+}
+
+/**
+ * @brief   Intern a numeric tile property.  Used as callback for
+ *          tmx_property_foreach() while compiling the tile attributes.
+ * @param   property the property to intern.
+ * @param   userdata the map.
+ * @ingroup Map
+ */
+static void mapInternProperty(tmx_property *property, void *userdata)
+{
+    Map *map = (Map*)userdata;
+
+    if ((PT_INT   != property->type) &&
+        (PT_FLOAT != property->type) &&
+        (PT_BOOL  != property->type))
+    {
+        return;
+    }
+
+    if (-1 != mapPropertyIndex(map, property->name))
+    {
+        return;
+    }
+
+    if (MAX_TILE_PROPS <= map->numProps)
+    {
+        fprintf(stderr, "mapInit(): too many tile properties, ignoring '%s'.\n", property->name);
+        return;
+    }
+
+    map->propName[map->numProps] = property->name;
+    map->numProps++;
+}
+
+/**
+ * @brief   Read a row of a tile layer, whatever form the layer is stored
+ *          in.  Lazy layers are decoded on first use.  See tmx_lazy_layers
+ *          and tmx_compact_layers.
+ * @param   map   the map.
+ * @param   layer the tile layer.
+ * @param   x     first column.
+ * @param   y     the row.
+ * @param   count number of cells.
+ * @return  the gids, held in the map's row buffer, or NULL on error.
+ * @ingroup Map
+ */
+static int32_t *mapLayerRow(Map *map, tmx_layer *layer, uint32_t x, uint32_t y, uint32_t count)
+{
+    if (0 == tmx_get_layer_row(map->map, layer, x, y, count, map->rowGids))
+    {
+        fprintf(stderr, "%s\n", tmx_strerr());
+        return NULL;
+    }
+    return map->rowGids;
+}
+
+/**
+ * @brief   Compile the per-cell tile attributes.  Tile types are interned as
+ *          bit flags and numeric tile properties are copied into a flat table,
+ *          so that the map can be probed without any string comparison.
+ * @param   map the map.
+ * @return  0 on success, -1 on error.
+ * @ingroup Map
+ */
+static int8_t mapCompileAttributes(Map *map)
+{
+    uint32_t numCells  = map->map->width * map->map->height;
+    uint16_t *tileFlag = NULL;
+    uint16_t *tileProp = NULL;
+    uint32_t numTyped  = 0;
+
+    map->cellFlags = calloc(numCells, sizeof(uint16_t));
+    map->cellProps = calloc(numCells, sizeof(uint16_t));
+    tileFlag       = calloc(map->map->tilecount + 1, sizeof(uint16_t));
+    tileProp       = calloc(map->map->tilecount + 1, sizeof(uint16_t));
+    if ((NULL == map->cellFlags) || (NULL == map->cellProps) || (NULL == tileFlag) || (NULL == tileProp))
+    {
+        fprintf(stderr, "mapInit(): error allocating memory.\n");
+        free(tileFlag);
+        free(tileProp);
+        return -1;
+    }
+
+    // Intern tile types and numeric properties.
+    map->numPropRows = 1; // Row 0: no properties.
+    for (uint32_t gid = 0; gid < map->map->tilecount; gid++)
+    {
+        tmx_tile *tile = map->map->tiles[gid];
+        if (NULL == tile)
+        {
+            continue;
+        }
+
+        if (NULL != tile->type)
+        {
+            int8_t type = mapTypeIndex(map, tile->type);
+            if (-1 == type)
+            {
+                if (MAX_TILE_TYPES <= map->numTypes)
+                {
+                    fprintf(stderr, "mapInit(): too many tile types, ignoring '%s'.\n", tile->type);
+                }
+                else
+                {
+                    type = map->numTypes;
+                    map->typeName[map->numTypes] = tile->type;
+                    map->numTypes++;
+                }
+            }
+            if (-1 != type)
+            {
+                tileFlag[gid] = 1 << type;
+                numTyped++;
+            }
+        }
+
+        if (NULL != tile->properties)
+        {
+            tmx_property_foreach(tile->properties, mapInternProperty, map);
+            tileProp[gid] = map->numPropRows;
+            map->numPropRows++;
+            numTyped++;
+        }
+    }
+
+    map->propTable = calloc(map->numPropRows * MAX_TILE_PROPS, sizeof(double));
+    if (NULL == map->propTable)
+    {
+        fprintf(stderr, "mapInit(): error allocating memory.\n");
+        free(tileFlag);
+        free(tileProp);
+        return -1;
+    }
+
+    for (uint32_t gid = 0; gid < map->map->tilecount; gid++)
+    {
+        if (0 == tileProp[gid])
+        {
+            continue;
+        }
+
+        for (uint8_t i = 0; i < map->numProps; i++)
+        {
+            tmx_property *property = tmx_get_property(map->map->tiles[gid]->properties, map->propName[i]);
+            double       *value    = &map->propTable[(tileProp[gid] * MAX_TILE_PROPS) + i];
+
+            if (NULL == property) continue;
+
+            switch (property->type)
+            {
+                case PT_INT:
+                case PT_BOOL:
+                    *value = property->value.integer;
+                    break;
+                case PT_FLOAT:
+                    *value = property->value.decimal;
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+
+    // Without a single typed tile there is nothing to merge, and no layer
+    // has to be decoded for it.
+    if (0 == numTyped)
+    {
+        free(tileFlag);
+        free(tileProp);
+        return 0;
+    }
+
+    // Merge all layers into the per-cell grid.  Upper layers take precedence
+    // for numeric properties.
+    tmx_layer *layers = map->map->ly_head;
+    while(layers)
+    {
+        for (uint32_t ih = 0; (L_LAYER == layers->type) && (ih < map->map->height); ih++)
+        {
+            int32_t *gids = mapLayerRow(map, layers, 0, ih, map->map->width);
+            if (NULL == gids)
+            {
+                free(tileFlag);
+                free(tileProp);
+                return -1;
+            }
+
+            for (uint32_t iw = 0; iw < map->map->width; iw++)
+            {
+                uint32_t cell = (ih * map->map->width) + iw;
+                uint32_t gid  = gids[iw] & TMX_FLIP_BITS_REMOVAL;
+                if (gid >= map->map->tilecount)
+                {
+                    continue;
+                }
+                map->cellFlags[cell] |= tileFlag[gid];
+                if (tileProp[gid])
+                {
+                    map->cellProps[cell] = tileProp[gid];
+                }
+            }
+        }
+        layers = layers->next;
+    }
+
+    free(tileFlag);
+    free(tileProp);
+    return 0;
+}
+
+/**
+ * @brief   Widen the reach of the map's tiles beyond their cells by a tile
+ *          and all frames of its animation.  Tiles of an image collection
+ *          are aligned bottom-left, all others top-left.  See mapDrawTile().
+ * @param   map  the map.
+ * @param   tile the tile, may be NULL.
+ * @ingroup Map
+ */
+static void mapTileReach(Map *map, tmx_tile *tile)
+{
+    if (NULL == tile)
+    {
+        return;
+    }
+
+    for (uint32_t i = 0; i <= tile->animation_len; i++)
+    {
+        tmx_tile *frame = tile;
+        int64_t  right  = 0;
+        int64_t  up     = 0;
+        int64_t  down   = 0;
+
+        if (i < tile->animation_len)
+        {
+            if (tile->animation[i].tile_id >= tile->tileset->tilecount)
+            {
+                continue;
+            }
+            frame = &tile->tileset->tiles[tile->animation[i].tile_id];
+        }
+
+        if (NULL != frame->image)
+        {
+            right = (int64_t)frame->image->width  - map->map->tile_width;
+            up    = (int64_t)frame->image->height - map->map->tile_height;
+        }
+        else if (NULL != frame->tileset->image)
+        {
+            right = (int64_t)frame->tileset->tile_width  - map->map->tile_width;
+            down  = (int64_t)frame->tileset->tile_height - map->map->tile_height;
+        }
+
+        if (right > map->reachRight)
+        {
+            map->reachRight = right;
+        }
+        if (up > map->reachUp)
+        {
+            map->reachUp = up;
+        }
+        if (down > map->reachDown)
+        {
+            map->reachDown = down;
+        }
+    }
+}
+
+/**
+ * @brief   Collect the animated tiles and, for every visible tile layer, the
+ *          cells showing one of them.  The per-layer list is stored in the
+ *          layer's user data.  See @ref struct MapAnimList.  Also determines
+ *          how far the tiles of the visible layers reach beyond their cells,
+ *          see mapRebakeCell().
+ * @param   map the map.
+ * @return  0 on success, -1 on error.
+ * @ingroup Map
+ */
+static int8_t mapCompileAnimations(Map *map)
+{
+    for (uint32_t gid = 0; gid < map->map->tilecount; gid++)
+    {
+        tmx_tile *tile = map->map->tiles[gid];
+        if ((NULL == tile) || (0 == tile->animation_len))
+        {
+            continue;
+        }
+
+        uint32_t *animGid = realloc(map->animGid, (map->numAnimGids + 1) * sizeof(uint32_t));
+        if (NULL == animGid)
+        {
+            fprintf(stderr, "mapInit(): error allocating memory.\n");
+            return -1;
+        }
+        map->animGid = animGid;
+        map->animGid[map->numAnimGids] = gid;
+        map->numAnimGids++;
+    }
+
+    if (0 == map->numAnimGids)
+    {
+        return 0;
+    }
+
+    // The tiles may be shared with other maps through a tileset manager,
+    // so the current frames are kept here instead of in the tiles.
+    map->animFrame = calloc(map->numAnimGids, sizeof(uint16_t));
+    map->animSlot  = malloc(map->map->tilecount * sizeof(int32_t));
+    if ((NULL == map->animFrame) || (NULL == map->animSlot))
+    {
+        fprintf(stderr, "mapInit(): error allocating memory.\n");
+        return -1;
+    }
+    for (uint32_t gid = 0; gid < map->map->tilecount; gid++)
+    {
+        map->animSlot[gid] = -1;
+    }
+    for (uint32_t i = 0; i < map->numAnimGids; i++)
+    {
+        map->animSlot[map->animGid[i]] = (int32_t)i;
+    }
+
+    uint32_t  numCells = 0;
+    tmx_layer *layers  = map->map->ly_head;
+    while(layers)
+    {
+        // Hidden layers are never drawn, so they get no animation list.
+        if ((L_LAYER != layers->type) || (0 == layers->visible))
+        {
+            layers = layers->next;
+            continue;
+        }
+
+        MapAnimList *list = calloc(1, sizeof(struct mapAnimList_t));
+        if (NULL == list)
+        {
+            fprintf(stderr, "mapInit(): error allocating memory.\n");
+            return -1;
+        }
+        layers->user_data.pointer = list;
+
+        // The cells are counted first, then collected.
+        for (uint8_t pass = 0; pass < 2; pass++)
+        {
+            if (1 == pass)
+            {
+                if (0 == list->count)
+                {
+                    break;
+                }
+
+                list->cell  = malloc(list->count * sizeof(uint32_t));
+                list->frame = calloc(list->count, sizeof(uint16_t));
+                if ((NULL == list->cell) || (NULL == list->frame))
+                {
+                    fprintf(stderr, "mapInit(): error allocating memory.\n");
+                    return -1;
+                }
+                list->count = 0;
+            }
+
+            for (uint32_t ih = 0; ih < map->map->height; ih++)
+            {
+                int32_t *gids = mapLayerRow(map, layers, 0, ih, map->map->width);
+                if (NULL == gids)
+                {
+                    return -1;
+                }
+
+                for (uint32_t iw = 0; iw < map->map->width; iw++)
+                {
+                    uint32_t gid = gids[iw] & TMX_FLIP_BITS_REMOVAL;
+                    if ((0 == pass) && (gid < map->map->tilecount))
+                    {
+                        mapTileReach(map, map->map->tiles[gid]);
+                    }
+                    if ((gid < map->map->tilecount) && (NULL != map->map->tiles[gid]) && (map->map->tiles[gid]->animation_len))
+                    {
+                        if (1 == pass)
+                        {
+                            list->cell[list->count] = (ih * map->map->width) + iw;
+                        }
+                        list->count++;
+                    }
+                }
+            }
+        }
+
+        numCells += list->count;
+        layers    = layers->next;
+    }
+
+    map->animDirtyCell = malloc((numCells ? numCells : 1) * sizeof(uint32_t));
+    map->animDirty     = calloc(map->map->width * map->map->height, sizeof(uint8_t));
+    if ((NULL == map->animDirtyCell) || (NULL == map->animDirty))
+    {
+        fprintf(stderr, "mapInit(): error allocating memory.\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Draw a single tile onto the current render target.  Animated
+ *          tiles are drawn in their current frame.  See mapFrame().
+ * @param   renderer SDL's rendering context.  See @ref struct Video.
+ * @param   map      the map.
+ * @param   gid      global tile ID, including flip bits.
+ * @param   posX     render position of the cell along the x-axis.
+ * @param   posY     render position of the cell along the y-axis.
+ * @ingroup Map
+ */
+static void mapDrawTile(SDL_Renderer *renderer, Map *map, uint32_t gid, int32_t posX, int32_t posY)
+{
+    SDL_Rect    dst;
+    SDL_Rect    src;
+    tmx_image   *image;
+    tmx_tile    *tile;
+    tmx_tileset *ts;
+
+    gid &= TMX_FLIP_BITS_REMOVAL;
+    if ((gid >= map->map->tilecount) || (NULL == map->map->tiles[gid]))
+    {
+        return;
+    }
+
+    tile = map->map->tiles[gid];
+    ts   = tile->tileset;
+
+    if (tile->animation_len && (-1 != map->animSlot[gid]))
+    {
+        uint32_t tileID = tile->animation[map->animFrame[map->animSlot[gid]]].tile_id;
+        if (tileID < ts->tilecount)
+        {
+            tile = &ts->tiles[tileID];
+        }
+    }
+
+    dst.x = posX;
+    dst.y = posY;
+
+    if (NULL != tile->image)
+    {
+        // Tile from an image collection, aligned bottom-left.
+        image = tile->image;
+        src.x = 0;
+        src.y = 0;
+        src.w = dst.w = image->width;
+        src.h = dst.h = image->height;
+        dst.y = dst.y + map->map->tile_height - image->height;
+    }
+    else
+    {
+        image = ts->image;
+        src.x = tile->ul_x;
+        src.y = tile->ul_y;
+        src.w = dst.w = ts->tile_width;
+        src.h = dst.h = ts->tile_height;
+    }
+
+    if ((NULL == image) || (NULL == image->resource_image))
+    {
+        return;
+    }
+
+    SDL_RenderCopy(renderer, image->resource_image, &src, &dst);
+}
+
+/**
+ * @brief   Draw a range of cells of all layers matching a name onto the
+ *          current render target, which holds the given chunk.
+ * @param   renderer SDL's rendering context.  See @ref struct Video.
+ * @param   map      the map.
+ * @param   name     substring of the layer name(s) that should be rendered.
+ * @param   left     first cell along the x-axis.
+ * @param   top      first cell along the y-axis.
+ * @param   right    cell after the last one along the x-axis.
+ * @param   bottom   cell after the last one along the y-axis.
+ * @param   chunkX   chunk coordinate along the x-axis.
+ * @param   chunkY   chunk coordinate along the y-axis.
+ * @return  0 on success, -1 on error.
+ * @ingroup Map
+ */
+static int8_t mapDrawCells(
+    SDL_Renderer *renderer,
+    Map          *map,
+    const char   *name,
+    uint32_t     left,
+    uint32_t     top,
+    uint32_t     right,
+    uint32_t     bottom,
+    uint32_t     chunkX,
+    uint32_t     chunkY)
+{
+    if ((left >= right) || (top >= bottom))
+    {
+        return 0;
+    }
+
+    tmx_layer *layers = map->map->ly_head;
+    while(layers)
+    {
+        if ((L_LAYER == layers->type) && (layers->visible) && (NULL != strstr(layers->name, name)))
+        {
+            for (uint32_t ih = top; ih < bottom; ih++)
+            {
+                int32_t *gids = mapLayerRow(map, layers, left, ih, right - left);
+                if (NULL == gids)
+                {
+                    return -1;
+                }
+
+                for (uint32_t iw = left; iw < right; iw++)
+                {
+                    mapDrawTile(
+                        renderer,
+                        map,
+                        gids[iw - left],
+                        (iw * map->map->tile_width)  - (chunkX * MAP_CHUNK_SIZE),
+                        (ih * map->map->tile_height) - (chunkY * MAP_CHUNK_SIZE));
+                }
+            }
+        }
+        layers = layers->next;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Re-bake a single cell in all cached chunks of the given texture
+ *          indices.  The area any frame of the cell may cover is cleared and
+ *          redrawn, including the tiles of neighbouring cells reaching into
+ *          it.
+ * @param   renderer SDL's rendering context.  See @ref struct Video.
+ * @param   map      the map.
+ * @param   indices  bit mask of the texture indices to update.
+ * @param   cell     the cell index.
+ * @param   target   the chunk texture currently used as render target.
+ * @return  0 on success, -1 on error.
+ * @ingroup Map
+ */
+static int8_t mapRebakeCell(SDL_Renderer *renderer, Map *map, uint8_t indices, uint32_t cell, SDL_Texture **target)
+{
+    uint32_t tileWidth  = map->map->tile_width;
+    uint32_t tileHeight = map->map->tile_height;
+    uint32_t iw         = cell % map->map->width;
+    uint32_t ih         = cell / map->map->width;
+
+    // Area of the cell including the reach of its tiles, in pixels.  Tiles
+    // at the edge of the map may reach into the rest of the last chunks.
+    uint32_t areaL = iw * tileWidth;
+    uint32_t areaT = (ih * tileHeight > map->reachUp) ? (ih * tileHeight) - map->reachUp : 0;
+    uint32_t areaR = ((iw + 1) * tileWidth)  + map->reachRight;
+    uint32_t areaB = ((ih + 1) * tileHeight) + map->reachDown;
+    if (areaR > map->chunkCountX * MAP_CHUNK_SIZE) areaR = map->chunkCountX * MAP_CHUNK_SIZE;
+    if (areaB > map->chunkCountY * MAP_CHUNK_SIZE) areaB = map->chunkCountY * MAP_CHUNK_SIZE;
+
+    // Cells whose tiles may reach into the area.
+    uint32_t reachX = (map->reachRight + tileWidth - 1) / tileWidth;
+    uint32_t reachY = (map->reachUp + map->reachDown + tileHeight - 1) / tileHeight;
+    uint32_t left   = (iw > reachX) ? iw - reachX : 0;
+    uint32_t top    = (ih > reachY) ? ih - reachY : 0;
+    uint32_t right  = iw + reachX + 1;
+    uint32_t bottom = ih + reachY + 1;
+    if (right  > map->map->width)  right  = map->map->width;
+    if (bottom > map->map->height) bottom = map->map->height;
+
+    for (uint8_t index = 0; index < MAX_TEXTURES_PER_MAP; index++)
+    {
+        if (0 == ((indices >> index) & 1))
+        {
+            continue;
+        }
+
+        for (uint32_t chunkY = areaT / MAP_CHUNK_SIZE; chunkY <= (areaB - 1) / MAP_CHUNK_SIZE; chunkY++)
+        {
+            for (uint32_t chunkX = areaL / MAP_CHUNK_SIZE; chunkX <= (areaR - 1) / MAP_CHUNK_SIZE; chunkX++)
+            {
+                uint32_t slot = (chunkY * map->chunkCountX) + chunkX;
+                if (-1 == map->chunkSlot[index][slot])
+                {
+                    continue;
+                }
+
+                MapChunk *chunk = &map->chunk[map->chunkSlot[index][slot]];
+                if (*target != chunk->texture)
+                {
+                    if (0 != SDL_SetRenderTarget(renderer, chunk->texture))
+                    {
+                        fprintf(stderr, "%s\n", SDL_GetError());
+                        return -1;
+                    }
+                    *target = chunk->texture;
+                }
+
+                // Part of the area within the chunk.
+                uint32_t chunkL = chunkX * MAP_CHUNK_SIZE;
+                uint32_t chunkT = chunkY * MAP_CHUNK_SIZE;
+                uint32_t clipL  = (areaL > chunkL) ? areaL : chunkL;
+                uint32_t clipT  = (areaT > chunkT) ? areaT : chunkT;
+                uint32_t clipR  = (areaR < chunkL + MAP_CHUNK_SIZE) ? areaR : chunkL + MAP_CHUNK_SIZE;
+                uint32_t clipB  = (areaB < chunkT + MAP_CHUNK_SIZE) ? areaB : chunkT + MAP_CHUNK_SIZE;
+                SDL_Rect clip   = { clipL - chunkL, clipT - chunkT, clipR - clipL, clipB - clipT };
+
+                // Clear the area, then draw all layers of this index on top.
+                uint8_t       r, g, b, a;
+                SDL_BlendMode blendMode;
+                SDL_RenderSetClipRect(renderer, &clip);
+                SDL_GetRenderDrawColor(renderer, &r, &g, &b, &a);
+                SDL_GetRenderDrawBlendMode(renderer, &blendMode);
+                SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+                SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+                SDL_RenderFillRect(renderer, &clip);
+                SDL_SetRenderDrawColor(renderer, r, g, b, a);
+                SDL_SetRenderDrawBlendMode(renderer, blendMode);
+
+                // Only the cells the chunk has been baked with, see
+                // mapBakeChunk().
+                uint32_t cellL = chunkL / tileWidth;
+                uint32_t cellT = chunkT / tileHeight;
+                uint32_t cellR = (chunkL + MAP_CHUNK_SIZE + tileWidth  - 1) / tileWidth;
+                uint32_t cellB = (chunkT + MAP_CHUNK_SIZE + tileHeight - 1) / tileHeight;
+                if (cellL < left)   cellL = left;
+                if (cellT < top)    cellT = top;
+                if (cellR > right)  cellR = right;
+                if (cellB > bottom) cellB = bottom;
+
+                int8_t result = mapDrawCells(renderer, map, map->layerName[index], cellL, cellT, cellR, cellB, chunkX, chunkY);
+                SDL_RenderSetClipRect(renderer, NULL);
+                if (-1 == result)
+                {
+                    return -1;
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Bake a chunk of the map into its texture.
+ * @param   renderer SDL's rendering context.  See @ref struct Video.
+ * @param   map      the map.
+ * @param   name     substring of the layer name(s) that should be rendered.
+ * @param   chunk    the chunk to bake.  See @ref struct MapChunk.
+ * @param   chunkX   chunk coordinate along the x-axis.
+ * @param   chunkY   chunk coordinate along the y-axis.
+ * @return  0 on success, -1 on error.
+ * @ingroup Map
+ */
+static int8_t mapBakeChunk(
+    SDL_Renderer *renderer,
+    Map          *map,
+    const char   *name,
+    MapChunk     *chunk,
+    uint32_t     chunkX,
+    uint32_t     chunkY)
+{
+    if (NULL == chunk->texture)
+    {
+        chunk->texture = SDL_CreateTexture(
+            renderer,
+            SDL_PIXELFORMAT_ARGB8888,
+            SDL_TEXTUREACCESS_TARGET,
+            MAP_CHUNK_SIZE,
+            MAP_CHUNK_SIZE);
+
+        if (NULL == chunk->texture)
+        {
+            fprintf(stderr, "%s\n", SDL_GetError());
+            return -1;
+        }
+
+        if (0 != SDL_SetTextureBlendMode(chunk->texture, SDL_BLENDMODE_BLEND))
+        {
+            fprintf(stderr, "%s\n", SDL_GetError());
+            return -1;
+        }
+    }
+
+    if (0 != SDL_SetRenderTarget(renderer, chunk->texture))
+    {
+        fprintf(stderr, "%s\n", SDL_GetError());
+        return -1;
+    }
+
+    // Recycled textures still hold the previous chunk.
+    uint8_t r, g, b, a;
+    SDL_GetRenderDrawColor(renderer, &r, &g, &b, &a);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+    SDL_RenderClear(renderer);
+    SDL_SetRenderDrawColor(renderer, r, g, b, a);
+
+    // Tiles overlapping the chunk.
+    uint32_t left   = (chunkX * MAP_CHUNK_SIZE) / map->map->tile_width;
+    uint32_t top    = (chunkY * MAP_CHUNK_SIZE) / map->map->tile_height;
+    uint32_t right  = ((chunkX + 1) * MAP_CHUNK_SIZE + map->map->tile_width  - 1) / map->map->tile_width;
+    uint32_t bottom = ((chunkY + 1) * MAP_CHUNK_SIZE + map->map->tile_height - 1) / map->map->tile_height;
+    if (right  > map->map->width)  right  = map->map->width;
+    if (bottom > map->map->height) bottom = map->map->height;
+
+    if (-1 == mapDrawCells(renderer, map, name, left, top, right, bottom, chunkX, chunkY))
+    {
+        return -1;
+    }
+
+    // Switch back to default render target.
+    if (0 != SDL_SetRenderTarget(renderer, NULL))
+    {
+        fprintf(stderr, "%s\n", SDL_GetError());
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Get a cache entry for a chunk.  Chunks that are not cached yet are
+ *          baked into the least recently used entry.
+ * @param   renderer SDL's rendering context.  See @ref struct Video.
+ * @param   map      the map.
+ * @param   name     substring of the layer name(s) that should be rendered.
+ * @param   index    the texture index.
+ * @param   chunkX   chunk coordinate along the x-axis.
+ * @param   chunkY   chunk coordinate along the y-axis.
+ * @return  the chunk on success, NULL on error.
+ * @ingroup Map
+ */
+static MapChunk *mapFetchChunk(
+    SDL_Renderer *renderer,
+    Map          *map,
+    const char   *name,
+    uint8_t      index,
+    uint32_t     chunkX,
+    uint32_t     chunkY)
+{
+    int32_t  slot = (chunkY * map->chunkCountX) + chunkX;
+    MapChunk *chunk;
+
+    if (-1 != map->chunkSlot[index][slot])
+    {
+        chunk           = &map->chunk[map->chunkSlot[index][slot]];
+        chunk->lastUsed = map->chunkTick;
+        return chunk;
+    }
+
+    // Find an unused or the least recently used entry.
+    uint32_t lru = 0;
+    for (uint32_t i = 0; i < map->numChunks; i++)
+    {
+        if (-1 == map->chunk[i].slot)
+        {
+            lru = i;
+            break;
+        }
+        if (map->chunk[i].lastUsed < map->chunk[lru].lastUsed)
+        {
+            lru = i;
+        }
+    }
+
+    /* Every call to mapRender() advances chunkTick, so an entry that has been
+     * used within the last MAX_TEXTURES_PER_MAP ticks is still on screen.
+     * Grow the cache instead of thrashing it. */
+    if ((0 == map->numChunks) ||
+        ((-1 != map->chunk[lru].slot) && (map->chunk[lru].lastUsed + MAX_TEXTURES_PER_MAP > map->chunkTick)))
+    {
+        uint32_t numChunks = map->numChunks ? map->numChunks * 2 : MAP_CHUNK_BUDGET;
+        MapChunk *chunks   = realloc(map->chunk, numChunks * sizeof(struct mapChunk_t));
+        if (NULL == chunks)
+        {
+            fprintf(stderr, "mapRender(): error allocating memory.\n");
+            return NULL;
+        }
+        for (uint32_t i = map->numChunks; i < numChunks; i++)
+        {
+            chunks[i].texture  = NULL;
+            chunks[i].slot     = -1;
+            chunks[i].lastUsed = 0;
+            chunks[i].index    = 0;
+        }
+        lru            = map->numChunks;
+        map->chunk     = chunks;
+        map->numChunks = numChunks;
+    }
+
+    chunk = &map->chunk[lru];
+    if (-1 != chunk->slot)
+    {
+        map->chunkSlot[chunk->index][chunk->slot] = -1;
+    }
+
+    chunk->slot     = slot;
+    chunk->index    = index;
+    chunk->lastUsed = map->chunkTick;
+    map->chunkSlot[index][slot] = lru;
+
+    if (-1 == mapBakeChunk(renderer, map, name, chunk, chunkX, chunkY))
+    {
+        map->chunkSlot[index][slot] = -1;
+        chunk->slot = -1;
+        return NULL;
+    }
+
+    return chunk;
+}
+
+/**
+ * @brief   Test if a cell blocks movement.  Cells outside the map never do.
+ * @param   map  the map.
+ * @param   col  column of the cell.
+ * @param   row  row of the cell.
+ * @param   mask bit mask of blocking tile types.
+ * @return  1 if the cell blocks, 0 otherwise.
+ * @ingroup Map
+ */
+static uint8_t mapCellBlocks(Map *map, int32_t col, int32_t row, uint16_t mask)
+{
+    if ((col < 0) || (row < 0) || (col >= (int32_t)map->map->width) || (row >= (int32_t)map->map->height))
+    {
+        return 0;
+    }
+
+    return (map->cellFlags[(row * map->map->width) + col] & mask) ? 1 : 0;
+}
+
+/**
+ * @brief   Convert world coordinates into a cell index.
+ * @param   map  the map.
+ * @param   xPos coordinate along the x-axis.
+ * @param   yPos coordinate along the y-axis.
+ * @return  the cell index, or -1 if the coordinates are outside the map.
+ * @ingroup Map
+ */
+static int32_t mapCellIndex(Map *map, double xPos, double yPos)
+{
+    xPos = xPos / map->map->tile_width;
+    yPos = yPos / map->map->tile_height;
+
+    // Prevent segfaults by setting boundaries.
+    if ((xPos < 0) ||
+        (yPos < 0) ||
+        (xPos >= map->map->width) ||
+        (yPos >= map->map->height))
+    {
+            return -1;
+    }
+
+    return ((int32_t)yPos * map->map->width) + (int32_t)xPos;
+}
+
+/**
+ * @brief   Get the compiled tile type flags of a cell.
+ * @param   map  the map.
+ * @param   xPos coordinate along the x-axis.
+ * @param   yPos coordinate along the y-axis.
+ * @return  bit mask of the tile types of all layers, 0 outside the map.
+ * @ingroup Map
+ */
+uint16_t mapCoordFlags(Map *map, double xPos, double yPos)
+{
+    int32_t cell = mapCellIndex(map, xPos, yPos);
+    if (-1 == cell)
+    {
+        return 0;
+    }
+
+    return map->cellFlags[cell];
+}
+
 /**
  * @brief   Check whether a tile is from a specific type or not.
  * @param   map  the map.
+ * @param   type interned tile type, e.g. TILE_FLOOR.  See mapTypeIndex().
+ * @param   xPos coordinate along the x-axis.
+ * @param   yPos coordinate along the y-axis.
+ * @return  1 if the tile is of the specific type, 0 if not.
+ * @ingroup Map
+ */
+uint8_t mapCoordHasType(Map *map, uint8_t type, double xPos, double yPos)
+{
+    return (mapCoordFlags(map, xPos, yPos) >> type) & 1;
+}
+
+/**
+ * @brief   Check whether a tile is from a specific type or not.  Prefer
+ *          mapCoordHasType() in performance critical code.
+ * @param   map  the map.
  * @param   type name of the tile type to look for.
  * @param   xPos coordinate along the x-axis.
  * @param   yPos coordinate along the y-axis.
@@ -22,35 +1208,163 @@
  */
 uint8_t mapCoordIsType(Map *map, const char *type, double xPos, double yPos)
 {
-    xPos = xPos / map->map->tile_width + 1;
-    yPos = yPos / map->map->tile_height;
+    int8_t index = mapTypeIndex(map, type);
+    if (-1 == index)
+    {
+        return 0;
+    }
+
+    return mapCoordHasType(map, index, xPos, yPos);
+}
+
+/**
+ * @brief   Get a numeric tile property.
+ * @param   map  the map.
+ * @param   prop interned property.  See mapPropertyIndex().
+ * @param   xPos coordinate along the x-axis.
+ * @param   yPos coordinate along the y-axis.
+ * @return  the value of the topmost tile carrying properties, 0 if unset.
+ * @ingroup Map
+ */
+double mapCoordProperty(Map *map, int8_t prop, double xPos, double yPos)
+{
+    int32_t cell = mapCellIndex(map, xPos, yPos);
+    if ((-1 == cell) || (prop < 0) || (prop >= map->numProps))
+    {
+        return 0;
+    }
+
+    return map->propTable[(map->cellProps[cell] * MAX_TILE_PROPS) + prop];
+}
+
+/**
+ * @brief   Update map.  Advances tile animations and re-bakes the cells of
+ *          cached chunks whose animation frame has changed.  This function has
+ *          to be called every frame.
+ * @param   renderer SDL's rendering context.  See @ref struct Video.
+ * @param   map      the map.
+ * @param   dTime    delta time; time passed since last frame in seconds.
+ * @return  0 on success, -1 on error.
+ * @ingroup Map
+ */
+int8_t mapFrame(SDL_Renderer *renderer, Map *map, double dTime)
+{
+    uint8_t changed = 0;
+
+    if (0 == map->numAnimGids)
+    {
+        return 0;
+    }
+
+    map->animTime += dTime * 1000;
+
+    // Update the current frame of every animated tile.
+    for (uint32_t i = 0; i < map->numAnimGids; i++)
+    {
+        tmx_tile *tile     = map->map->tiles[map->animGid[i]];
+        uint32_t duration  = 0;
+        uint32_t frame     = 0;
+        double   frameTime;
+
+        for (uint32_t j = 0; j < tile->animation_len; j++)
+        {
+            duration += tile->animation[j].duration;
+        }
+        if (0 == duration)
+        {
+            continue;
+        }
+
+        frameTime = fmod(map->animTime, duration);
+        while (frameTime >= tile->animation[frame].duration)
+        {
+            frameTime -= tile->animation[frame].duration;
+            frame++;
+        }
+
+        if (map->animFrame[i] != frame)
+        {
+            map->animFrame[i] = frame;
+            changed           = 1;
+        }
+    }
 
-    // Prevent segfaults by setting boundaries.
-    if ((xPos < 0) ||
-        (yPos < 0) ||
-        (xPos > map->map->width) ||
-        (yPos > map->map->height))
+    if (0 == changed)
     {
-            return 0;
+        return 0;
     }
 
-    tmx_layer *layers = map->map->ly_head;
+    // Collect the cells that show a new frame.
+    SDL_Texture *target   = NULL;
+    uint32_t    numDirty = 0;
+    tmx_layer   *layers   = map->map->ly_head;
     while(layers)
     {
-        uint16_t gid = layers->content.gids[((int32_t)yPos * map->map->width) + (int32_t)xPos] & TMX_FLIP_BITS_REMOVAL;
-        if (NULL != map->map->tiles[gid])
+        MapAnimList *list    = layers->user_data.pointer;
+        uint8_t     indices  = 0;
+
+        if ((L_LAYER != layers->type) || (NULL == list))
+        {
+            layers = layers->next;
+            continue;
+        }
+
+        for (uint8_t index = 0; index < MAX_TEXTURES_PER_MAP; index++)
         {
-            if (NULL != map->map->tiles[gid]->type)
+            if ((map->layerName[index]) && (layers->visible) && (NULL != strstr(layers->name, map->layerName[index])))
             {
-                if (0 == strcmp(type, map->map->tiles[gid]->type))
-                {
-                    return 1;
-                }
+                indices |= 1 << index;
+            }
+        }
+
+        for (uint32_t i = 0; i < list->count; i++)
+        {
+            uint32_t cell  = list->cell[i];
+            uint32_t gid   = tmx_get_layer_gid(map->map, layers, cell % map->map->width, cell / map->map->width) & TMX_FLIP_BITS_REMOVAL;
+            uint16_t frame = map->animFrame[map->animSlot[gid]];
+
+            if (list->frame[i] == frame)
+            {
+                continue;
             }
+            list->frame[i] = frame;
+
+            if (indices && (0 == map->animDirty[cell]))
+            {
+                map->animDirtyCell[numDirty] = cell;
+                numDirty++;
+            }
+            map->animDirty[cell] |= indices;
         }
+
         layers = layers->next;
     }
 
+    // Every cell once, with all texture indices of the layers it changed in.
+    int8_t result = 0;
+    for (uint32_t i = 0; i < numDirty; i++)
+    {
+        uint32_t cell    = map->animDirtyCell[i];
+        uint8_t  indices = map->animDirty[cell];
+
+        map->animDirty[cell] = 0;
+        if ((0 == result) && (-1 == mapRebakeCell(renderer, map, indices, cell, &target)))
+        {
+            result = -1;
+        }
+    }
+    if (-1 == result)
+    {
+        return -1;
+    }
+
+    // Switch back to default render target.
+    if ((NULL != target) && (0 != SDL_SetRenderTarget(renderer, NULL)))
+    {
+        fprintf(stderr, "%s\n", SDL_GetError());
+        return -1;
+    }
+
     return 0;
 }
 
@@ -61,47 +1375,262 @@ uint8_t mapCoordIsType(Map *map, const char *type, double xPos, double yPos)
  */
 void mapFree(Map *map)
 {
+    if (NULL == map)
+    {
+        return;
+    }
+
+    free(map->cellFlags);
+    free(map->cellProps);
+    free(map->propTable);
+
+    for (uint32_t i = 0; i < map->numChunks; i++)
+    {
+        SDL_DestroyTexture(map->chunk[i].texture);
+    }
+    free(map->chunk);
+
+    for (uint8_t i = 0; i < MAX_TEXTURES_PER_MAP; i++)
+    {
+        free(map->chunkSlot[i]);
+    }
+
+    tmx_layer *layers = map->map ? map->map->ly_head : NULL;
+    while(layers)
+    {
+        MapAnimList *list = layers->user_data.pointer;
+        if ((L_LAYER == layers->type) && (NULL != list))
+        {
+            free(list->cell);
+            free(list->frame);
+            free(list);
+        }
+        layers = layers->next;
+    }
+    free(map->animGid);
+    free(map->animFrame);
+    free(map->animSlot);
+    free(map->animDirtyCell);
+    free(map->animDirty);
+    free(map->rowGids);
+
     tmx_map_free(map->map);
+    free(map);
 }
 
 /**
- * @brief   Initialise map.  See @ref struct Map.
- * @param   filename the TMX map file to load.
+ * @brief   Allocate a map without any TMX data.  See @ref struct Map.
  * @return  Map on success, NULL on error.
  * @ingroup Map
  */
-Map *mapInit(const char *filename)
+static Map *mapCreate(void)
 {
-    static Map *map;
-    map = malloc(sizeof(struct map_t));
+    Map *map = malloc(sizeof(struct map_t));
     if (NULL == map)
     {
         fprintf(stderr, "mapInit(): error allocating memory.\n");
         return NULL;
     }
 
-    map->map = tmx_load(filename);
-    if (NULL == map->map)
+    map->map           = NULL;
+    map->chunk         = NULL;
+    map->chunkTick     = 0;
+    map->animGid       = NULL;
+    map->animFrame     = NULL;
+    map->animSlot      = NULL;
+    map->animTime      = 0;
+    map->numAnimGids   = 0;
+    map->animDirtyCell = NULL;
+    map->animDirty     = NULL;
+    map->reachRight    = 0;
+    map->reachUp       = 0;
+    map->reachDown     = 0;
+    map->numChunks     = 0;
+    map->cellFlags     = NULL;
+    map->cellProps     = NULL;
+    map->propTable     = NULL;
+    map->numPropRows   = 0;
+    map->numProps      = 0;
+    map->numTypes      = 0;
+    map->rowGids       = NULL;
+
+    for (uint8_t i = 0; i < MAX_TEXTURES_PER_MAP; i++)
     {
-        fprintf(stderr, "%s\n", tmx_strerr());
-        return NULL;
+        map->chunkSlot[i] = NULL;
+        map->layerName[i] = NULL;
     }
 
+    // Tile types with a fixed bit.  See TILE_FLOOR, etc..
+    map->typeName[TILE_FLOOR]  = "floor";
+    map->typeName[TILE_SOLID]  = "solid";
+    map->typeName[TILE_HAZARD] = "hazard";
+    map->numTypes              = TILE_HAZARD + 1;
+
+    return map;
+}
+
+/**
+ * @brief   Compile everything the game needs from the loaded TMX data.
+ *          Neither renders, touches the asset cache nor writes to the
+ *          tiles, which may be shared through a tileset manager, so it may
+ *          run on any thread.
+ * @param   map the map, freed on error.
+ * @return  Map on success, NULL on error.
+ * @ingroup Map
+ */
+static Map *mapCompile(Map *map)
+{
     map->height    = map->map->height * map->map->tile_height;
     map->width     = map->map->width  * map->map->tile_width;
     map->worldPosX = 0;
     map->worldPosY = 0;
 
-    for (uint8_t i = 0; i < MAX_TEXTURES_PER_MAP; i++)
+    map->chunkCountX = (map->width  + MAP_CHUNK_SIZE - 1) / MAP_CHUNK_SIZE;
+    map->chunkCountY = (map->height + MAP_CHUNK_SIZE - 1) / MAP_CHUNK_SIZE;
+
+    map->rowGids = malloc(map->map->width * sizeof(int32_t));
+    if (NULL == map->rowGids)
+    {
+        fprintf(stderr, "mapInit(): error allocating memory.\n");
+        mapFree(map);
+        return NULL;
+    }
+
+    if (-1 == mapCompileAttributes(map))
+    {
+        mapFree(map);
+        return NULL;
+    }
+
+    if (-1 == mapCompileAnimations(map))
     {
-        map->texture[i] = NULL;
+        mapFree(map);
+        return NULL;
     }
 
     return map;
 }
 
 /**
- * @brief   Render map on screen.
+ * @brief   Initialise map.  See @ref struct Map.
+ * @param   renderer SDL's rendering context used to load the tileset
+ *                   images.  See @ref struct Video.
+ * @param   filename the TMX map file to load.
+ * @return  Map on success, NULL on error.
+ * @ingroup Map
+ */
+Map *mapInit(SDL_Renderer *renderer, const char *filename)
+{
+    Map *map = mapCreate();
+    if (NULL == map)
+    {
+        return NULL;
+    }
+
+    mapInitContext(&map->ctx, &map->images, renderer);
+
+    map->map = mapLoad(&map->ctx, NULL, filename);
+    if (NULL == map->map)
+    {
+        fprintf(stderr, "%s\n", tmx_ctx_strerr(&map->ctx));
+        free(map);
+        return NULL;
+    }
+
+    return mapCompile(map);
+}
+
+/**
+ * @brief   Set up a TMX loader context with the game's hooks.  Has to be
+ *          called on the thread that owns the renderer; images loaded on
+ *          any other thread are only decoded until mapUpload().
+ * @param   ctx      the loader context.
+ * @param   images   the owner of the images loaded with the context.  Has
+ *                   to outlive the context.  See @ref struct MapImages.
+ * @param   renderer SDL's rendering context used to load the tileset
+ *                   images, NULL to load no images at all.
+ * @ingroup Map
+ */
+void mapInitContext(tmx_ctx *ctx, MapImages *images, SDL_Renderer *renderer)
+{
+    // The context starts from the library's globals, which keeps the trace
+    // hook.  See traceInit().
+    tmx_ctx_init(ctx);
+
+    images->renderer = renderer;
+    images->thread   = SDL_ThreadID();
+    images->pending  = NULL;
+    images->lock     = 0;
+    ctx->userdata    = images;
+
+    // Without a renderer (headless mode) no images are loaded at all.
+    ctx->img_load_func  = renderer ? mapImageLoad : NULL;
+    ctx->img_free_func  = renderer ? mapImageFree : NULL;
+    ctx->file_read_func = mapFileRead;
+    // The map is freed in one go by mapFree().  See tmx_arena_mode.
+    ctx->arena_mode     = 1;
+    // mapCompileAttributes() reads every tile layer anyway, so the layers
+    // are decoded up front in parallel and stored in the smallest form that
+    // fits.  See mapLayerRow().
+    ctx->parallel_func  = mapParallel;
+    ctx->compact_layers = 1;
+}
+
+/**
+ * @brief   Initialise map with a shared tileset manager, so tilesets already
+ *          loaded for another map are neither parsed nor uploaded again.
+ *          May run on any thread, as long as no other thread uses the same
+ *          tileset manager meanwhile.  Images decoded on another thread than
+ *          the one that set up the context are uploaded by mapUpload().
+ * @param   tilesets the tileset manager, made with the context set up by
+ *                   mapInitContext().  Has to outlive the map.
+ * @param   filename the TMX map file to load.
+ * @return  Map on success, NULL on error.
+ * @ingroup Map
+ */
+Map *mapInitShared(tmx_tileset_manager *tilesets, const char *filename)
+{
+    Map *map = mapCreate();
+    if (NULL == map)
+    {
+        return NULL;
+    }
+
+    map->map = mapLoad(NULL, tilesets, filename);
+    if (NULL == map->map)
+    {
+        fprintf(stderr, "%s\n", tmx_strerr());
+        free(map);
+        return NULL;
+    }
+
+    return mapCompile(map);
+}
+
+/**
+ * @brief   Look up an interned numeric tile property.
+ * @param   map  the map.
+ * @param   name name of the property.
+ * @return  index of the property, -1 if no tile carries it.
+ * @ingroup Map
+ */
+int8_t mapPropertyIndex(Map *map, const char *name)
+{
+    for (uint8_t i = 0; i < map->numProps; i++)
+    {
+        if (0 == strcmp(name, map->propName[i]))
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief   Render map on screen.  The map is baked lazily into chunks of
+ *          MAP_CHUNK_SIZE pixels once they enter the camera's field of view
+ *          and only the visible chunks are drawn.
  * @param   renderer   SDL's rendering context.  See @ref struct Video.
  * @param   map        the map that should be rendered.
  * @param   name       substring of the layer name(s) that should be rendered.
@@ -124,108 +1653,266 @@ int8_t mapRender(
     double       cameraPosX,
     double       cameraPosY)
 {
-    // Render texture if already generated.
-    if (map->texture[index])
+    if (index >= MAX_TEXTURES_PER_MAP)
     {
-        double renderPosX = map->worldPosX - cameraPosX;
-        double renderPosY = map->worldPosY - cameraPosY;
+        fprintf(stderr, "mapRender(): invalid texture index %u.\n", index);
+        return -1;
+    }
 
-        SDL_Rect dst =
-        {
-            renderPosX,
-            renderPosY,
-            map->map->width * map->map->tile_width,
-            map->map->height * map->map->tile_height
-        };
-        if (-1 == SDL_RenderCopyEx(renderer, map->texture[index], NULL, &dst, 0, NULL, SDL_FLIP_NONE))
+    if (NULL == map->chunkSlot[index])
+    {
+        map->chunkSlot[index] = malloc(map->chunkCountX * map->chunkCountY * sizeof(int32_t));
+        if (NULL == map->chunkSlot[index])
         {
-            fprintf(stderr, "%s\n", SDL_GetError());
+            fprintf(stderr, "mapRender(): error allocating memory.\n");
             return -1;
         }
-        return 0;
+        for (uint32_t i = 0; i < map->chunkCountX * map->chunkCountY; i++)
+        {
+            map->chunkSlot[index][i] = -1;
+        }
     }
 
-    // Generate texture.
-    map->texture[index] = SDL_CreateTexture(
-        renderer,
-        SDL_PIXELFORMAT_ARGB8888,
-        SDL_TEXTUREACCESS_TARGET,
-        map->map->width  * map->map->tile_width,
-        map->map->height * map->map->tile_height);
+    // Remember which layers are baked into this index.  See mapFrame().
+    map->layerName[index] = name;
 
-    if (NULL == map->texture[index])
+    if (bg)
     {
-        fprintf(stderr, "%s\n", SDL_GetError());
-        return -1;
+        SDL_SetRenderDrawColor(
+            renderer,
+            (map->map->backgroundcolor >> 16) & 0xFF,
+            (map->map->backgroundcolor >>  8) & 0xFF,
+            (map->map->backgroundcolor)       & 0xFF,
+            255);
     }
 
-    SDL_Texture *tileset = IMG_LoadTexture(renderer, "res/tilesets/tileset.png");
-    if (NULL == tileset)
+    map->chunkTick++;
+
+    // Determine the visible chunks.
+    int32_t viewWidth;
+    int32_t viewHeight;
+    SDL_RenderGetLogicalSize(renderer, &viewWidth, &viewHeight);
+    if ((0 == viewWidth) || (0 == viewHeight))
     {
-        fprintf(stderr, "%s\n", SDL_GetError());
-        return -1;
+        viewWidth  = map->width;
+        viewHeight = map->height;
     }
 
-    if (0 != SDL_SetRenderTarget(renderer, map->texture[index]))
+    double  renderPosX = map->worldPosX - cameraPosX;
+    double  renderPosY = map->worldPosY - cameraPosY;
+    int32_t firstX     = floor(-renderPosX / MAP_CHUNK_SIZE);
+    int32_t firstY     = floor(-renderPosY / MAP_CHUNK_SIZE);
+    int32_t lastX      = floor((viewWidth  - renderPosX - 1) / MAP_CHUNK_SIZE);
+    int32_t lastY      = floor((viewHeight - renderPosY - 1) / MAP_CHUNK_SIZE);
+    if (firstX < 0)                            firstX = 0;
+    if (firstY < 0)                            firstY = 0;
+    if (lastX >= (int32_t)map->chunkCountX)    lastX  = map->chunkCountX - 1;
+    if (lastY >= (int32_t)map->chunkCountY)    lastY  = map->chunkCountY - 1;
+
+    for (int32_t chunkY = firstY; chunkY <= lastY; chunkY++)
     {
-        fprintf(stderr, "%s\n", SDL_GetError());
-        return -1;
+        for (int32_t chunkX = firstX; chunkX <= lastX; chunkX++)
+        {
+            MapChunk *chunk = mapFetchChunk(renderer, map, name, index, chunkX, chunkY);
+            if (NULL == chunk)
+            {
+                return -1;
+            }
+
+            SDL_Rect dst =
+            {
+                (int32_t)renderPosX + (chunkX * MAP_CHUNK_SIZE),
+                (int32_t)renderPosY + (chunkY * MAP_CHUNK_SIZE),
+                MAP_CHUNK_SIZE,
+                MAP_CHUNK_SIZE
+            };
+            if (-1 == SDL_RenderCopy(renderer, chunk->texture, NULL, &dst))
+            {
+                fprintf(stderr, "%s\n", SDL_GetError());
+                return -1;
+            }
+        }
     }
 
-    if (bg)
+    return 0;
+}
+
+/**
+ * @brief   Sweep a box through the tile grid.  The box is moved along the
+ *          y-axis first and then along the x-axis; per axis only the rows or
+ *          columns crossed by the leading edge are visited.  Solid tiles block
+ *          from all sides, floor tiles only block boxes falling onto them.
+ * @param   map     the map.
+ * @param   box     the bounding box before the movement.  See @ref struct AABB.
+ * @param   dx      requested displacement along the x-axis.
+ * @param   dy      requested displacement along the y-axis.
+ * @param   contact the resolved movement.  See @ref struct MapContact.
+ * @ingroup Map
+ */
+void mapSweep(Map *map, AABB box, double dx, double dy, MapContact *contact)
+{
+    const double eps   = 0.0001;
+    double       tw    = map->map->tile_width;
+    double       th    = map->map->tile_height;
+    uint16_t     solid = 1 << TILE_SOLID;
+
+    contact->dx      = dx;
+    contact->dy      = dy;
+    contact->timeX   = 1;
+    contact->timeY   = 1;
+    contact->normalX = 0;
+    contact->normalY = 0;
+
+    // Vertical sweep.
+    if (0 != dy)
     {
-        SDL_SetRenderDrawColor(
-            renderer,
-            (map->map->backgroundcolor >> 16) & 0xFF,
-            (map->map->backgroundcolor >>  8) & 0xFF,
-            (map->map->backgroundcolor)       & 0xFF,
-            255);
+        int32_t  colA = floor(box.l / tw);
+        int32_t  colB = floor((box.r - eps) / tw);
+        int32_t  row;
+        int32_t  rowEnd;
+        int8_t   step;
+        uint16_t mask;
+
+        if (dy > 0)
+        {
+            row    = ceil((box.b - eps) / th);
+            rowEnd = floor((box.b + dy) / th);
+            step   = 1;
+            mask   = solid | (1 << TILE_FLOOR);
+        }
+        else
+        {
+            row    = floor((box.t + eps) / th) - 1;
+            rowEnd = floor((box.t + dy) / th);
+            step   = -1;
+            mask   = solid;
+        }
+
+        for (; (step > 0) ? (row <= rowEnd) : (row >= rowEnd); row += step)
+        {
+            uint8_t blocked = 0;
+            for (int32_t col = colA; col <= colB; col++)
+            {
+                if (mapCellBlocks(map, col, row, mask))
+                {
+                    blocked = 1;
+                    break;
+                }
+            }
+
+            if (blocked)
+            {
+                if (step > 0)
+                {
+                    contact->dy = (row * th) - box.b;
+                }
+                else
+                {
+                    contact->dy = ((row + 1) * th) - box.t;
+                }
+                contact->timeY   = contact->dy / dy;
+                contact->normalY = -step;
+                break;
+            }
+        }
+
+        box.t += contact->dy;
+        box.b += contact->dy;
     }
 
-    tmx_layer *layers = map->map->ly_head;
-    while(layers)
+    // Horizontal sweep.
+    if (0 != dx)
     {
-        uint32_t    gid;
-        SDL_Rect    dst;
-        SDL_Rect    src;
-        tmx_tileset *ts;
+        int32_t rowA = floor(box.t / th);
+        int32_t rowB = floor((box.b - eps) / th);
+        int32_t col;
+        int32_t colEnd;
+        int8_t  step;
 
-        if ((layers->visible) && (NULL != strstr(layers->name, name)))
+        if (dx > 0)
         {
-            for (uint32_t ih = 0; ih < map->map->height; ih++)
+            col    = ceil((box.r - eps) / tw);
+            colEnd = floor((box.r + dx) / tw);
+            step   = 1;
+        }
+        else
+        {
+            col    = floor((box.l + eps) / tw) - 1;
+            colEnd = floor((box.l + dx) / tw);
+            step   = -1;
+        }
+
+        for (; (step > 0) ? (col <= colEnd) : (col >= colEnd); col += step)
+        {
+            uint8_t blocked = 0;
+            for (int32_t row = rowA; row <= rowB; row++)
             {
-                for (uint32_t iw = 0; iw < map->map->width; iw++)
+                if (mapCellBlocks(map, col, row, solid))
                 {
-                    gid = layers->content.gids[(ih * map->map->width) + iw] & TMX_FLIP_BITS_REMOVAL;
-                    if (NULL != map->map->tiles[gid])
-                    {
-                        ts    = map->map->tiles[gid]->tileset;
-                        src.x = map->map->tiles[gid]->ul_x;
-                        src.y = map->map->tiles[gid]->ul_y;
-                        src.w = dst.w = ts->tile_width;
-                        src.h = dst.h = ts->tile_height;
-                        dst.x = iw * ts->tile_width;
-                        dst.y = ih * ts->tile_height;
-                        SDL_RenderCopy(renderer, tileset, &src, &dst);
-                    }
+                    blocked = 1;
+                    break;
+                }
+            }
+
+            if (blocked)
+            {
+                if (step > 0)
+                {
+                    contact->dx = (col * tw) - box.r;
                 }
+                else
+                {
+                    contact->dx = ((col + 1) * tw) - box.l;
+                }
+                contact->timeX   = contact->dx / dx;
+                contact->normalX = -step;
+                break;
             }
         }
-        layers = layers->next;
     }
+}
 
-    // Switch back to default render target.
-    if (0 != SDL_SetRenderTarget(renderer, NULL))
+/**
+ * @brief   Look up an interned tile type.
+ * @param   map  the map.
+ * @param   type name of the tile type.
+ * @return  bit index of the type, -1 if no tile is of this type.
+ * @ingroup Map
+ */
+int8_t mapTypeIndex(Map *map, const char *type)
+{
+    for (uint8_t i = 0; i < map->numTypes; i++)
     {
-        fprintf(stderr, "%s\n", SDL_GetError());
-        return -1;
+        if (0 == strcmp(type, map->typeName[i]))
+        {
+            return i;
+        }
     }
 
-    if (0 != SDL_SetTextureBlendMode(map->texture[index], SDL_BLENDMODE_BLEND))
+    return -1;
+}
+
+/**
+ * @brief   Upload the images of a map that have been decoded on another
+ *          thread to the GPU.  Has to be called on the thread that set up
+ *          the loader context before the map is rendered.  See
+ *          mapInitShared().
+ * @param   images the owner of the images, as passed to mapInitContext()
+ *                 for the context the map was loaded with.
+ * @param   map    the map.
+ * @ingroup Map
+ */
+void mapUpload(MapImages *images, Map *map)
+{
+    for (tmx_tileset_list *list = map->map->ts_head; list; list = list->next)
     {
-        fprintf(stderr, "%s\n", SDL_GetError());
-        return -1;
-    }
+        tmx_tileset *tileset = list->tileset;
 
-    return 0;
+        mapUploadImage(images, tileset->image);
+        for (uint32_t i = 0; i < tileset->tilecount; i++)
+        {
+            mapUploadImage(images, tileset->tiles[i].image);
+        }
+    }
+    mapUploadLayers(images, map->map->ly_head);
 }
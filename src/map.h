@@ -7,31 +7,184 @@
 
 #include <SDL2/SDL.h>
 #include <stdint.h>
+#include "aabb.h"
 #include "tmx/tmx.h"
+#include "tmx/tsx.h"
 
 /**
  * @def     MAX_TEXTURES_PER_MAP
- *          The maximum number of textures (layers) per map.
+ *          The maximum number of texture indices (layer groups) per map.
  * @ingroup Map
  */
 #define MAX_TEXTURES_PER_MAP 5
 
+/**
+ * @def     MAP_CHUNK_SIZE
+ *          Width and height of a cached map chunk in pixels.
+ * @ingroup Map
+ */
+#define MAP_CHUNK_SIZE 256
+
+/**
+ * @def     MAP_MAX_THREADS
+ *          Maximum number of threads decoding the tile layers of a map.
+ * @ingroup Map
+ */
+#define MAP_MAX_THREADS 8
+
+/**
+ * @def     MAP_CHUNK_BUDGET
+ *          The number of chunk textures kept before the least recently used
+ *          one is recycled.  The cache only grows beyond this budget if more
+ *          chunks are visible at once.
+ * @ingroup Map
+ */
+#define MAP_CHUNK_BUDGET 48
+
+/**
+ * @def     MAX_TILE_TYPES
+ *          The maximum number of distinct tile types per map.  Each type is
+ *          interned as one bit of a cell's attribute mask.
+ * @ingroup Map
+ */
+#define MAX_TILE_TYPES 16
+
+/**
+ * @def     MAX_TILE_PROPS
+ *          The maximum number of distinct numeric tile properties per map.
+ * @ingroup Map
+ */
+#define MAX_TILE_PROPS 8
+
+// Tile types with a fixed bit in the attribute mask.
+#define TILE_FLOOR   0
+#define TILE_SOLID   1
+#define TILE_HAZARD  2
+
+/**
+ * @brief   Owner of the images loaded with a TMX loader context.  Set up by
+ *          mapInitContext() and reached by the TMX hooks through the
+ *          context's userdata.  Textures are only created on the thread
+ *          that set it up; images loaded on any other thread are decoded
+ *          and wait in the pending list for mapUpload().
+ * @ingroup Map
+ */
+typedef struct mapImages_t
+{
+    SDL_Renderer      *renderer;
+    SDL_threadID      thread;
+    struct mapImage_t *pending;
+    SDL_SpinLock      lock;
+} MapImages;
+
+/**
+ * @ingroup Map
+ */
+typedef struct mapAnimList_t
+{
+    uint32_t count;
+    uint32_t *cell;
+    uint16_t *frame;
+} MapAnimList;
+
+/**
+ * @ingroup Map
+ */
+typedef struct mapChunk_t
+{
+    SDL_Texture *texture;
+    int32_t     slot;
+    uint32_t    lastUsed;
+    uint8_t     index;
+} MapChunk;
+
+/**
+ * @ingroup Map
+ */
+typedef struct mapContact_t
+{
+    /* Displacement the box can travel before it touches a tile, time of
+     * impact as fraction of the requested displacement (1 if there is none)
+     * and the contact normal per axis. */
+    double dx;
+    double dy;
+    double timeX;
+    double timeY;
+    int8_t normalX;
+    int8_t normalY;
+} MapContact;
+
 /**
  * @ingroup Map
  */
 typedef struct map_t
 {
     tmx_map     *map;
-    SDL_Texture *texture[MAX_TEXTURES_PER_MAP];
+    /* Loader context of the map and the owner of its images: the TMX hooks
+     * are set here instead of the library's globals, so several maps may be
+     * loaded at once.  Unused by maps loaded with mapInitShared(), which use
+     * the context of their tileset manager. */
+    tmx_ctx     ctx;
+    MapImages   images;
+    /* Chunk cache.  chunkSlot[index] maps a chunk coordinate to its entry in
+     * chunk, or -1 if the chunk has not been baked yet. */
+    MapChunk    *chunk;
+    int32_t     *chunkSlot[MAX_TEXTURES_PER_MAP];
+    uint32_t    chunkCountX;
+    uint32_t    chunkCountY;
+    uint32_t    chunkTick;
+    uint32_t    numChunks;
+    const char  *layerName[MAX_TEXTURES_PER_MAP];
+    /* Animated tiles.  Every tile layer keeps a list of its animated cells in
+     * its user data.  See @ref struct MapAnimList.  animFrame holds the
+     * current frame of every entry in animGid and animSlot maps a gid to its
+     * entry, or -1 if the tile is not animated. */
+    uint32_t    *animGid;
+    uint16_t    *animFrame;
+    int32_t     *animSlot;
+    double      animTime;
+    uint32_t    numAnimGids;
+    /* Cells to re-bake in the current frame and the texture indices of each,
+     * so a cell shown by several layers is only re-baked once. */
+    uint32_t    *animDirtyCell;
+    uint8_t     *animDirty;
+    /* How far a tile may reach beyond its cell to the right, top and bottom
+     * in pixels, e.g. tiles of an image collection larger than the grid. */
+    uint32_t    reachRight;
+    uint32_t    reachUp;
+    uint32_t    reachDown;
     uint32_t    height;
     uint32_t    width;
     double      worldPosX;
     double      worldPosY;
+    /* Tile attributes compiled once by mapInit().  Every cell holds the types
+     * of all its layers as bit mask and the row of its numeric properties. */
+    uint16_t    *cellFlags;
+    uint16_t    *cellProps;
+    double      *propTable;
+    uint16_t    numPropRows;
+    uint8_t     numProps;
+    uint8_t     numTypes;
+    const char  *propName[MAX_TILE_PROPS];
+    const char  *typeName[MAX_TILE_TYPES];
+    /* Tile layers are stored compact by the TMX loader and read a row at a
+     * time into this buffer.  See tmx_compact_layers. */
+    int32_t     *rowGids;
 } Map;
 
-uint8_t mapCoordIsType(Map *map, const char *type, double xPos, double yPos);
-void    mapFree(Map *map);
-Map     *mapInit(const char *filename);
-int8_t  mapRender(SDL_Renderer *renderer, Map *map, const char *name, uint8_t bg, uint8_t index, double cameraPosX, double cameraPosY);
+uint8_t  mapCoordHasType(Map *map, uint8_t type, double xPos, double yPos);
+uint16_t mapCoordFlags(Map *map, double xPos, double yPos);
+uint8_t  mapCoordIsType(Map *map, const char *type, double xPos, double yPos);
+double   mapCoordProperty(Map *map, int8_t prop, double xPos, double yPos);
+int8_t   mapFrame(SDL_Renderer *renderer, Map *map, double dTime);
+void     mapFree(Map *map);
+Map      *mapInit(SDL_Renderer *renderer, const char *filename);
+void     mapInitContext(tmx_ctx *ctx, MapImages *images, SDL_Renderer *renderer);
+Map      *mapInitShared(tmx_tileset_manager *tilesets, const char *filename);
+int8_t   mapPropertyIndex(Map *map, const char *name);
+int8_t   mapRender(SDL_Renderer *renderer, Map *map, const char *name, uint8_t bg, uint8_t index, double cameraPosX, double cameraPosY);
+void     mapSweep(Map *map, AABB box, double dx, double dy, MapContact *contact);
+int8_t   mapTypeIndex(Map *map, const char *type);
+void     mapUpload(MapImages *images, Map *map);
 
 #endif
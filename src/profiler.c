@@ -0,0 +1,261 @@
+/** @file profiler.c
+ * @ingroup   Profiler
+ * @defgroup  Profiler
+ * @brief     Per-stage frame profiler.  The time spent in every stage of a
+ *            frame is kept for the most recent frames; the 50th, 95th and
+ *            99th percentile per stage are printed when the profiler is
+ *            freed.  Optionally, every frame is written to a CSV file.
+ *
+ *            All functions accept NULL and return immediately, so a disabled
+ *            profiler costs one comparison per stage.  If a trace is running,
+ *            every stage is added to it as well.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "profiler.h"
+#include "trace.h"
+
+static const char *profilerStageName[NUM_PROFILER_STAGES] =
+{
+    "input",
+    "simulation",
+    "  physics",
+    "  collision",
+    "  broadphase",
+    "  logic",
+    "camera",
+    "mapFrame",
+    "background0",
+    "background1",
+    "background2",
+    "background3",
+    "mapBackground",
+    "mapWorld",
+    "entityRender",
+    "mapOverlay",
+    "hud",
+    "present",
+    "total"
+};
+
+/**
+ * @brief   Compare two samples.  Used by qsort().
+ * @ingroup Profiler
+ */
+static int profilerCompare(const void *a, const void *b)
+{
+    float x = *(const float*)a;
+    float y = *(const float*)b;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief   Add time to a stage of the current frame.  Used for stages which
+ *          are measured elsewhere, e.g. the simulation subsystems.
+ * @param   profiler the profiler.  See @ref struct Profiler.  May be NULL.
+ * @param   stage    the stage.  See PROFILER_INPUT etc.
+ * @param   seconds  the time to add.
+ * @ingroup Profiler
+ */
+void profilerAdd(Profiler *profiler, uint8_t stage, double seconds)
+{
+    if (NULL == profiler)
+    {
+        return;
+    }
+
+    profiler->current[stage] += seconds * 1000;
+}
+
+/**
+ * @brief   Begin a new frame.
+ * @param   profiler the profiler.  See @ref struct Profiler.  May be NULL.
+ * @ingroup Profiler
+ */
+void profilerBegin(Profiler *profiler)
+{
+    if (NULL == profiler)
+    {
+        return;
+    }
+
+    for (uint8_t i = 0; i < NUM_PROFILER_STAGES; i++)
+    {
+        profiler->current[i] = 0;
+    }
+
+    profiler->frameStart = SDL_GetPerformanceCounter();
+    profiler->mark       = profiler->frameStart;
+}
+
+/**
+ * @brief   End the current frame and store its samples.  If the ring buffer
+ *          is full, the oldest frame is overwritten.
+ * @param   profiler the profiler.  See @ref struct Profiler.  May be NULL.
+ * @ingroup Profiler
+ */
+void profilerEnd(Profiler *profiler)
+{
+    if (NULL == profiler)
+    {
+        return;
+    }
+
+    float    *sample = &profiler->sample[profiler->head * NUM_PROFILER_STAGES];
+    uint64_t now     = SDL_GetPerformanceCounter();
+
+    profiler->current[PROFILER_FRAME] = (now - profiler->frameStart) / profiler->frequency * 1000;
+    traceComplete("frame", profiler->frameStart, now);
+    for (uint8_t i = 0; i < NUM_PROFILER_STAGES; i++)
+    {
+        sample[i] = profiler->current[i];
+    }
+
+    profiler->head = (profiler->head + 1) & (profiler->capacity - 1);
+    if (profiler->count < profiler->capacity)
+    {
+        profiler->count++;
+    }
+
+    if (profiler->csv)
+    {
+        fprintf(profiler->csv, "%lu", (unsigned long)profiler->numFrames);
+        for (uint8_t i = 0; i < NUM_PROFILER_STAGES; i++)
+        {
+            fprintf(profiler->csv, ",%.4f", sample[i]);
+        }
+        fputc('\n', profiler->csv);
+    }
+    profiler->numFrames++;
+}
+
+/**
+ * @brief   Print the percentiles per stage and free profiler.
+ * @param   profiler the profiler.  See @ref struct Profiler.  May be NULL.
+ * @ingroup Profiler
+ */
+void profilerFree(Profiler *profiler)
+{
+    if (NULL == profiler)
+    {
+        return;
+    }
+
+    float *column = malloc(profiler->count * sizeof(float));
+    if (column && profiler->count)
+    {
+        printf("%-14s %9s %9s %9s  (ms, last %u frames)\n", "stage", "p50", "p95", "p99", profiler->count);
+        for (uint8_t i = 0; i < NUM_PROFILER_STAGES; i++)
+        {
+            for (uint32_t j = 0; j < profiler->count; j++)
+            {
+                column[j] = profiler->sample[j * NUM_PROFILER_STAGES + i];
+            }
+            qsort(column, profiler->count, sizeof(float), profilerCompare);
+
+            printf("%-14s %9.3f %9.3f %9.3f\n",
+                   profilerStageName[i],
+                   column[(profiler->count - 1) * 50 / 100],
+                   column[(profiler->count - 1) * 95 / 100],
+                   column[(profiler->count - 1) * 99 / 100]);
+        }
+    }
+    free(column);
+
+    if (profiler->csv)
+    {
+        fclose(profiler->csv);
+    }
+
+    free(profiler->sample);
+    free(profiler);
+}
+
+/**
+ * @brief   Initialise profiler.
+ * @param   capacity    number of frames to keep.  Rounded up to the next
+ *                      power of two.
+ * @param   csvFilename file to write every frame to.  May be NULL.
+ * @return  Profiler on success, NULL on error.  See @ref struct Profiler.
+ * @ingroup Profiler
+ */
+Profiler *profilerInit(uint32_t capacity, const char *csvFilename)
+{
+    Profiler *profiler = malloc(sizeof(struct profiler_t));
+    if (NULL == profiler)
+    {
+        fprintf(stderr, "profilerInit(): error allocating memory.\n");
+        return NULL;
+    }
+
+    profiler->capacity = 1;
+    while ((profiler->capacity < capacity) && (profiler->capacity < (1u << 20)))
+    {
+        profiler->capacity <<= 1;
+    }
+
+    profiler->frequency  = SDL_GetPerformanceFrequency();
+    profiler->frameStart = 0;
+    profiler->mark       = 0;
+    profiler->head       = 0;
+    profiler->count      = 0;
+    profiler->numFrames  = 0;
+    profiler->csv        = NULL;
+    profiler->sample     = malloc(profiler->capacity * NUM_PROFILER_STAGES * sizeof(float));
+    if (NULL == profiler->sample)
+    {
+        fprintf(stderr, "profilerInit(): error allocating memory.\n");
+        free(profiler);
+        return NULL;
+    }
+
+    if (csvFilename)
+    {
+        profiler->csv = fopen(csvFilename, "w");
+        if (NULL == profiler->csv)
+        {
+            fprintf(stderr, "profilerInit(): error opening %s.\n", csvFilename);
+            profilerFree(profiler);
+            return NULL;
+        }
+
+        fprintf(profiler->csv, "index");
+        for (uint8_t i = 0; i < NUM_PROFILER_STAGES; i++)
+        {
+            const char *name = profilerStageName[i];
+            while (' ' == *name)
+            {
+                name++;
+            }
+            fprintf(profiler->csv, ",%s", name);
+        }
+        fputc('\n', profiler->csv);
+    }
+
+    return profiler;
+}
+
+/**
+ * @brief   Assign the time since the previous mark to a stage.  Call once
+ *          after every stage of the frame.
+ * @param   profiler the profiler.  See @ref struct Profiler.  May be NULL.
+ * @param   stage    the stage that just finished.  See PROFILER_INPUT etc.
+ * @ingroup Profiler
+ */
+void profilerMark(Profiler *profiler, uint8_t stage)
+{
+    if (NULL == profiler)
+    {
+        return;
+    }
+
+    uint64_t now               = SDL_GetPerformanceCounter();
+    profiler->current[stage]  += (now - profiler->mark) / profiler->frequency * 1000;
+    traceComplete(profilerStageName[stage], profiler->mark, now);
+    profiler->mark             = now;
+}
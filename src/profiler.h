@@ -0,0 +1,59 @@
+/** @file profiler.h
+ * @ingroup Profiler
+ */
+
+#ifndef PROFILER_h
+#define PROFILER_h
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Frame stages.
+#define PROFILER_INPUT            0
+#define PROFILER_SIMULATION       1
+#define PROFILER_PHYSICS          2
+#define PROFILER_COLLISION        3
+#define PROFILER_BROADPHASE       4
+#define PROFILER_LOGIC            5
+#define PROFILER_CAMERA           6
+#define PROFILER_MAP_FRAME        7
+#define PROFILER_BACKGROUND_0     8
+#define PROFILER_BACKGROUND_1     9
+#define PROFILER_BACKGROUND_2    10
+#define PROFILER_BACKGROUND_3    11
+#define PROFILER_MAP_BACKGROUND  12
+#define PROFILER_MAP_WORLD       13
+#define PROFILER_ENTITY_RENDER   14
+#define PROFILER_MAP_OVERLAY     15
+#define PROFILER_HUD             16
+#define PROFILER_PRESENT         17
+#define PROFILER_FRAME           18
+#define NUM_PROFILER_STAGES      19
+
+/**
+ * @ingroup Profiler
+ */
+typedef struct profiler_t
+{
+    double   frequency;
+    uint64_t frameStart;
+    uint64_t mark;
+    float    current[NUM_PROFILER_STAGES];
+    /* Ring buffer of the most recent frames, NUM_PROFILER_STAGES samples in
+     * milliseconds per frame.  capacity is a power of two. */
+    float    *sample;
+    uint32_t capacity;
+    uint32_t head;
+    uint32_t count;
+    uint64_t numFrames;
+    FILE     *csv;
+} Profiler;
+
+void     profilerAdd(Profiler *profiler, uint8_t stage, double seconds);
+void     profilerBegin(Profiler *profiler);
+void     profilerEnd(Profiler *profiler);
+void     profilerFree(Profiler *profiler);
+Profiler *profilerInit(uint32_t capacity, const char *csvFilename);
+void     profilerMark(Profiler *profiler, uint8_t stage);
+
+#endif
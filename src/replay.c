@@ -0,0 +1,306 @@
+/** @file replay.c
+ * @ingroup   Replay
+ * @defgroup  Replay
+ * @brief     Record the player input per tick and play it back.  Together
+ *            with the fixed time step this reproduces a game exactly, which
+ *            is used to compare the performance of different builds on
+ *            identical gameplay.
+ *
+ *            File layout, all values little-endian:
+ *            - "RJRP" magic and 16-bit format version
+ *            - 32-bit seed, 16-bit tick rate, 32-bit entity count
+ *            - 32-bit number of recorded ticks
+ *            - one input byte per tick, followed by the 64-bit state hash
+ *              after every REPLAY_HASH_INTERVAL ticks
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "replay.h"
+
+// Offset of the tick count in the file header.
+#define REPLAY_TICKS_OFFSET 16
+
+/**
+ * @brief   Read a little-endian unsigned integer.
+ * @param   file  the file to read from.
+ * @param   value the value read.
+ * @param   size  size of the value in bytes.
+ * @return  0 on success, -1 on error.
+ * @ingroup Replay
+ */
+static int8_t replayRead(FILE *file, uint64_t *value, uint8_t size)
+{
+    uint8_t byte[8];
+
+    if (size != fread(byte, 1, size, file))
+    {
+        return -1;
+    }
+
+    *value = 0;
+    for (uint8_t i = 0; i < size; i++)
+    {
+        *value |= (uint64_t)byte[i] << (8 * i);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Write a little-endian unsigned integer.
+ * @param   file  the file to write to.
+ * @param   value the value to write.
+ * @param   size  size of the value in bytes.
+ * @return  0 on success, -1 on error.
+ * @ingroup Replay
+ */
+static int8_t replayWrite(FILE *file, uint64_t value, uint8_t size)
+{
+    uint8_t byte[8];
+
+    for (uint8_t i = 0; i < size; i++)
+    {
+        byte[i] = (value >> (8 * i)) & 0xff;
+    }
+
+    if (size != fwrite(byte, 1, size, file))
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Close replay file.  A recording is finalised by writing the
+ *          number of recorded ticks into the header.
+ * @param   replay the replay.  See @ref struct Replay.
+ * @ingroup Replay
+ */
+void replayFree(Replay *replay)
+{
+    if (NULL == replay)
+    {
+        return;
+    }
+
+    if (REPLAY_RECORD == replay->mode)
+    {
+        if ((0 != fseek(replay->file, REPLAY_TICKS_OFFSET, SEEK_SET)) ||
+            (-1 == replayWrite(replay->file, replay->tick, 4)))
+        {
+            fprintf(stderr, "replayFree(): error finalising recording.\n");
+        }
+    }
+    else if (replay->diverged)
+    {
+        fprintf(stderr, "Replay diverged between tick %u and %u.\n",
+                replay->tick - REPLAY_HASH_INTERVAL, replay->tick);
+    }
+
+    fclose(replay->file);
+    free(replay);
+}
+
+/**
+ * @brief   Get the input for the next tick.  When recording, the input is
+ *          written to the file and returned unchanged.  When playing, the
+ *          recorded input is returned instead.
+ * @param   replay the replay.  See @ref struct Replay.  May be NULL, in
+ *                 which case the input is returned unchanged.
+ * @param   input  the input polled from the keyboard.  See INPUT_LEFT etc.
+ * @return  The input to pass to gameTick().
+ * @ingroup Replay
+ */
+uint16_t replayInput(Replay *replay, uint16_t input)
+{
+    uint64_t value;
+
+    if ((NULL == replay) || replay->finished)
+    {
+        return input;
+    }
+
+    if (REPLAY_RECORD == replay->mode)
+    {
+        if (-1 == replayWrite(replay->file, input, 1))
+        {
+            fprintf(stderr, "replayInput(): error writing tick %u.\n", replay->tick);
+            replay->finished = 1;
+        }
+        return input;
+    }
+
+    if ((replay->tick == replay->numTicks) || (-1 == replayRead(replay->file, &value, 1)))
+    {
+        replay->finished = 1;
+        return 0;
+    }
+
+    return value;
+}
+
+/**
+ * @brief   Open a recording for playback.
+ * @param   filename the file to play.
+ * @return  Replay on success, NULL on error.  See @ref struct Replay.
+ * @ingroup Replay
+ */
+Replay *replayOpen(const char *filename)
+{
+    char     magic[4];
+    uint64_t version;
+    uint64_t seed;
+    uint64_t tickRate;
+    uint64_t numEntities;
+    uint64_t numTicks;
+
+    Replay *replay = malloc(sizeof(struct replay_t));
+    if (NULL == replay)
+    {
+        fprintf(stderr, "replayOpen(): error allocating memory.\n");
+        return NULL;
+    }
+
+    replay->file = fopen(filename, "rb");
+    if (NULL == replay->file)
+    {
+        fprintf(stderr, "replayOpen(): error opening %s.\n", filename);
+        free(replay);
+        return NULL;
+    }
+
+    if ((4 != fread(magic, 1, 4, replay->file)) ||
+        (0 != memcmp(magic, "RJRP", 4)) ||
+        (-1 == replayRead(replay->file, &version, 2)) ||
+        (-1 == replayRead(replay->file, &seed, 4)) ||
+        (-1 == replayRead(replay->file, &tickRate, 2)) ||
+        (-1 == replayRead(replay->file, &numEntities, 4)) ||
+        (-1 == replayRead(replay->file, &numTicks, 4)))
+    {
+        fprintf(stderr, "replayOpen(): %s is not a recording.\n", filename);
+        fclose(replay->file);
+        free(replay);
+        return NULL;
+    }
+
+    if (REPLAY_VERSION != version)
+    {
+        fprintf(stderr, "replayOpen(): %s has version %u, expected %u.\n",
+                filename, (uint32_t)version, REPLAY_VERSION);
+        fclose(replay->file);
+        free(replay);
+        return NULL;
+    }
+
+    replay->mode        = REPLAY_PLAY;
+    replay->seed        = seed;
+    replay->tickRate    = tickRate;
+    replay->numEntities = numEntities;
+    replay->numTicks    = numTicks;
+    replay->tick        = 0;
+    replay->finished    = 0;
+    replay->diverged    = 0;
+
+    return replay;
+}
+
+/**
+ * @brief   Create a new recording.
+ * @param   filename    the file to record to.
+ * @param   seed        the seed the game has been started with.
+ * @param   tickRate    simulation steps per second.
+ * @param   numEntities the number of entities.
+ * @return  Replay on success, NULL on error.  See @ref struct Replay.
+ * @ingroup Replay
+ */
+Replay *replayRecord(const char *filename, uint32_t seed, uint16_t tickRate, uint32_t numEntities)
+{
+    Replay *replay = malloc(sizeof(struct replay_t));
+    if (NULL == replay)
+    {
+        fprintf(stderr, "replayRecord(): error allocating memory.\n");
+        return NULL;
+    }
+
+    replay->file = fopen(filename, "wb");
+    if (NULL == replay->file)
+    {
+        fprintf(stderr, "replayRecord(): error opening %s.\n", filename);
+        free(replay);
+        return NULL;
+    }
+
+    // The tick count is written when the recording is closed.
+    if ((4 != fwrite("RJRP", 1, 4, replay->file)) ||
+        (-1 == replayWrite(replay->file, REPLAY_VERSION, 2)) ||
+        (-1 == replayWrite(replay->file, seed, 4)) ||
+        (-1 == replayWrite(replay->file, tickRate, 2)) ||
+        (-1 == replayWrite(replay->file, numEntities, 4)) ||
+        (-1 == replayWrite(replay->file, 0, 4)))
+    {
+        fprintf(stderr, "replayRecord(): error writing %s.\n", filename);
+        fclose(replay->file);
+        free(replay);
+        return NULL;
+    }
+
+    replay->mode        = REPLAY_RECORD;
+    replay->seed        = seed;
+    replay->tickRate    = tickRate;
+    replay->numEntities = numEntities;
+    replay->numTicks    = 0;
+    replay->tick        = 0;
+    replay->finished    = 0;
+    replay->diverged    = 0;
+
+    return replay;
+}
+
+/**
+ * @brief   Finish a tick.  Every REPLAY_HASH_INTERVAL ticks the state hash is
+ *          written when recording, or compared against the recorded one when
+ *          playing.
+ * @param   replay the replay.  See @ref struct Replay.  May be NULL.
+ * @param   game   the game after the tick.  See @ref struct Game.
+ * @return  0 on success, -1 if the game diverged from the recording.
+ * @ingroup Replay
+ */
+int8_t replayVerify(Replay *replay, Game *game)
+{
+    uint64_t hash;
+
+    if ((NULL == replay) || replay->finished)
+    {
+        return 0;
+    }
+
+    replay->tick++;
+    if (0 != replay->tick % REPLAY_HASH_INTERVAL)
+    {
+        return 0;
+    }
+
+    if (REPLAY_RECORD == replay->mode)
+    {
+        if (-1 == replayWrite(replay->file, gameChecksum(game), 8))
+        {
+            fprintf(stderr, "replayVerify(): error writing tick %u.\n", replay->tick);
+            replay->finished = 1;
+        }
+        return 0;
+    }
+
+    if ((-1 == replayRead(replay->file, &hash, 8)) || (hash != gameChecksum(game)))
+    {
+        replay->diverged = 1;
+        replay->finished = 1;
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,55 @@
+/** @file replay.h
+ * @ingroup Replay
+ */
+
+#ifndef REPLAY_h
+#define REPLAY_h
+
+#include <stdint.h>
+#include <stdio.h>
+#include "game.h"
+
+/**
+ * @def     REPLAY_VERSION
+ *          File format version.  Increase whenever the simulation changes in
+ *          a way that invalidates old recordings.
+ * @ingroup Replay
+ */
+#define REPLAY_VERSION 1
+
+/**
+ * @def     REPLAY_HASH_INTERVAL
+ *          Number of ticks between two recorded state hashes.
+ * @ingroup Replay
+ */
+#define REPLAY_HASH_INTERVAL 60
+
+// Replay modes.
+#define REPLAY_RECORD  0
+#define REPLAY_PLAY    1
+
+/**
+ * @ingroup Replay
+ */
+typedef struct replay_t
+{
+    FILE     *file;
+    uint8_t  mode;
+    uint32_t seed;
+    uint16_t tickRate;
+    uint32_t numEntities;
+    uint32_t numTicks;
+    uint32_t tick;
+    /* Set once all recorded ticks have been played or the state no longer
+     * matches the recording. */
+    uint8_t  finished;
+    uint8_t  diverged;
+} Replay;
+
+void     replayFree(Replay *replay);
+uint16_t replayInput(Replay *replay, uint16_t input);
+Replay   *replayOpen(const char *filename);
+Replay   *replayRecord(const char *filename, uint32_t seed, uint16_t tickRate, uint32_t numEntities);
+int8_t   replayVerify(Replay *replay, Game *game);
+
+#endif
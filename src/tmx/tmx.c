@@ -14,53 +14,110 @@
 
 void* (*tmx_alloc_func) (void *address, size_t len) = NULL;
 void  (*tmx_free_func ) (void *address) = NULL;
+int tmx_arena_mode = 0;
+int tmx_lazy_layers = 0;
+int tmx_compact_layers = 0;
+void (*tmx_parallel_func) (void (*job)(int index, void *arg), int count, void *arg) = NULL;
 void* (*tmx_img_load_func) (const char *p) = NULL;
 void  (*tmx_img_free_func) (void *address) = NULL;
+void  (*tmx_trace_func) (const char *name, int begin) = NULL;
+const char* (*tmx_file_read_func) (const char *path, int *len) = NULL;
 
 /*
 	Public functions
 */
 
 tmx_map* tmx_load(const char *path) {
+	return tmx_ctx_load(NULL, path);
+}
+
+tmx_map* tmx_load_buffer(const char *buffer, int len) {
+	return tmx_ctx_load_buffer(NULL, buffer, len);
+}
+
+tmx_map* tmx_load_fd(int fd) {
+	return tmx_ctx_load_fd(NULL, fd);
+}
+
+tmx_map* tmx_load_callback(tmx_read_functor callback, void *userdata) {
+	return tmx_ctx_load_callback(NULL, callback, userdata);
+}
+
+tmx_map* tmx_ctx_load(tmx_ctx *ctx, const char *path) {
 	tmx_map *map = NULL;
-	set_alloc_functions();
+	tmx_ctx *prev;
+	void *arena;
+	prev = ctx_enter(ctx);
+	TMX_TRACE("tmx_load", 1);
+	arena = arena_begin();
 	map = parse_xml(NULL, path);
 	map_post_parsing(&map);
+	arena_end(arena, map);
+	if (map) map->ctx = ctx;
+	TMX_TRACE("tmx_load", 0);
+	ctx_leave(prev, map != NULL);
 	return map;
 }
 
-tmx_map* tmx_load_buffer(const char *buffer, int len) {
+tmx_map* tmx_ctx_load_buffer(tmx_ctx *ctx, const char *buffer, int len) {
 	tmx_map *map = NULL;
-	set_alloc_functions();
+	tmx_ctx *prev;
+	void *arena;
+	prev = ctx_enter(ctx);
+	arena = arena_begin();
 	map = parse_xml_buffer(NULL, buffer, len);
 	map_post_parsing(&map);
+	arena_end(arena, map);
+	if (map) map->ctx = ctx;
+	ctx_leave(prev, map != NULL);
 	return map;
 }
 
-tmx_map* tmx_load_fd(int fd) {
+tmx_map* tmx_ctx_load_fd(tmx_ctx *ctx, int fd) {
 	tmx_map *map = NULL;
-	set_alloc_functions();
+	tmx_ctx *prev;
+	void *arena;
+	prev = ctx_enter(ctx);
+	arena = arena_begin();
 	map = parse_xml_fd(NULL, fd);
 	map_post_parsing(&map);
+	arena_end(arena, map);
+	if (map) map->ctx = ctx;
+	ctx_leave(prev, map != NULL);
 	return map;
 }
 
-tmx_map* tmx_load_callback(tmx_read_functor callback, void *userdata) {
+tmx_map* tmx_ctx_load_callback(tmx_ctx *ctx, tmx_read_functor callback, void *userdata) {
 	tmx_map *map = NULL;
-	set_alloc_functions();
+	tmx_ctx *prev;
+	void *arena;
+	prev = ctx_enter(ctx);
+	arena = arena_begin();
 	map = parse_xml_callback(NULL, callback, userdata);
 	map_post_parsing(&map);
+	arena_end(arena, map);
+	if (map) map->ctx = ctx;
+	ctx_leave(prev, map != NULL);
 	return map;
 }
 
 void tmx_map_free(tmx_map *map) {
-	if (map) {
+	tmx_ctx *prev;
+
+	if (!map) return;
+
+	prev = ctx_enter(map->ctx);
+	if (map->arena) {
+		arena_free_map(map);
+	}
+	else {
 		free_ts_list(map->ts_head);
 		free_props(map->properties);
 		free_layers(map->ly_head);
-		tmx_free_func(map->tiles);
-		tmx_free_func(map);
+		ctx_current->free_func(map->tiles);
+		ctx_current->free_func(map);
 	}
+	ctx_leave(prev, 1);
 }
 
 tmx_tile* tmx_get_tile(tmx_map *map, unsigned int gid) {
@@ -76,6 +133,70 @@ tmx_tile* tmx_get_tile(tmx_map *map, unsigned int gid) {
 	return NULL;
 }
 
+/* Checks the arguments of the layer accessors, decodes lazy layers */
+static int layer_resolve(tmx_map *map, tmx_layer *layer, const char *func) {
+	tmx_ctx *prev;
+	void *arena;
+	int ret;
+
+	if (!map || !layer) {
+		tmx_err(E_INVAL, "%s: invalid argument: map or layer is NULL", func);
+		return 0;
+	}
+	if (layer->type != L_LAYER) {
+		tmx_err(E_INVAL, "%s: invalid argument: layer is not a tile layer", func);
+		return 0;
+	}
+
+	if (layer->encoded) {
+		/* the gids belong to the map's arena like the rest of the layer */
+		prev = ctx_enter(map->ctx);
+		arena = arena_resume(map);
+		TMX_TRACE("data_resolve", 1);
+		ret = data_resolve(layer, map->width, map->height);
+		TMX_TRACE("data_resolve", 0);
+		arena_end(arena, map);
+		ctx_leave(prev, ret);
+		if (!ret) return 0;
+	}
+	if (!layer->compact && !layer->content.gids) {
+		tmx_err(E_MISSEL, "%s: the layer has no data", func);
+		return 0;
+	}
+
+	return 1;
+}
+
+int32_t* tmx_get_layer_gids(tmx_map *map, tmx_layer *layer) {
+	if (!layer_resolve(map, layer, "tmx_get_layer_gids")) return NULL;
+	if (layer->compact) {
+		tmx_err(E_INVAL, "tmx_get_layer_gids: the layer is compact, see tmx_get_layer_row");
+		return NULL;
+	}
+	return layer->content.gids;
+}
+
+int32_t tmx_get_layer_gid(tmx_map *map, tmx_layer *layer, unsigned int x, unsigned int y) {
+	if (!layer_resolve(map, layer, "tmx_get_layer_gid")) return 0;
+	if (x >= map->width || y >= map->height) {
+		tmx_err(E_INVAL, "tmx_get_layer_gid: invalid argument: cell %u,%u is out of the map", x, y);
+		return 0;
+	}
+	if (layer->compact) return gids_get(layer->compact, x, y);
+	return layer->content.gids[y * map->width + x];
+}
+
+int tmx_get_layer_row(tmx_map *map, tmx_layer *layer, unsigned int x, unsigned int y, unsigned int count, int32_t *gids) {
+	if (!layer_resolve(map, layer, "tmx_get_layer_row")) return 0;
+	if (!gids || y >= map->height || x > map->width || count > map->width - x) {
+		tmx_err(E_INVAL, "tmx_get_layer_row: invalid argument: row %u, columns %u to %u", y, x, x + count);
+		return 0;
+	}
+	if (layer->compact) gids_row(layer->compact, x, y, count, gids);
+	else memcpy(gids, layer->content.gids + (size_t)y * map->width + x, count * sizeof(int32_t));
+	return 1;
+}
+
 tmx_property* tmx_get_property(tmx_properties *hash, const char *key) {
 	if (hash == NULL) {
 		return NULL;
@@ -20,6 +20,17 @@
 #define TMXEXPORT
 #endif
 
+/* errors are per thread, see tmx_parallel_func */
+#ifndef TMXTLS
+#if defined(_MSC_VER)
+#define TMXTLS __declspec(thread)
+#elif defined(__GNUC__)
+#define TMXTLS __thread
+#else
+#define TMXTLS
+#endif
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -31,17 +42,50 @@ extern "C" {
 
 /*
 	Configuration
+	used by the functions that don't take a loader context (see tmx_ctx)
 */
 /* Custom realloc and free function, for memalloc debugging purposes
    Please modify these values once before you use tmx_load */
 TMXEXPORT extern void* (*tmx_alloc_func) (void *address, size_t len); /* realloc */
 TMXEXPORT extern void  (*tmx_free_func ) (void *address);             /* free */
 
+/* if set to non-zero, each map is allocated from bump arenas that it owns,
+   and tmx_map_free releases the map at once instead of freeing every node,
+   the arenas use tmx_alloc_func and tmx_free_func, the tilesets a map loads
+   into a tileset manager are allocated outside of its arena */
+TMXEXPORT extern int tmx_arena_mode;
+
+/* if set to non-zero, the loader only keeps the encoded data of each tile
+   layer, the layer is decoded the first time tmx_get_layer_gids is called
+   on it and layer->content.gids stays NULL until then */
+TMXEXPORT extern int tmx_lazy_layers;
+
+/* if set to non-zero, each tile layer is stored as 16-bit gids, an 8-bit
+   palette or runs of equal gids once decoded, whichever is the smallest,
+   layer->content.gids is then NULL and the layer is read with
+   tmx_get_layer_gid and tmx_get_layer_row */
+TMXEXPORT extern int tmx_compact_layers;
+
+/* if set, the XML pass only collects the data of the tile layers, they are
+   then decoded by calling `job(index, arg)` once for each index below
+   `count`, from as many threads as you like, the function must return once
+   all the jobs are done, errors are reported for the first layer in document
+   order, ignored with tmx_lazy_layers */
+TMXEXPORT extern void (*tmx_parallel_func) (void (*job)(int index, void *arg), int count, void *arg);
+
 /* load/free tmx_image->resource_image, you should set this if you want
    the library to load/free images */
 TMXEXPORT extern void* (*tmx_img_load_func) (const char *path);
 TMXEXPORT extern void  (*tmx_img_free_func) (void *address);
 
+/* called when a loader phase begins (begin=1) and ends (begin=0), you may set
+   this to profile the loader, name is a string literal */
+TMXEXPORT extern void  (*tmx_trace_func) (const char *name, int begin);
+
+/* returns the content of a map or tileset file, you may set this to read
+   files from an archive, return NULL to read the file from disk */
+TMXEXPORT extern const char* (*tmx_file_read_func) (const char *path, int *len);
+
 /*
 	Data Structures
 */
@@ -70,6 +114,7 @@ typedef struct _tmx_obj tmx_object;
 typedef struct _tmx_objgr tmx_object_group;
 typedef struct _tmx_layer tmx_layer;
 typedef struct _tmx_map tmx_map;
+typedef struct _tmx_ctx tmx_ctx;
 typedef void tmx_properties; /* hashtable, use function tmx_get_property(...) */
 
 typedef union {
@@ -212,6 +257,8 @@ struct _tmx_layer { /* <layer> or <imagelayer> or <objectgroup> */
 	tmx_user_data user_data;
 	tmx_properties *properties;
 	tmx_layer *next;
+	void *encoded; /* private, see tmx_lazy_layers */
+	void *compact; /* private, see tmx_compact_layers */
 };
 
 struct _tmx_map { /* <map> (Head of the data structure) */
@@ -235,6 +282,9 @@ struct _tmx_map { /* <map> (Head of the data structure) */
 	tmx_tile **tiles; /* GID indexed tile array (array of pointers to tmx_tile) */
 
 	tmx_user_data user_data;
+
+	void *arena; /* private, see tmx_arena_mode */
+	tmx_ctx *ctx; /* private, context the map was loaded with, NULL if none */
 };
 
 /*
@@ -263,12 +313,37 @@ typedef int (*tmx_read_functor)(void *userdata, char *buffer, int len);
    returns NULL if an error occurred and set tmx_errno */
 TMXEXPORT tmx_map* tmx_load_callback(tmx_read_functor callback, void *userdata);
 
+/* Loads a map compiled by tmx_compile from file at `path` and returns the head
+   of the data structure, the file is read through tmx_file_read_func if set
+   returns NULL if an error occurred and set tmx_errno (E_NOENT if missing) */
+TMXEXPORT tmx_map* tmx_load_bin(const char *path);
+
+/* Compiles the map at `path` and its tilesets into a binary map at `bin_path`
+   that tmx_load_bin loads without parsing, image paths are kept relative so
+   `bin_path` should be in the same directory as `path`, external tilesets
+   keep their source for tmx_tsmgr_load_bin (tsx.h)
+   Returns 1 on success, 0 if an error occurred and set tmx_errno */
+TMXEXPORT int tmx_compile(const char *path, const char *bin_path);
+
 /* Frees the map data structure */
 TMXEXPORT void tmx_map_free(tmx_map *map);
 
 /* Returns the tile associated with this gid, returns NULL if it fails */
 TMXEXPORT tmx_tile* tmx_get_tile(tmx_map *map, unsigned int gid);
 
+/* Returns the gids of a tile layer, decodes the layer first if it has been
+   loaded with tmx_lazy_layers, returns NULL if it fails or if the layer has
+   been compacted (see tmx_compact_layers) */
+TMXEXPORT int32_t* tmx_get_layer_gids(tmx_map *map, tmx_layer *layer);
+
+/* Returns the gid (flip bits included) of the cell `x`,`y` of a tile layer
+   however it is stored, returns 0 and sets tmx_errno if it fails */
+TMXEXPORT int32_t tmx_get_layer_gid(tmx_map *map, tmx_layer *layer, unsigned int x, unsigned int y);
+
+/* Copies `count` gids of the row `y` of a tile layer, starting at column `x`,
+   to `gids`, returns 1 on success, 0 if it fails */
+TMXEXPORT int tmx_get_layer_row(tmx_map *map, tmx_layer *layer, unsigned int x, unsigned int y, unsigned int count, int32_t *gids);
+
 /* Returns the tmx_property from given hashtable and key, returns NULL if not found */
 TMXEXPORT tmx_property* tmx_get_property(tmx_properties *hash, const char *key);
 
@@ -302,13 +377,64 @@ typedef enum _tmx_error_codes {
 	E_MISSEL = 30     /* Missing element, incomplete source */
 } tmx_error_codes;
 
-extern tmx_error_codes tmx_errno;
+extern TMXTLS tmx_error_codes tmx_errno;
 
 /* Prints the error message prefixed with the parameter */
 TMXEXPORT void tmx_perror(const char*);
 /* Returns the error message for the current value of `tmx_errno` */
 TMXEXPORT const char* tmx_strerr(void); /* FIXME errno parameter ? (as strerror) */
 
+/*
+	Loader context
+	holds its own copy of the configuration and its own error state, several
+	threads may load maps at once as long as each uses its own context
+*/
+
+struct _tmx_ctx {
+	/* same as the configuration globals */
+	void* (*alloc_func) (void *address, size_t len);
+	void  (*free_func ) (void *address);
+	void* (*img_load_func) (const char *path);
+	void  (*img_free_func) (void *address);
+	void  (*trace_func) (const char *name, int begin);
+	const char* (*file_read_func) (const char *path, int *len);
+	void  (*parallel_func) (void (*job)(int index, void *arg), int count, void *arg);
+	int arena_mode;
+	int lazy_layers;
+	int compact_layers;
+
+	/* not used by the library, the callbacks above read it with
+	   tmx_ctx_userdata, set it after tmx_ctx_init */
+	void *userdata;
+
+	/* error of the last call that failed with this context */
+	tmx_error_codes error;
+	char error_msg[256];
+
+	void *arena; /* private, arena of the map being loaded */
+};
+
+/* Initialises `ctx` with a copy of the configuration globals, call it from
+   the main thread as it also initialises libxml2 */
+TMXEXPORT void tmx_ctx_init(tmx_ctx *ctx);
+
+/* Same as the functions above, the map is allocated and later freed with the
+   functions of `ctx` so the context must outlive the map, tmx_errno is set
+   as usual and the error is also stored in `ctx` */
+TMXEXPORT tmx_map* tmx_ctx_load(tmx_ctx *ctx, const char *path);
+TMXEXPORT tmx_map* tmx_ctx_load_buffer(tmx_ctx *ctx, const char *buffer, int len);
+TMXEXPORT tmx_map* tmx_ctx_load_fd(tmx_ctx *ctx, int fd);
+TMXEXPORT tmx_map* tmx_ctx_load_callback(tmx_ctx *ctx, tmx_read_functor callback, void *userdata);
+TMXEXPORT tmx_map* tmx_ctx_load_bin(tmx_ctx *ctx, const char *path);
+
+/* Returns the message of the last error stored in `ctx` */
+TMXEXPORT const char* tmx_ctx_strerr(tmx_ctx *ctx);
+
+/* Returns the userdata of the context the calling thread is loading or
+   freeing a map with, NULL if there is none or it has no userdata,
+   meant to be called from the callbacks (img_load_func, img_free_func, ...) */
+TMXEXPORT void* tmx_ctx_userdata(void);
+
 #ifdef __cplusplus
 }
 #endif
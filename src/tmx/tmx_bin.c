@@ -0,0 +1,830 @@
+/*
+	Binary map format
+
+	A compiled map holds the same tree as the TMX/TSX files it was built from,
+	stored as a flat host-endian stream that is read back without any parsing:
+	tiles are stored already indexed (see set_tiles_runtime_props) and the gids
+	of each tile layer are stored as one aligned array.
+	External tilesets are embedded along with their source and length, so that
+	a loader with a tileset manager takes the tileset from the manager or loads
+	it into the manager, and skips it if it is already there. Image paths are
+	stored relative to the map file, so the compiled map can replace the TMX
+	file next to it.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tmx.h"
+#include "tsx.h"
+#include "tmx_utils.h"
+
+#define BIN_MAGIC   "TMXB"
+#define BIN_VERSION 2
+#define BIN_BOM     0x01020304u /* detects a byte order mismatch */
+#define BIN_NULL    0xFFFFFFFFu /* length of a NULL string, or absent node */
+
+/*
+	Writer
+*/
+
+struct bin_writer {
+	FILE *file; /* NULL to only count the bytes written */
+	const char *path; /* path of the source map */
+	tmx_tileset_manager *ts_mgr; /* holds the external tilesets */
+	size_t pos;
+};
+
+static void write_raw(struct bin_writer *w, const void *data, size_t len) {
+	if (w->file) fwrite(data, 1, len, w->file);
+	w->pos += len;
+}
+
+static void write_u32(struct bin_writer *w, uint32_t value) {
+	write_raw(w, &value, sizeof(value));
+}
+
+static void write_f64(struct bin_writer *w, double value) {
+	write_raw(w, &value, sizeof(value));
+}
+
+static void write_align(struct bin_writer *w) {
+	static const char zero[4] = {0};
+	write_raw(w, zero, (4 - (w->pos & 3)) & 3);
+}
+
+static void write_str(struct bin_writer *w, const char *str) {
+	uint32_t len;
+	if (!str) {
+		write_u32(w, BIN_NULL);
+		return;
+	}
+	len = (uint32_t)strlen(str);
+	write_u32(w, len);
+	write_raw(w, str, len + 1);
+}
+
+static void count_property(tmx_property *property UNUSED, void *userdata) {
+	(*(uint32_t*)userdata)++;
+}
+
+static void write_property(tmx_property *property, void *userdata) {
+	struct bin_writer *w = (struct bin_writer*)userdata;
+	write_str(w, property->name);
+	write_u32(w, property->type);
+	switch (property->type) {
+		case PT_INT:
+		case PT_BOOL:  write_u32(w, (uint32_t)property->value.integer); break;
+		case PT_FLOAT: write_raw(w, &(property->value.decimal), sizeof(float)); break;
+		case PT_COLOR: write_u32(w, property->value.color); break;
+		default:       write_str(w, property->value.string); break;
+	}
+}
+
+static void write_props(struct bin_writer *w, tmx_properties *props) {
+	uint32_t count = 0;
+	if (props) tmx_property_foreach(props, count_property, &count);
+	write_u32(w, count);
+	if (count) tmx_property_foreach(props, write_property, w);
+}
+
+/* while compiling, resource_image holds the resolved path (see compile_img_load) */
+static void write_image(struct bin_writer *w, tmx_image *img) {
+	const char *path;
+	size_t dp_len;
+
+	if (!img) {
+		write_u32(w, BIN_NULL);
+		return;
+	}
+	write_u32(w, 1);
+
+	path = (const char*)img->resource_image;
+	dp_len = dirpath_len(w->path);
+	if (path && !strncmp(path, w->path, dp_len)) path += dp_len;
+
+	write_str(w, img->source);
+	write_str(w, path ? path : img->source);
+	write_u32(w, img->trans);
+	write_u32(w, img->uses_trans);
+	write_u32(w, (uint32_t)img->width);
+	write_u32(w, (uint32_t)img->height);
+}
+
+static void write_objects(struct bin_writer *w, tmx_object *head) {
+	tmx_object *o;
+	tmx_text *t;
+	uint32_t count = 0;
+	int i;
+
+	for (o = head; o; o = o->next) count++;
+	write_u32(w, count);
+
+	for (o = head; o; o = o->next) {
+		write_u32(w, o->id);
+		write_u32(w, o->obj_type);
+		write_f64(w, o->x);
+		write_f64(w, o->y);
+		write_f64(w, o->width);
+		write_f64(w, o->height);
+		write_u32(w, (uint32_t)o->visible);
+		write_f64(w, o->rotation);
+		write_str(w, o->name);
+		write_str(w, o->type);
+		write_props(w, o->properties);
+
+		if (o->obj_type == OT_TILE) {
+			write_u32(w, (uint32_t)o->content.gid);
+		}
+		else if (o->obj_type == OT_POLYGON || o->obj_type == OT_POLYLINE) {
+			write_u32(w, (uint32_t)o->content.shape->points_len);
+			for (i=0; i<o->content.shape->points_len; i++) {
+				write_f64(w, o->content.shape->points[i][0]);
+				write_f64(w, o->content.shape->points[i][1]);
+			}
+		}
+		else if (o->obj_type == OT_TEXT) {
+			t = o->content.text;
+			write_str(w, t->fontfamily);
+			write_u32(w, (uint32_t)t->pixelsize);
+			write_u32(w, t->color);
+			write_u32(w, (uint32_t)t->wrap);
+			write_u32(w, (uint32_t)t->bold);
+			write_u32(w, (uint32_t)t->italic);
+			write_u32(w, (uint32_t)t->underline);
+			write_u32(w, (uint32_t)t->strikeout);
+			write_u32(w, (uint32_t)t->kerning);
+			write_u32(w, t->halign);
+			write_u32(w, t->valign);
+			write_str(w, t->text);
+		}
+	}
+}
+
+static void write_tileset(struct bin_writer *w, tmx_tileset *ts) {
+	unsigned int i, j;
+	tmx_tile *tile;
+
+	write_str(w, ts->name);
+	write_u32(w, ts->tile_width);
+	write_u32(w, ts->tile_height);
+	write_u32(w, ts->spacing);
+	write_u32(w, ts->margin);
+	write_u32(w, (uint32_t)ts->x_offset);
+	write_u32(w, (uint32_t)ts->y_offset);
+	write_u32(w, ts->tilecount);
+	write_image(w, ts->image);
+	write_props(w, ts->properties);
+
+	for (i=0; i<ts->tilecount; i++) {
+		tile = ts->tiles + i;
+		write_u32(w, tile->id);
+		write_u32(w, tile->ul_x);
+		write_u32(w, tile->ul_y);
+		write_image(w, tile->image);
+		write_objects(w, tile->collision);
+		write_u32(w, tile->animation_len);
+		for (j=0; j<tile->animation_len; j++) {
+			write_u32(w, tile->animation[j].tile_id);
+			write_u32(w, tile->animation[j].duration);
+		}
+		write_str(w, tile->type);
+		write_props(w, tile->properties);
+	}
+}
+
+struct bin_source {
+	tmx_tileset *tileset;
+	const char *source;
+};
+
+static void find_source(void *val, void *userdata, const char *key) {
+	struct bin_source *s = (struct bin_source*)userdata;
+	if (val == s->tileset) s->source = key;
+}
+
+/* the source of an external tileset and the length of the tileset precede it */
+static void write_tileset_entry(struct bin_writer *w, tmx_tileset *ts) {
+	struct bin_writer counter = *w;
+	struct bin_source s;
+
+	s.tileset = ts;
+	s.source = NULL;
+	if (!ts->is_embedded) hashtable_foreach(w->ts_mgr, find_source, &s);
+	write_str(w, s.source);
+
+	counter.file = NULL;
+	counter.pos = 0;
+	write_tileset(&counter, ts);
+	write_u32(w, (uint32_t)counter.pos);
+
+	write_tileset(w, ts);
+}
+
+static void write_layers(struct bin_writer *w, tmx_map *map, tmx_layer *head) {
+	tmx_layer *l;
+	uint32_t count = 0;
+
+	for (l = head; l; l = l->next) count++;
+	write_u32(w, count);
+
+	for (l = head; l; l = l->next) {
+		write_u32(w, l->type);
+		write_str(w, l->name);
+		write_f64(w, l->opacity);
+		write_u32(w, (uint32_t)l->visible);
+		write_u32(w, (uint32_t)l->offsetx);
+		write_u32(w, (uint32_t)l->offsety);
+		write_props(w, l->properties);
+
+		if (l->type == L_LAYER) {
+			write_align(w);
+			write_raw(w, l->content.gids, map->width * map->height * sizeof(int32_t));
+		}
+		else if (l->type == L_OBJGR) {
+			write_u32(w, l->content.objgr->color);
+			write_u32(w, l->content.objgr->draworder);
+			write_objects(w, l->content.objgr->head);
+		}
+		else if (l->type == L_IMAGE) {
+			write_image(w, l->content.image);
+		}
+		else if (l->type == L_GROUP) {
+			write_layers(w, map, l->content.group_head);
+		}
+	}
+}
+
+static void write_map(struct bin_writer *w, tmx_map *map) {
+	tmx_tileset_list *tsl;
+	uint32_t count = 0;
+
+	write_raw(w, BIN_MAGIC, 4);
+	write_u32(w, BIN_BOM);
+	write_u32(w, BIN_VERSION);
+
+	write_u32(w, map->orient);
+	write_u32(w, map->width);
+	write_u32(w, map->height);
+	write_u32(w, map->tile_width);
+	write_u32(w, map->tile_height);
+	write_u32(w, map->stagger_index);
+	write_u32(w, map->stagger_axis);
+	write_u32(w, (uint32_t)map->hexsidelength);
+	write_u32(w, map->backgroundcolor);
+	write_u32(w, map->renderorder);
+	write_props(w, map->properties);
+
+	for (tsl = map->ts_head; tsl; tsl = tsl->next) count++;
+	write_u32(w, count);
+	for (tsl = map->ts_head; tsl; tsl = tsl->next) {
+		write_u32(w, tsl->firstgid);
+		write_tileset_entry(w, tsl->tileset);
+	}
+
+	write_layers(w, map, map->ly_head);
+}
+
+/* keeps the resolved path of every image instead of loading it */
+static void* compile_img_load(const char *path) {
+	return tmx_strdup(path);
+}
+
+/*
+	Reader
+*/
+
+struct bin_reader {
+	const char *data;
+	size_t len;
+	size_t pos;
+	const char *path; /* path of the compiled map */
+};
+
+static int read_raw(struct bin_reader *r, void *dst, size_t len) {
+	if (len > r->len - r->pos) {
+		tmx_err(E_MISSEL, "binary loader: unexpected end of file '%s'", r->path);
+		return 0;
+	}
+	memcpy(dst, r->data + r->pos, len);
+	r->pos += len;
+	return 1;
+}
+
+static int read_u32(struct bin_reader *r, uint32_t *value) {
+	return read_raw(r, value, sizeof(uint32_t));
+}
+
+static int read_uint(struct bin_reader *r, unsigned int *value) {
+	uint32_t v;
+	if (!read_u32(r, &v)) return 0;
+	*value = v;
+	return 1;
+}
+
+static int read_int(struct bin_reader *r, int *value) {
+	uint32_t v;
+	if (!read_u32(r, &v)) return 0;
+	*value = (int)(int32_t)v;
+	return 1;
+}
+
+static int read_f64(struct bin_reader *r, double *value) {
+	return read_raw(r, value, sizeof(double));
+}
+
+static void read_align(struct bin_reader *r) {
+	r->pos = (r->pos + 3) & ~(size_t)3;
+	if (r->pos > r->len) r->pos = r->len;
+}
+
+static int read_str(struct bin_reader *r, char **str) {
+	uint32_t len;
+	*str = NULL;
+	if (!read_u32(r, &len)) return 0;
+	if (len == BIN_NULL) return 1;
+	if ((size_t)len >= r->len - r->pos || r->data[r->pos + len] != '\0') {
+		tmx_err(E_FORMAT, "binary loader: corrupted string in '%s'", r->path);
+		return 0;
+	}
+	if (!(*str = (char*)ctx_current->alloc_func(NULL, len + 1))) {
+		tmx_errno = E_ALLOC;
+		return 0;
+	}
+	memcpy(*str, r->data + r->pos, len + 1);
+	r->pos += len + 1;
+	return 1;
+}
+
+static int read_props(struct bin_reader *r, tmx_properties **props) {
+	tmx_property *res;
+	uint32_t count, type;
+
+	if (!read_u32(r, &count)) return 0;
+	if (!count) return 1;
+
+	if (!(*props = (tmx_properties*)mk_hashtable(count < 64 ? count : 64))) return 0;
+
+	while (count--) {
+		if (!(res = alloc_prop())) return 0;
+		if (!read_str(r, &(res->name)) || !read_u32(r, &type)) {
+			free_property(res);
+			return 0;
+		}
+		res->type = (enum tmx_property_type)type;
+		hashtable_set((void*)*props, res->name, (void*)res, NULL);
+
+		switch (res->type) {
+			case PT_INT:
+			case PT_BOOL:  if (!read_int(r, &(res->value.integer))) return 0; break;
+			case PT_FLOAT: if (!read_raw(r, &(res->value.decimal), sizeof(float))) return 0; break;
+			case PT_COLOR: if (!read_uint(r, &(res->value.color))) return 0; break;
+			default:       if (!read_str(r, &(res->value.string))) return 0; break;
+		}
+	}
+	return 1;
+}
+
+static int read_image(struct bin_reader *r, tmx_image **img_adr) {
+	tmx_image *res;
+	uint32_t present, width, height;
+	char *path;
+
+	if (!read_u32(r, &present)) return 0;
+	if (present == BIN_NULL) return 1;
+
+	if (!(res = alloc_image())) return 0;
+	*img_adr = res;
+
+	if (!read_str(r, &(res->source)) || !read_str(r, &path)) return 0;
+	if (!read_uint(r, &(res->trans)) || !read_int(r, &(res->uses_trans)) ||
+	    !read_u32(r, &width) || !read_u32(r, &height)) {
+		ctx_current->free_func(path);
+		return 0;
+	}
+	res->width = width;
+	res->height = height;
+
+	if (!path) {
+		tmx_err(E_MISSEL, "binary loader: missing image path in '%s'", r->path);
+		return 0;
+	}
+	if (!(load_image(&(res->resource_image), r->path, path))) {
+		tmx_err(E_UNKN, "binary loader: an error occured in the delegated image loading function");
+		ctx_current->free_func(path);
+		return 0;
+	}
+	ctx_current->free_func(path);
+	return 1;
+}
+
+static int read_points(struct bin_reader *r, tmx_shape *shape) {
+	uint32_t len;
+
+	if (!read_u32(r, &len)) return 0;
+	if (!len || (size_t)len > (r->len - r->pos) / (2 * sizeof(double))) {
+		tmx_err(E_FORMAT, "binary loader: corrupted point list in '%s'", r->path);
+		return 0;
+	}
+	shape->points_len = (int)len;
+
+	shape->points = (double**)ctx_current->alloc_func(NULL, shape->points_len * sizeof(double*)); /* points[i][x,y] */
+	if (!(shape->points)) {
+		tmx_errno = E_ALLOC;
+		return 0;
+	}
+
+	shape->points[0] = (double*)ctx_current->alloc_func(NULL, shape->points_len * 2 * sizeof(double));
+	if (!(shape->points[0])) {
+		ctx_current->free_func(shape->points);
+		shape->points = NULL;
+		tmx_errno = E_ALLOC;
+		return 0;
+	}
+
+	for (len=1; len<(uint32_t)shape->points_len; len++) {
+		shape->points[len] = shape->points[0]+(len*2);
+	}
+
+	return read_raw(r, shape->points[0], shape->points_len * 2 * sizeof(double));
+}
+
+static int read_text(struct bin_reader *r, tmx_text *text) {
+	uint32_t halign, valign;
+
+	if (!read_str(r, &(text->fontfamily)) || !read_int(r, &(text->pixelsize)) ||
+	    !read_uint(r, &(text->color)) || !read_int(r, &(text->wrap)) ||
+	    !read_int(r, &(text->bold)) || !read_int(r, &(text->italic)) ||
+	    !read_int(r, &(text->underline)) || !read_int(r, &(text->strikeout)) ||
+	    !read_int(r, &(text->kerning)) || !read_u32(r, &halign) ||
+	    !read_u32(r, &valign)) return 0;
+
+	text->halign = (enum tmx_horizontal_align)halign;
+	text->valign = (enum tmx_vertical_align)valign;
+
+	return read_str(r, &(text->text));
+}
+
+static int read_objects(struct bin_reader *r, tmx_object **head) {
+	tmx_object *res, **tail = head;
+	uint32_t count, type;
+
+	if (!read_u32(r, &count)) return 0;
+
+	while (count--) {
+		if (!(res = alloc_object())) return 0;
+		*tail = res;
+		tail = &(res->next);
+
+		if (!read_uint(r, &(res->id)) || !read_u32(r, &type)) return 0;
+		res->obj_type = (enum tmx_obj_type)type;
+
+		if (!read_f64(r, &(res->x)) || !read_f64(r, &(res->y)) ||
+		    !read_f64(r, &(res->width)) || !read_f64(r, &(res->height)) ||
+		    !read_int(r, &(res->visible)) || !read_f64(r, &(res->rotation)) ||
+		    !read_str(r, &(res->name)) || !read_str(r, &(res->type)) ||
+		    !read_props(r, &(res->properties))) return 0;
+
+		if (res->obj_type == OT_TILE) {
+			if (!read_int(r, &(res->content.gid))) return 0;
+		}
+		else if (res->obj_type == OT_POLYGON || res->obj_type == OT_POLYLINE) {
+			if (!(res->content.shape = alloc_shape())) return 0;
+			if (!read_points(r, res->content.shape)) return 0;
+		}
+		else if (res->obj_type == OT_TEXT) {
+			if (!(res->content.text = alloc_text())) return 0;
+			if (!read_text(r, res->content.text)) return 0;
+		}
+	}
+	return 1;
+}
+
+static int read_tileset(struct bin_reader *r, tmx_tileset *ts) {
+	unsigned int i, j;
+	tmx_tile *tile;
+
+	if (!read_str(r, &(ts->name)) || !read_uint(r, &(ts->tile_width)) ||
+	    !read_uint(r, &(ts->tile_height)) || !read_uint(r, &(ts->spacing)) ||
+	    !read_uint(r, &(ts->margin)) || !read_int(r, &(ts->x_offset)) ||
+	    !read_int(r, &(ts->y_offset)) || !read_uint(r, &(ts->tilecount)) ||
+	    !read_image(r, &(ts->image)) || !read_props(r, &(ts->properties))) return 0;
+
+	if (ts->tilecount > r->len - r->pos) {
+		tmx_err(E_FORMAT, "binary loader: corrupted tileset in '%s'", r->path);
+		ts->tilecount = 0;
+		return 0;
+	}
+	if (!(ts->tiles = alloc_tiles(ts->tilecount))) return 0;
+
+	for (i=0; i<ts->tilecount; i++) {
+		tile = ts->tiles + i;
+		tile->tileset = ts;
+
+		if (!read_uint(r, &(tile->id)) || !read_uint(r, &(tile->ul_x)) ||
+		    !read_uint(r, &(tile->ul_y)) || !read_image(r, &(tile->image)) ||
+		    !read_objects(r, &(tile->collision)) || !read_uint(r, &(tile->animation_len))) return 0;
+
+		if (tile->animation_len) {
+			if (tile->animation_len > (r->len - r->pos) / (2 * sizeof(uint32_t))) {
+				tmx_err(E_FORMAT, "binary loader: corrupted animation in '%s'", r->path);
+				tile->animation_len = 0;
+				return 0;
+			}
+			if (!(tile->animation = (tmx_anim_frame*)ctx_current->alloc_func(NULL, tile->animation_len * sizeof(tmx_anim_frame)))) {
+				tmx_errno = E_ALLOC;
+				return 0;
+			}
+			for (j=0; j<tile->animation_len; j++) {
+				if (!read_uint(r, &(tile->animation[j].tile_id)) ||
+				    !read_uint(r, &(tile->animation[j].duration))) return 0;
+			}
+		}
+
+		if (!read_str(r, &(tile->type)) || !read_props(r, &(tile->properties))) return 0;
+	}
+	return 1;
+}
+
+static int read_layers(struct bin_reader *r, tmx_map *map, tmx_layer **head) {
+	tmx_layer *res, **tail = head;
+	uint32_t count, type, draworder;
+	size_t gids_len;
+
+	if (!read_u32(r, &count)) return 0;
+
+	while (count--) {
+		if (!(res = alloc_layer())) return 0;
+		*tail = res;
+		tail = &(res->next);
+
+		if (!read_u32(r, &type)) return 0;
+		if (!read_str(r, &(res->name)) || !read_f64(r, &(res->opacity)) ||
+		    !read_int(r, &(res->visible)) || !read_int(r, &(res->offsetx)) ||
+		    !read_int(r, &(res->offsety)) || !read_props(r, &(res->properties))) return 0;
+
+		if (type == L_LAYER) {
+			gids_len = (size_t)map->width * map->height * sizeof(int32_t);
+			read_align(r);
+			if (gids_len > r->len - r->pos) {
+				tmx_err(E_MISSEL, "binary loader: unexpected end of file '%s'", r->path);
+				return 0;
+			}
+			if (!(res->content.gids = (int32_t*)ctx_current->alloc_func(NULL, gids_len))) {
+				tmx_errno = E_ALLOC;
+				return 0;
+			}
+			res->type = L_LAYER;
+			if (!read_raw(r, res->content.gids, gids_len)) return 0;
+			if (ctx_current->compact_layers && !gids_compact(res, map->width, map->height)) return 0;
+		}
+		else if (type == L_OBJGR) {
+			if (!(res->content.objgr = alloc_objgr())) return 0;
+			res->type = L_OBJGR;
+			if (!read_uint(r, &(res->content.objgr->color)) || !read_u32(r, &draworder)) return 0;
+			res->content.objgr->draworder = (enum tmx_objgr_draworder)draworder;
+			if (!read_objects(r, &(res->content.objgr->head))) return 0;
+		}
+		else if (type == L_IMAGE) {
+			res->type = L_IMAGE;
+			if (!read_image(r, &(res->content.image))) return 0;
+		}
+		else if (type == L_GROUP) {
+			res->type = L_GROUP;
+			if (!read_layers(r, map, &(res->content.group_head))) return 0;
+		}
+		else {
+			tmx_err(E_FORMAT, "binary loader: unknown layer type in '%s'", r->path);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* reads the tileset of an entry into the manager unless it is already there */
+static tmx_tileset* read_shared_tileset(struct bin_reader *r, tmx_tileset_manager *ts_mgr, const char *source, uint32_t len) {
+	tmx_tileset *ts;
+	void *arena;
+	int ret = 0;
+
+	if ((ts = (tmx_tileset*)hashtable_get(ts_mgr, source))) {
+		r->pos += len;
+		return ts;
+	}
+
+	/* the tileset belongs to the manager, not to the arena of the map */
+	arena = arena_suspend();
+	if ((ts = alloc_tileset())) {
+		if (!(ret = read_tileset(r, ts))) {
+			free_ts(ts);
+		}
+		else if (!(ret = hashtable_set(ts_mgr, source, (void*)ts, tileset_deallocator))) {
+			free_ts(ts);
+		}
+	}
+	arena_continue(arena);
+
+	return ret ? ts : NULL;
+}
+
+static tmx_map* read_map(struct bin_reader *r, tmx_tileset_manager *ts_mgr) {
+	tmx_map *res;
+	tmx_tileset *ts;
+	tmx_tileset_list *tsl, **tail;
+	char magic[4], *source;
+	uint32_t bom, version, count, firstgid, len;
+	uint32_t orient, stagger_index, stagger_axis, renderorder;
+
+	if (!read_raw(r, magic, 4) || !read_u32(r, &bom) || !read_u32(r, &version)) return NULL;
+	if (memcmp(magic, BIN_MAGIC, 4) || bom != BIN_BOM || version != BIN_VERSION) {
+		tmx_err(E_FORMAT, "binary loader: '%s' is not a compiled map or was compiled for another version or byte order", r->path);
+		return NULL;
+	}
+
+	if (!(res = alloc_map())) return NULL;
+
+	if (!read_u32(r, &orient) || !read_uint(r, &(res->width)) ||
+	    !read_uint(r, &(res->height)) || !read_uint(r, &(res->tile_width)) ||
+	    !read_uint(r, &(res->tile_height)) || !read_u32(r, &stagger_index) ||
+	    !read_u32(r, &stagger_axis) || !read_int(r, &(res->hexsidelength)) ||
+	    !read_uint(r, &(res->backgroundcolor)) || !read_u32(r, &renderorder) ||
+	    !read_props(r, &(res->properties)) || !read_u32(r, &count)) goto cleanup;
+
+	res->orient = (enum tmx_map_orient)orient;
+	res->stagger_index = (enum tmx_stagger_index)stagger_index;
+	res->stagger_axis = (enum tmx_stagger_axis)stagger_axis;
+	res->renderorder = (enum tmx_map_renderorder)renderorder;
+
+	tail = &(res->ts_head);
+	while (count--) {
+		if (!read_u32(r, &firstgid) || !read_str(r, &source)) goto cleanup;
+		if (!read_u32(r, &len) || len > r->len - r->pos) {
+			tmx_err(E_FORMAT, "binary loader: corrupted tileset in '%s'", r->path);
+			ctx_current->free_func(source);
+			goto cleanup;
+		}
+
+		/* external tilesets are shared through the manager */
+		if (ts_mgr && source) {
+			ts = read_shared_tileset(r, ts_mgr, source, len);
+			ctx_current->free_func(source);
+			if (!ts) goto cleanup;
+			if (!(tsl = alloc_tileset_list())) goto cleanup;
+			tsl->firstgid = firstgid;
+			tsl->tileset = ts;
+			*tail = tsl;
+			tail = &(tsl->next);
+			continue;
+		}
+		ctx_current->free_func(source);
+
+		if (!(ts = alloc_tileset())) goto cleanup;
+		if (!(tsl = alloc_tileset_list())) {
+			ctx_current->free_func(ts);
+			goto cleanup;
+		}
+		ts->is_embedded = 1;
+		tsl->firstgid = firstgid;
+		tsl->tileset = ts;
+		*tail = tsl;
+		tail = &(tsl->next);
+		if (!read_tileset(r, tsl->tileset)) goto cleanup;
+	}
+
+	if (!read_layers(r, res, &(res->ly_head))) goto cleanup;
+
+	return res;
+
+cleanup:
+	tmx_map_free(res);
+	return NULL;
+}
+
+/* reads the whole file through tmx_file_read_func or from disk, *owned is set if the buffer must be freed */
+static char* read_file(const char *path, int *len, int *owned) {
+	const char *data;
+	char *res;
+	FILE *file;
+	long size;
+
+	*owned = 0;
+	if (ctx_current->file_read_func && (data = ctx_current->file_read_func(path, len))) {
+		return (char*)data;
+	}
+
+	if (!(file = fopen(path, "rb"))) {
+		tmx_err(E_NOENT, "binary loader: cannot open '%s'", path);
+		return NULL;
+	}
+
+	fseek(file, 0, SEEK_END);
+	size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	if (size < 0 || !(res = (char*)ctx_current->alloc_func(NULL, size > 0 ? size : 1))) {
+		tmx_errno = E_ALLOC;
+		fclose(file);
+		return NULL;
+	}
+
+	if (fread(res, 1, size, file) != (size_t)size) {
+		tmx_err(E_ACCESS, "binary loader: cannot read '%s'", path);
+		ctx_current->free_func(res);
+		fclose(file);
+		return NULL;
+	}
+
+	fclose(file);
+	*len = (int)size;
+	*owned = 1;
+	return res;
+}
+
+tmx_map* parse_bin(tmx_tileset_manager *ts_mgr, const char *path) {
+	struct bin_reader r;
+	tmx_map *map = NULL;
+	char *data;
+	int len, owned;
+
+	if ((data = read_file(path, &len, &owned))) {
+		r.data = data;
+		r.len = (size_t)len;
+		r.pos = 0;
+		r.path = path;
+		map = read_map(&r, ts_mgr);
+		if (owned) ctx_current->free_func(data);
+	}
+	return map;
+}
+
+/*
+	Public functions
+*/
+
+int tmx_compile(const char *path, const char *bin_path) {
+	struct bin_writer w;
+	tmx_ctx ctx, *prev;
+	tmx_tileset_manager *ts_mgr;
+	tmx_map *map;
+	int ret;
+
+	/* a context of its own, the caller's configuration is left untouched */
+	prev = ctx_enter(NULL);
+	ctx = *ctx_current;
+	ctx_leave(prev, 1);
+	ctx.img_load_func = compile_img_load;
+	ctx.img_free_func = ctx.free_func;
+	ctx.arena_mode = 0; /* the image paths are freed with free_func */
+	ctx.lazy_layers = 0; /* every layer is written out anyway */
+	ctx.compact_layers = 0;
+	ctx.arena = NULL;
+
+	/* loaded with a manager to tell the external tilesets by their source */
+	if (!(ts_mgr = tmx_ctx_make_tileset_manager(&ctx))) return 0;
+	map = tmx_tsmgr_load(ts_mgr, path);
+	ret = 0;
+
+	if (map) {
+		if (!(w.file = fopen(bin_path, "wb"))) {
+			tmx_err(E_ACCESS, "binary compiler: cannot create '%s'", bin_path);
+		}
+		else {
+			w.path = path;
+			w.ts_mgr = ts_mgr;
+			w.pos = 0;
+			write_map(&w, map);
+			ret = !ferror(w.file);
+			if (fclose(w.file) || !ret) {
+				tmx_err(E_ACCESS, "binary compiler: cannot write '%s'", bin_path);
+				ret = 0;
+			}
+		}
+		tmx_map_free(map);
+	}
+	tmx_free_tileset_manager(ts_mgr);
+
+	return ret;
+}
+
+tmx_map* tmx_load_bin(const char *path) {
+	return tmx_ctx_load_bin(NULL, path);
+}
+
+tmx_map* tmx_ctx_load_bin(tmx_ctx *ctx, const char *path) {
+	tmx_map *map;
+	tmx_ctx *prev;
+	void *arena;
+
+	prev = ctx_enter(ctx);
+	TMX_TRACE("tmx_load_bin", 1);
+	arena = arena_begin();
+	map = parse_bin(NULL, path);
+	map_post_parsing(&map);
+	arena_end(arena, map);
+	if (map) map->ctx = ctx;
+
+	TMX_TRACE("tmx_load_bin", 0);
+	ctx_leave(prev, map != NULL);
+	return map;
+}
@@ -0,0 +1,76 @@
+/*
+	Loader context
+
+	Every function of the library reads its configuration through ctx_current,
+	the public functions set it to the context they were given, or to a copy
+	of the configuration globals made for the calling thread.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <libxml/parser.h>
+
+#include "tmx.h"
+#include "tsx.h"
+#include "tmx_utils.h"
+
+TMXTLS tmx_ctx *ctx_current = NULL;
+
+static TMXTLS tmx_ctx ctx_globals; /* used when no context is given */
+
+static void ctx_defaults(tmx_ctx *ctx) {
+	if (!ctx->alloc_func) ctx->alloc_func = realloc;
+	if (!ctx->free_func) ctx->free_func = free;
+}
+
+static void ctx_copy_globals(tmx_ctx *ctx) {
+	ctx->alloc_func = tmx_alloc_func;
+	ctx->free_func = tmx_free_func;
+	ctx->img_load_func = tmx_img_load_func;
+	ctx->img_free_func = tmx_img_free_func;
+	ctx->trace_func = tmx_trace_func;
+	ctx->file_read_func = tmx_file_read_func;
+	ctx->parallel_func = tmx_parallel_func;
+	ctx->arena_mode = tmx_arena_mode;
+	ctx->lazy_layers = tmx_lazy_layers;
+	ctx->compact_layers = tmx_compact_layers;
+	ctx->userdata = NULL;
+	ctx->arena = NULL;
+	ctx_defaults(ctx);
+}
+
+void tmx_ctx_init(tmx_ctx *ctx) {
+	if (!ctx) return;
+	xmlInitParser();
+	ctx_copy_globals(ctx);
+	ctx->error = E_NONE;
+	ctx->error_msg[0] = '\0';
+}
+
+tmx_ctx* ctx_enter(tmx_ctx *ctx) {
+	tmx_ctx *prev = ctx_current;
+
+	if (!ctx) {
+		/* nested calls keep the context of the outer call */
+		if (prev) return prev;
+		xmlInitParser();
+		ctx = &ctx_globals;
+		ctx_copy_globals(ctx);
+	}
+	ctx_defaults(ctx);
+	ctx_current = ctx;
+	return prev;
+}
+
+void ctx_leave(tmx_ctx *prev, int ok) {
+	if (!ok) {
+		ctx_current->error = tmx_errno;
+		memcpy(ctx_current->error_msg, custom_msg, sizeof(ctx_current->error_msg));
+	}
+	ctx_current = prev;
+}
+
+void* tmx_ctx_userdata(void) {
+	return ctx_current ? ctx_current->userdata : NULL;
+}
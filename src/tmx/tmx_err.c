@@ -5,7 +5,7 @@
 #include "tsx.h"
 #include "tmx_utils.h"
 
-tmx_error_codes tmx_errno = E_NONE;
+TMXTLS tmx_error_codes tmx_errno = E_NONE;
 
 static char *errmsgs[] = {
 	"No error",
@@ -15,21 +15,29 @@ static char *errmsgs[] = {
 	"Unsupproted/Unknown map file format"
 };
 
-char custom_msg[256];
+TMXTLS char custom_msg[256];
 
-const char* tmx_strerr(void) {
-	char *msg;
-	switch(tmx_errno) {
+static const char* error_message(tmx_error_codes code, const char *custom) {
+	const char *msg;
+	switch(code) {
 		case E_NONE:   msg = errmsgs[0]; break;
 		case E_ALLOC:  msg = errmsgs[1]; break;
 		case E_ACCESS: msg = errmsgs[2]; break;
 		case E_NOENT:  msg = errmsgs[3]; break;
 		case E_FORMAT: msg = errmsgs[4]; break;
-		default: msg = custom_msg;
+		default: msg = custom;
 	}
 	return msg;
 }
 
+const char* tmx_strerr(void) {
+	return error_message(tmx_errno, custom_msg);
+}
+
+const char* tmx_ctx_strerr(tmx_ctx *ctx) {
+	return error_message(ctx->error, ctx->error_msg);
+}
+
 void tmx_perror(const char *pos) {
 	const char *msg = tmx_strerr();
 	fprintf(stderr, "%s: %s\n", pos, msg);
@@ -1,40 +1,175 @@
 /*
 	Hashtable
 
-	This implementation is based on libxml/hash.h provided by libxml2.
+	Separate chaining with FNV-1a, keys are stored along with their entry,
+	the table doubles its size when it holds more entries than buckets.
+	Everything is allocated with the functions of the current context.
 */
 
-#include <libxml/hash.h>
+#include <stdint.h>
+#include <string.h>
 
 #include "tmx.h"
 #include "tsx.h"
 #include "tmx_utils.h"
 
+struct hash_entry {
+	struct hash_entry *next;
+	void *val;
+	uint32_t hash;
+	char key[];
+};
+
+struct hashtable {
+	tmx_ctx *owner;
+	struct hash_entry **buckets;
+	unsigned int size; /* power of two */
+	unsigned int count;
+};
+
+static uint32_t hash_key(const char *key) {
+	uint32_t h = 2166136261u;
+	for (; *key; key++) {
+		h ^= (unsigned char)*key;
+		h *= 16777619u;
+	}
+	return h;
+}
+
+static struct hash_entry** hash_find(struct hashtable *h, const char *key, uint32_t hash) {
+	struct hash_entry **e = h->buckets + (hash & (h->size - 1));
+	for (; *e; e = &((*e)->next)) {
+		if ((*e)->hash == hash && !strcmp((*e)->key, key)) break;
+	}
+	return e;
+}
+
+static void hash_grow(struct hashtable *h) {
+	struct hash_entry **buckets, *e, *next;
+	unsigned int size = h->size * 2, i;
+
+	/* the table still works if it cannot grow */
+	if (!(buckets = (struct hash_entry**)ctx_current->alloc_func(NULL, size * sizeof(struct hash_entry*)))) return;
+	memset(buckets, 0, size * sizeof(struct hash_entry*));
+
+	for (i = 0; i < h->size; i++) {
+		for (e = h->buckets[i]; e; e = next) {
+			next = e->next;
+			e->next = buckets[e->hash & (size - 1)];
+			buckets[e->hash & (size - 1)] = e;
+		}
+	}
+	ctx_current->free_func(h->buckets);
+	h->buckets = buckets;
+	h->size = size;
+}
+
 void* mk_hashtable(unsigned int initial_size) {
-	// Auto-resize is supported
-	setup_libxml_mem();
-	return (void*)xmlHashCreate(initial_size);
+	struct hashtable *h;
+	unsigned int size = 8;
+
+	while (size < initial_size) size *= 2;
+
+	if (!(h = (struct hashtable*)ctx_current->alloc_func(NULL, sizeof(struct hashtable)))) {
+		tmx_errno = E_ALLOC;
+		return NULL;
+	}
+	if (!(h->buckets = (struct hash_entry**)ctx_current->alloc_func(NULL, size * sizeof(struct hash_entry*)))) {
+		ctx_current->free_func(h);
+		tmx_errno = E_ALLOC;
+		return NULL;
+	}
+	memset(h->buckets, 0, size * sizeof(struct hash_entry*));
+	h->owner = NULL;
+	h->size = size;
+	h->count = 0;
+	return (void*)h;
 }
 
-void hashtable_set(void *hashtable, const char *key, void *val, hashtable_entry_deallocator deallocator) {
+int hashtable_set(void *hashtable, const char *key, void *val, hashtable_entry_deallocator deallocator) {
 	// Set or update value, key string is duplicated, deallocator may be NULL if values were not allocated
-	xmlHashUpdateEntry((xmlHashTablePtr)hashtable, (const xmlChar*)key, val, (xmlHashDeallocator)deallocator);
+	struct hashtable *h = (struct hashtable*)hashtable;
+	uint32_t hash = hash_key(key);
+	struct hash_entry **slot = hash_find(h, key, hash), *e;
+	size_t len;
+
+	if ((e = *slot)) {
+		if (deallocator && e->val != val) deallocator(e->val, e->key);
+		e->val = val;
+		return 1;
+	}
+
+	len = strlen(key) + 1;
+	if (!(e = (struct hash_entry*)ctx_current->alloc_func(NULL, sizeof(struct hash_entry) + len))) {
+		tmx_errno = E_ALLOC;
+		return 0;
+	}
+	e->next = NULL;
+	e->val = val;
+	e->hash = hash;
+	memcpy(e->key, key, len);
+	*slot = e;
+
+	if (++(h->count) > h->size) hash_grow(h);
+	return 1;
 }
 
 void* hashtable_get(void *hashtable, const char *key) {
-	return xmlHashLookup((xmlHashTablePtr)hashtable, (const xmlChar*)key);
+	struct hashtable *h = (struct hashtable*)hashtable;
+	struct hash_entry *e = *hash_find(h, key, hash_key(key));
+	return e ? e->val : NULL;
 }
 
 void hashtable_rm(void *hashtable, const char *key, hashtable_entry_deallocator deallocator) {
-	xmlHashRemoveEntry((xmlHashTablePtr)hashtable, (const xmlChar*)key, (xmlHashDeallocator)deallocator);
+	struct hashtable *h = (struct hashtable*)hashtable;
+	struct hash_entry **slot = hash_find(h, key, hash_key(key)), *e;
+
+	if (!(e = *slot)) return;
+	*slot = e->next;
+	h->count--;
+	if (deallocator) deallocator(e->val, e->key);
+	ctx_current->free_func(e);
 }
 
 void free_hashtable(void *hashtable, hashtable_entry_deallocator deallocator) {
-	xmlHashFree((xmlHashTablePtr)hashtable, (xmlHashDeallocator)deallocator);
+	struct hashtable *h = (struct hashtable*)hashtable;
+	struct hash_entry *e, *next;
+	unsigned int i;
+
+	if (!h) return;
+
+	for (i = 0; i < h->size; i++) {
+		for (e = h->buckets[i]; e; e = next) {
+			next = e->next;
+			if (deallocator) deallocator(e->val, e->key);
+			ctx_current->free_func(e);
+		}
+	}
+	ctx_current->free_func(h->buckets);
+	ctx_current->free_func(h);
 }
 
 void hashtable_foreach(void *hashtable, hashtable_foreach_functor functor, void *userdata) {
-	xmlHashScan((xmlHashTablePtr)hashtable, (xmlHashScanner)functor, userdata);
+	struct hashtable *h = (struct hashtable*)hashtable;
+	struct hash_entry *e, *next;
+	unsigned int i;
+
+	if (!h) return;
+
+	for (i = 0; i < h->size; i++) {
+		for (e = h->buckets[i]; e; e = next) {
+			next = e->next;
+			functor(e->val, userdata, e->key);
+		}
+	}
+}
+
+void hashtable_set_owner(void *hashtable, tmx_ctx *owner) {
+	((struct hashtable*)hashtable)->owner = owner;
+}
+
+tmx_ctx* hashtable_owner(void *hashtable) {
+	return ((struct hashtable*)hashtable)->owner;
 }
 
 void property_deallocator(void *val, const char *key UNUSED) {
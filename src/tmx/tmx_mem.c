@@ -2,29 +2,15 @@
 	Node allocation
 */
 
+#include <stdint.h>
 #include <string.h>
 
-#include <libxml/xmlmemory.h>
-
 #include "tmx.h"
 #include "tsx.h"
 #include "tmx_utils.h"
 
-void set_alloc_functions() {
-	if (!tmx_alloc_func) tmx_alloc_func = realloc;
-	if (!tmx_free_func) tmx_free_func = free;
-}
-
-static void* tmx_malloc(size_t len) {
-	return tmx_alloc_func(NULL, len);
-}
-
-void setup_libxml_mem() {
-	xmlMemSetup((xmlFreeFunc)tmx_free_func, (xmlMallocFunc)tmx_malloc, (xmlReallocFunc)tmx_alloc_func, (xmlStrdupFunc)tmx_strdup);
-}
-
 static void* node_alloc(size_t size) {
-	void *res = tmx_alloc_func(NULL, size);
+	void *res = ctx_current->alloc_func(NULL, size);
 	if (res) {
 		memset(res, 0, size);
 	} else {
@@ -99,11 +85,11 @@ tmx_map* alloc_map(void) {
 
 void free_property(tmx_property *p) {
 	if (p) {
-		tmx_free_func(p->name);
+		ctx_current->free_func(p->name);
 		if (p->type == PT_STRING || p->type == PT_FILE || p->type == PT_NONE) {
-			tmx_free_func(p->value.string);
+			ctx_current->free_func(p->value.string);
 		}
-		tmx_free_func(p);
+		ctx_current->free_func(p);
 	}
 }
 
@@ -114,52 +100,54 @@ void free_props(tmx_properties *h) {
 void free_obj(tmx_object *o) {
 	if (o) {
 		free_obj(o->next);
-		tmx_free_func(o->name);
+		ctx_current->free_func(o->name);
 		if (o->obj_type == OT_POLYGON || o->obj_type == OT_POLYLINE) {
 			if (o->content.shape) {
 				if (o->content.shape->points) {
-					tmx_free_func(*(o->content.shape->points));
-					tmx_free_func(o->content.shape->points);
+					ctx_current->free_func(*(o->content.shape->points));
+					ctx_current->free_func(o->content.shape->points);
 				}
-				tmx_free_func(o->content.shape);
+				ctx_current->free_func(o->content.shape);
 			}
 		}
 		else if (o->obj_type == OT_TEXT) {
 			if (o->content.text) {
-				if (o->content.text->fontfamily) tmx_free_func(o->content.text->fontfamily);
-				if (o->content.text->text) tmx_free_func(o->content.text->text);
-				tmx_free_func(o->content.text);
+				if (o->content.text->fontfamily) ctx_current->free_func(o->content.text->fontfamily);
+				if (o->content.text->text) ctx_current->free_func(o->content.text->text);
+				ctx_current->free_func(o->content.text);
 			}
 		}
-		tmx_free_func(o->type);
+		ctx_current->free_func(o->type);
 		free_props(o->properties);
-		tmx_free_func(o);
+		ctx_current->free_func(o);
 	}
 }
 
 void free_objgr(tmx_object_group *o) {
 	if (o) {
 		free_obj(o->head);
-		tmx_free_func(o);
+		ctx_current->free_func(o);
 	}
 }
 
 void free_image(tmx_image *i) {
 	if (i) {
-		tmx_free_func(i->source);
-		if (tmx_img_free_func) {
-			tmx_img_free_func(i->resource_image);
+		ctx_current->free_func(i->source);
+		if (ctx_current->img_free_func) {
+			ctx_current->img_free_func(i->resource_image);
 		}
-		tmx_free_func(i);
+		ctx_current->free_func(i);
 	}
 }
 
 void free_layers(tmx_layer *l) {
 	if (l) {
 		free_layers(l->next);
-		tmx_free_func(l->name);
+		ctx_current->free_func(l->name);
 		if (l->type == L_LAYER) {
-			tmx_free_func(l->content.gids);
+			ctx_current->free_func(l->content.gids);
+			ctx_current->free_func(l->encoded);
+			ctx_current->free_func(l->compact);
 		}
 		else if (l->type == L_OBJGR) {
 			free_objgr(l->content.objgr);
@@ -171,7 +159,7 @@ void free_layers(tmx_layer *l) {
 			free_layers(l->content.group_head);
 		}
 		free_props(l->properties);
-		tmx_free_func(l);
+		ctx_current->free_func(l);
 	}
 }
 
@@ -182,20 +170,20 @@ void free_tiles(tmx_tile *t, int tilecount) {
 			free_props(t[i].properties);
 			free_image(t[i].image);
 			free_obj(t[i].collision);
-			tmx_free_func(t[i].animation);
-			tmx_free_func(t[i].type);
+			ctx_current->free_func(t[i].animation);
+			ctx_current->free_func(t[i].type);
 		}
 	}
 }
 
 void free_ts(tmx_tileset *ts) {
 	if (ts) {
-		tmx_free_func(ts->name);
+		ctx_current->free_func(ts->name);
 		free_image(ts->image);
 		free_props(ts->properties);
 		free_tiles(ts->tiles, ts->tilecount);
-		tmx_free_func(ts->tiles);
-		tmx_free_func(ts);
+		ctx_current->free_func(ts->tiles);
+		ctx_current->free_func(ts);
 	}
 }
 
@@ -205,6 +193,265 @@ void free_ts_list(tmx_tileset_list *tsl) {
 		if (tsl->tileset->is_embedded) {
 			free_ts(tsl->tileset);
 		}
-		tmx_free_func(tsl);
+		ctx_current->free_func(tsl);
+	}
+}
+
+/*
+	Arena mode (see tmx_arena_mode)
+
+	Small allocations are bumped from blocks that grow up to ARENA_BLOCK_MAX,
+	each one prefixed with its size for realloc, freeing the last one gives it
+	back. Large allocations (file buffers, gid arrays, layer sources) get a
+	block of their own and are really freed, so the transient buffers of the
+	loader do not stay around for the lifetime of the map.
+	Memory that was allocated before the arena was set up is passed on to the
+	original functions.
+*/
+
+#define ARENA_ALIGN      16
+#define ARENA_BLOCK_SIZE (64*1024)
+#define ARENA_BLOCK_MAX  (4*1024*1024)
+#define ARENA_LARGE      (16*1024)
+#define ARENA_PAD(n)     (((n) + ARENA_ALIGN-1) & ~(size_t)(ARENA_ALIGN-1))
+
+struct arena_block {
+	struct arena_block *next;
+	size_t size, used;
+};
+
+struct arena_large {
+	struct arena_large *prev, *next;
+};
+
+struct arena {
+	struct arena_block *blocks; /* current block first */
+	struct arena_large *large;
+	size_t block_size;
+	void* (*alloc_func)(void *address, size_t len);
+	void  (*free_func)(void *address);
+};
+
+#define BLOCK_HDR ARENA_PAD(sizeof(struct arena_block))
+#define LARGE_HDR ARENA_PAD(sizeof(struct arena_large))
+#define ALLOC_HDR ARENA_ALIGN /* holds the size of a small allocation */
+
+static struct arena_block* arena_find_block(struct arena *a, const void *address) {
+	struct arena_block *b;
+	uintptr_t p = (uintptr_t)address;
+	for (b = a->blocks; b; b = b->next) {
+		if (p > (uintptr_t)b && p < (uintptr_t)b + BLOCK_HDR + b->used) return b;
+	}
+	return NULL;
+}
+
+static struct arena_large* arena_find_large(struct arena *a, const void *address) {
+	struct arena_large *l;
+	for (l = a->large; l; l = l->next) {
+		if ((const char*)l + LARGE_HDR == (const char*)address) return l;
+	}
+	return NULL;
+}
+
+static void* arena_alloc(size_t len) {
+	struct arena *a = (struct arena*)ctx_current->arena;
+	struct arena_block *b = a->blocks;
+	struct arena_large *l;
+	size_t need = ALLOC_HDR + ARENA_PAD(len);
+	char *p;
+
+	if (len > ARENA_LARGE) {
+		if (!(l = (struct arena_large*)a->alloc_func(NULL, LARGE_HDR + len))) return NULL;
+		l->prev = NULL;
+		l->next = a->large;
+		if (a->large) a->large->prev = l;
+		a->large = l;
+		return (char*)l + LARGE_HDR;
+	}
+
+	if (!b || b->size - b->used < need) {
+		if (b && a->block_size < ARENA_BLOCK_MAX) a->block_size *= 2;
+		if (!(b = (struct arena_block*)a->alloc_func(NULL, BLOCK_HDR + a->block_size))) return NULL;
+		b->next = a->blocks;
+		b->size = a->block_size;
+		b->used = 0;
+		a->blocks = b;
+	}
+
+	p = (char*)b + BLOCK_HDR + b->used;
+	*(size_t*)p = len;
+	b->used += need;
+	return p + ALLOC_HDR;
+}
+
+static void arena_free(void *address) {
+	struct arena *a = (struct arena*)ctx_current->arena;
+	struct arena_block *b;
+	struct arena_large *l;
+	size_t need;
+
+	if (!address) return;
+
+	if ((l = arena_find_large(a, address))) {
+		if (l->prev) l->prev->next = l->next;
+		else a->large = l->next;
+		if (l->next) l->next->prev = l->prev;
+		a->free_func(l);
+	}
+	else if ((b = arena_find_block(a, address))) {
+		/* only the last allocation can be given back */
+		need = ALLOC_HDR + ARENA_PAD(*(size_t*)((char*)address - ALLOC_HDR));
+		if ((char*)address - ALLOC_HDR + need == (char*)b + BLOCK_HDR + b->used) b->used -= need;
+	}
+	else {
+		a->free_func(address);
+	}
+}
+
+static void* arena_realloc(void *address, size_t len) {
+	struct arena *a = (struct arena*)ctx_current->arena;
+	struct arena_block *b;
+	struct arena_large *l, *res_l;
+	size_t old_len, need;
+	char *res;
+
+	if (!address) return arena_alloc(len);
+
+	if ((l = arena_find_large(a, address))) {
+		if (!(res_l = (struct arena_large*)a->alloc_func(l, LARGE_HDR + len))) return NULL;
+		if (res_l->prev) res_l->prev->next = res_l;
+		else a->large = res_l;
+		if (res_l->next) res_l->next->prev = res_l;
+		return (char*)res_l + LARGE_HDR;
+	}
+
+	if ((b = arena_find_block(a, address))) {
+		old_len = *(size_t*)((char*)address - ALLOC_HDR);
+		need = ALLOC_HDR + ARENA_PAD(old_len);
+		/* the last allocation grows in place */
+		if (len <= ARENA_LARGE && (char*)address - ALLOC_HDR + need == (char*)b + BLOCK_HDR + b->used &&
+		    b->used - need + ALLOC_HDR + ARENA_PAD(len) <= b->size) {
+			b->used += ARENA_PAD(len) - ARENA_PAD(old_len);
+			*(size_t*)((char*)address - ALLOC_HDR) = len;
+			return address;
+		}
+		if (!(res = (char*)arena_alloc(len))) return NULL;
+		memcpy(res, address, old_len < len ? old_len : len);
+		arena_free(address);
+		return res;
+	}
+
+	return a->alloc_func(address, len);
+}
+
+static void arena_release(struct arena *a) {
+	struct arena_block *b;
+	struct arena_large *l;
+	void (*free_func)(void *address) = a->free_func;
+
+	while ((b = a->blocks)) {
+		a->blocks = b->next;
+		free_func(b);
+	}
+	while ((l = a->large)) {
+		a->large = l->next;
+		free_func(l);
+	}
+	free_func(a);
+}
+
+static void arena_enter(struct arena *a) {
+	a->alloc_func = ctx_current->alloc_func;
+	a->free_func = ctx_current->free_func;
+
+	ctx_current->arena = a;
+	ctx_current->alloc_func = arena_realloc;
+	ctx_current->free_func = arena_free;
+}
+
+void* arena_begin(void) {
+	struct arena *a;
+
+	if (!ctx_current->arena_mode || ctx_current->arena) return NULL;
+
+	if (!(a = (struct arena*)ctx_current->alloc_func(NULL, sizeof(struct arena)))) return NULL;
+	a->blocks = NULL;
+	a->large = NULL;
+	a->block_size = ARENA_BLOCK_SIZE;
+	arena_enter(a);
+
+	return a;
+}
+
+void* arena_resume(tmx_map *map) {
+	struct arena *a = (struct arena*)map->arena;
+
+	if (!a || ctx_current->arena) return NULL;
+
+	map->arena = NULL;
+	arena_enter(a);
+
+	return a;
+}
+
+static void arena_leave(struct arena *a) {
+	ctx_current->alloc_func = a->alloc_func;
+	ctx_current->free_func = a->free_func;
+	ctx_current->arena = NULL;
+}
+
+void* arena_suspend(void) {
+	struct arena *a = (struct arena*)ctx_current->arena;
+
+	if (a) arena_leave(a);
+	return a;
+}
+
+void arena_continue(void *arena) {
+	if (arena) arena_enter((struct arena*)arena);
+}
+
+void arena_end(void *arena, tmx_map *map) {
+	struct arena *a = (struct arena*)arena;
+
+	if (!a) return;
+
+	arena_leave(a);
+
+	if (map) {
+		map->arena = a;
+	} else {
+		arena_release(a);
+	}
+}
+
+static void free_layer_images(tmx_layer *l) {
+	for (; l; l = l->next) {
+		if (l->type == L_IMAGE && l->content.image) {
+			ctx_current->img_free_func(l->content.image->resource_image);
+		}
+		else if (l->type == L_GROUP) {
+			free_layer_images(l->content.group_head);
+		}
 	}
 }
+
+void arena_free_map(tmx_map *map) {
+	tmx_tileset_list *tsl;
+	unsigned int i;
+
+	/* images are the only resources of a map that live outside of its arena */
+	if (ctx_current->img_free_func) {
+		for (tsl = map->ts_head; tsl; tsl = tsl->next) {
+			/* external tilesets of a tileset manager are freed with it */
+			if (!tsl->tileset->is_embedded) continue;
+			if (tsl->tileset->image) ctx_current->img_free_func(tsl->tileset->image->resource_image);
+			for (i=0; i<tsl->tileset->tilecount; i++) {
+				if (tsl->tileset->tiles[i].image) ctx_current->img_free_func(tsl->tileset->tiles[i].image->resource_image);
+			}
+		}
+		free_layer_images(map->ly_head);
+	}
+
+	arena_release((struct arena*)map->arena);
+}
@@ -0,0 +1,193 @@
+/*
+	Compact layer storage
+
+	With tmx_compact_layers set, the gids of a decoded tile layer are moved to
+	the smallest of these forms, the plain int32_t array is kept if none of
+	them is smaller:
+	  - 16-bit gids: the 3 flip bits are moved above a 13-bit gid,
+	  - 8-bit palette: an index per cell into at most 256 distinct gids,
+	  - runs: each row is a list of runs of equal gids, found by bisection.
+	The store is a single allocation (see tmx_get_layer_gid, tmx_get_layer_row).
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tmx.h"
+#include "tsx.h"
+#include "tmx_utils.h"
+
+#define STORE_U16_MAX  0x2000u /* gids that fit in 16 bits along with the flip bits */
+#define STORE_PAL_MAX  256
+#define STORE_PAL_HASH 512     /* open addressing, never more than half full */
+
+enum store_format {SF_U16, SF_PALETTE, SF_RUNS};
+
+struct store_run {
+	uint32_t x; /* first column */
+	int32_t gid;
+};
+
+struct gid_store {
+	enum store_format format;
+	unsigned int width;
+	uint32_t *rows;             /* SF_RUNS: first run of each row, height+1 entries */
+	int32_t palette[STORE_PAL_MAX];
+	union {
+		uint16_t *u16;
+		uint8_t *index;
+		struct store_run *runs;
+	} data;
+};
+
+static uint16_t pack_u16(int32_t gid) {
+	uint32_t g = (uint32_t)gid;
+	return (uint16_t)((g & (STORE_U16_MAX - 1)) | ((g >> 16) & ~(STORE_U16_MAX - 1)));
+}
+
+static int32_t unpack_u16(uint16_t v) {
+	return (int32_t)(((uint32_t)(v & ~(STORE_U16_MAX - 1)) << 16) | (v & (STORE_U16_MAX - 1)));
+}
+
+static unsigned int pal_slot(uint32_t gid) {
+	return (gid * 2654435761u) >> 23; /* 9 bits, see STORE_PAL_HASH */
+}
+
+/* Returns the slot holding `gid` or the empty slot where it goes */
+static unsigned int pal_find(const uint32_t *keys, const uint16_t *used, uint32_t gid) {
+	unsigned int s = pal_slot(gid);
+	while (used[s] && keys[s] != gid) s = (s + 1) & (STORE_PAL_HASH - 1);
+	return s;
+}
+
+int gids_compact(tmx_layer *layer, unsigned int width, unsigned int height) {
+	const int32_t *gids = layer->content.gids;
+	size_t count = (size_t)width * height, i, runs = 0;
+	size_t plain, best, size[3];
+	uint32_t keys[STORE_PAL_HASH];
+	uint16_t used[STORE_PAL_HASH]; /* palette index + 1, 0 for an empty slot */
+	unsigned int distinct = 0, s, x, y;
+	int fits_u16 = 1, format = -1, f;
+	struct gid_store *st;
+	char *p;
+
+	if (!gids || !count) return 1;
+
+	/* measure every form in one pass */
+	memset(used, 0, sizeof(used));
+	for (i = 0; i < count; i++) {
+		if (((uint32_t)gids[i] & TMX_FLIP_BITS_REMOVAL) >= STORE_U16_MAX) fits_u16 = 0;
+		if (i % width == 0 || gids[i] != gids[i-1]) runs++;
+		if (distinct <= STORE_PAL_MAX) {
+			s = pal_find(keys, used, (uint32_t)gids[i]);
+			if (!used[s]) {
+				distinct++;
+				if (distinct <= STORE_PAL_MAX) {
+					keys[s] = (uint32_t)gids[i];
+					used[s] = (uint16_t)distinct;
+				}
+			}
+		}
+	}
+
+	plain = count * sizeof(int32_t);
+	size[SF_U16] = fits_u16 ? count * sizeof(uint16_t) : plain;
+	size[SF_PALETTE] = distinct <= STORE_PAL_MAX ? count : plain;
+	size[SF_RUNS] = runs * sizeof(struct store_run) + (height + 1) * sizeof(uint32_t);
+	for (f = SF_U16, best = plain; f <= SF_RUNS; f++) {
+		if (size[f] < best) {
+			best = size[f];
+			format = f;
+		}
+	}
+	if (format < 0) return 1; /* stays plain */
+
+	if (!(st = (struct gid_store*)ctx_current->alloc_func(NULL, sizeof(struct gid_store) + best))) {
+		tmx_errno = E_ALLOC;
+		return 0;
+	}
+	st->format = (enum store_format)format;
+	st->width = width;
+	st->rows = NULL;
+	p = (char*)(st + 1);
+
+	if (format == SF_U16) {
+		st->data.u16 = (uint16_t*)p;
+		for (i = 0; i < count; i++) st->data.u16[i] = pack_u16(gids[i]);
+	}
+	else if (format == SF_PALETTE) {
+		st->data.index = (uint8_t*)p;
+		for (s = 0; s < STORE_PAL_HASH; s++) {
+			if (used[s]) st->palette[used[s] - 1] = (int32_t)keys[s];
+		}
+		for (i = 0; i < count; i++) {
+			st->data.index[i] = (uint8_t)(used[pal_find(keys, used, (uint32_t)gids[i])] - 1);
+		}
+	}
+	else {
+		/* runs first, they are the aligned part */
+		st->data.runs = (struct store_run*)p;
+		st->rows = (uint32_t*)(p + runs * sizeof(struct store_run));
+		runs = 0;
+		for (y = 0, i = 0; y < height; y++) {
+			st->rows[y] = (uint32_t)runs;
+			for (x = 0; x < width; x++, i++) {
+				if (x == 0 || gids[i] != gids[i-1]) {
+					st->data.runs[runs].x = x;
+					st->data.runs[runs].gid = gids[i];
+					runs++;
+				}
+			}
+		}
+		st->rows[height] = (uint32_t)runs;
+	}
+
+	ctx_current->free_func(layer->content.gids);
+	layer->content.gids = NULL;
+	layer->compact = st;
+	return 1;
+}
+
+/* Returns the run of row `y` that covers column `x` */
+static const struct store_run* store_run(const struct gid_store *st, unsigned int x, unsigned int y) {
+	uint32_t lo = st->rows[y], hi = st->rows[y+1] - 1, mid;
+	while (lo < hi) {
+		mid = (lo + hi + 1) / 2;
+		if (st->data.runs[mid].x <= x) lo = mid;
+		else hi = mid - 1;
+	}
+	return st->data.runs + lo;
+}
+
+int32_t gids_get(const void *store, unsigned int x, unsigned int y) {
+	const struct gid_store *st = (const struct gid_store*)store;
+	size_t i = (size_t)y * st->width + x;
+
+	switch (st->format) {
+		case SF_U16:     return unpack_u16(st->data.u16[i]);
+		case SF_PALETTE: return st->palette[st->data.index[i]];
+		default:         return store_run(st, x, y)->gid;
+	}
+}
+
+void gids_row(const void *store, unsigned int x, unsigned int y, unsigned int count, int32_t *gids) {
+	const struct gid_store *st = (const struct gid_store*)store;
+	const struct store_run *run, *end;
+	size_t i = (size_t)y * st->width + x;
+	unsigned int n, next;
+
+	if (st->format == SF_U16) {
+		for (n = 0; n < count; n++) gids[n] = unpack_u16(st->data.u16[i+n]);
+	}
+	else if (st->format == SF_PALETTE) {
+		for (n = 0; n < count; n++) gids[n] = st->palette[st->data.index[i+n]];
+	}
+	else {
+		run = store_run(st, x, y);
+		end = st->data.runs + st->rows[y+1];
+		for (n = 0; n < count; run++) {
+			next = run + 1 < end ? run[1].x : st->width;
+			for (; n < count && x + n < next; n++) gids[n] = run->gid;
+		}
+	}
+}
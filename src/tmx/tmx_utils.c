@@ -29,7 +29,7 @@ char* b64_encode(const char *source, unsigned int length) {
 		mlen += 4;
 	}
 
-	res = (char*) tmx_alloc_func(NULL, mlen);
+	res = (char*) ctx_current->alloc_func(NULL, mlen);
 	if (!res) {
 		tmx_errno = E_ALLOC;
 		return NULL;
@@ -65,75 +65,219 @@ char* b64_encode(const char *source, unsigned int length) {
 	return res;
 }
 
-static char b64_value(char c) {
-	if (c>='A' && c<='Z') {
-		return c - 'A';
-	} else if (c>='a' && c<='z') {
-		return c - 'a' + 26;
-	} else if (c>='0' && c<='9') {
-		return c - '0' + 52;
-	} else if (c=='+') {
-		return 62;
-	} else if (c=='/') {
-		return 63;
-	} else if (c=='=') {
-		return 0;
+/* decoding table: 6-bit value, B64_PAD for '=', B64_WS for blanks, B64_BAD otherwise */
+#define B64_PAD 0x40
+#define B64_WS  0x80
+#define B64_BAD 0xFF
+
+static const unsigned char b64dec[256] = {
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x80, 0x80, 0x80, 0x80, 0x80, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0x80, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x3E, 0xFF, 0xFF, 0xFF, 0x3F,
+	0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0xFF, 0xFF, 0xFF, 0x40, 0xFF, 0xFF,
+	0xFF, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E,
+	0x0F, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+	0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F, 0x30, 0x31, 0x32, 0x33, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+};
+
+/*
+	Vectorised decoding of runs of base64 characters (W. Mula, D. Lemire,
+	"Faster Base64 Encoding and Decoding Using AVX2 Instructions").
+	Each block decodes whole quartets and returns the number of characters
+	consumed, it stops at the first block that holds anything but base64
+	characters (blanks, padding, invalid characters), the scalar loop handles
+	the rest.
+*/
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define B64_SIMD
+#include <immintrin.h>
+
+#define B64_SIMD_SLACK 8 /* bytes stored past the decoded output */
+
+__attribute__((target("ssse3")))
+static size_t b64_decode_ssse3(const unsigned char *src, size_t len, unsigned char *dst) {
+	const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+	const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m128i mask_2f = _mm_set1_epi8(0x2F);
+	const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+	__m128i str, hi_nibbles, lo_nibbles, lo, hi, roll;
+	size_t i = 0;
+
+	while (len - i >= 16) {
+		str = _mm_loadu_si128((const __m128i*)(src + i));
+
+		/* classify by nibbles, any bit set in both lookups marks a non-base64 character */
+		hi_nibbles = _mm_and_si128(_mm_srli_epi32(str, 4), mask_2f);
+		lo_nibbles = _mm_and_si128(str, mask_2f);
+		lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+		hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128())) != 0xFFFF) break;
+
+		/* ASCII to 6-bit values */
+		roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(_mm_cmpeq_epi8(str, mask_2f), hi_nibbles));
+		str = _mm_add_epi8(str, roll);
+
+		/* pack 4x6 bits into 3 bytes per quartet */
+		str = _mm_maddubs_epi16(str, _mm_set1_epi32(0x01400140));
+		str = _mm_madd_epi16(str, _mm_set1_epi32(0x00011000));
+		_mm_storeu_si128((__m128i*)dst, _mm_shuffle_epi8(str, pack));
+
+		i += 16;
+		dst += 12;
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t b64_decode_avx2(const unsigned char *src, size_t len, unsigned char *dst) {
+	const __m256i lut_lo = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+	                                        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+	const __m256i lut_hi = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+	                                        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m256i lut_roll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+	                                          0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m256i mask_2f = _mm256_set1_epi8(0x2F);
+	const __m256i pack = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+	                                      2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+	const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+	__m256i str, hi_nibbles, lo_nibbles, lo, hi, roll;
+	size_t i = 0;
+
+	while (len - i >= 32) {
+		str = _mm256_loadu_si256((const __m256i*)(src + i));
+
+		hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(str, 4), mask_2f);
+		lo_nibbles = _mm256_and_si256(str, mask_2f);
+		lo = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+		hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+		if (!_mm256_testz_si256(lo, hi)) break;
+
+		roll = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(_mm256_cmpeq_epi8(str, mask_2f), hi_nibbles));
+		str = _mm256_add_epi8(str, roll);
+
+		str = _mm256_maddubs_epi16(str, _mm256_set1_epi32(0x01400140));
+		str = _mm256_madd_epi16(str, _mm256_set1_epi32(0x00011000));
+		str = _mm256_shuffle_epi8(str, pack);
+		_mm256_storeu_si256((__m256i*)dst, _mm256_permutevar8x32_epi32(str, lanes));
+
+		i += 32;
+		dst += 24;
+	}
+	return i;
+}
+
+#else
+#define B64_SIMD_SLACK 0
+#endif /* __GNUC__ && x86 */
+
+/* decoder state, carried across chunks of the source */
+struct b64_state {
+	unsigned int in, quartet, pad;
+	size_t (*simd_decode)(const unsigned char*, size_t, unsigned char*);
+};
+
+static void b64_init(struct b64_state *st) {
+	st->in = st->quartet = st->pad = 0;
+	st->simd_decode = NULL;
+#ifdef B64_SIMD
+	if (__builtin_cpu_supports("avx2")) {
+		st->simd_decode = b64_decode_avx2;
+	} else if (__builtin_cpu_supports("ssse3")) {
+		st->simd_decode = b64_decode_ssse3;
+	}
+#endif
+}
+
+/* decodes `len` chars of `src` into `dst`, which must hold (len/4)*3 + B64_SIMD_SLACK + 3 bytes
+   blanks (as found around and inside the <data> element) are skipped
+   returns the number of bytes written or (size_t)-1 on error */
+static size_t b64_decode_chunk(struct b64_state *st, const unsigned char *src, size_t len, unsigned char *dst) {
+	unsigned char v;
+	size_t i, out = 0, skip;
+
+	for (i=0; i<len; i++) {
+		if (st->simd_decode && st->quartet == 0 && !st->pad) {
+			skip = st->simd_decode(src+i, len-i, dst+out);
+			out += (skip/4)*3;
+			i += skip;
+			if (i == len) break;
+		}
+
+		v = b64dec[src[i]];
+		if (v < B64_PAD) {
+			if (st->pad) {
+				tmx_err(E_BDATA, "Base64: data after padding in source");
+				return (size_t)-1;
+			}
+			st->in = (st->in << 6) | v; /* add 6b */
+		} else if (v == B64_PAD) {
+			if (st->quartet < 2) {
+				tmx_err(E_BDATA, "Base64: misplaced padding in source");
+				return (size_t)-1;
+			}
+			st->in = st->in << 6;
+			st->pad++;
+		} else if (v == B64_WS) {
+			continue;
+		} else {
+			tmx_err(E_BDATA, "Base64: invalid char '%c' in source", src[i]);
+			return (size_t)-1;
+		}
+
+		if (++st->quartet == 4) {
+			dst[out++] = (unsigned char)(st->in >> 16);
+			dst[out++] = (unsigned char)(st->in >> 8);
+			dst[out++] = (unsigned char)st->in;
+			out -= st->pad;
+			st->quartet = 0;
+			st->in = 0;
+		}
 	}
-	return -1;
+	return out;
 }
 
 char* b64_decode(const char *source, unsigned int *rlength) { /* NULL terminated string */
-	char *res, v;
-	short j;
-	unsigned int i;
-	unsigned int in = 0;
-	unsigned int src_len = (unsigned int)(strlen(source));
+	struct b64_state st;
+	unsigned char *res;
+	size_t src_len, out;
 
 	if (!source) {
 		tmx_err(E_INVAL, "Base64: invalid argument: source is NULL");
 		return NULL;
 	}
 
-	if (src_len%4) {
-		tmx_err(E_BDATA, "Base64: invalid source");
-		return NULL; /* invalid source */
-	}
-
-	*rlength = (src_len/4)*3;
-	res = (char*) tmx_alloc_func(NULL, *rlength);
+	src_len = strlen(source);
+	res = (unsigned char*) ctx_current->alloc_func(NULL, (src_len/4)*3 + B64_SIMD_SLACK + 3);
 	if (!res) {
 		tmx_errno = E_ALLOC;
 		return NULL;
 	}
 
-	for (i=0; i<src_len; i+=4) {
-		in = 0;
-
-		for (j=0; j<4; j++) {
-			v = b64_value(source[i+j]);
-			if (v == -1) {
-				tmx_err(E_BDATA, "Base64: invalid char '%c' in source", source[i+j]);
-				goto cleanup;
-			}
-			in = in << 6;
-			in += v; /* add 6b */
-		}
-		for (j=0; j<3; j++) {
-			memcpy(res+(i/4)*3+j, ((char*)&in)+2-j, 1); /* copy 3 bytes in reverse order */
-		}
-	}
+	b64_init(&st);
+	out = b64_decode_chunk(&st, (const unsigned char*)source, src_len, res);
 
-	if (source[src_len-1] == '=') {
-		(*rlength)--;
-	}
-	if (source[src_len-2] == '=') {
-		(*rlength)--;
+	if (out == (size_t)-1) goto cleanup;
+	if (st.quartet != 0) {
+		tmx_err(E_BDATA, "Base64: invalid source");
+		goto cleanup; /* invalid source */
 	}
 
-	return res;
+	*rlength = (unsigned int)out;
+	return (char*)res;
 
 cleanup:
-	tmx_free_func(res);
+	ctx_current->free_func(res);
 	return NULL;
 }
 
@@ -145,11 +289,11 @@ cleanup:
 #include <zlib.h>
 
 void* z_alloc(void *opaque UNUSED, unsigned int items, unsigned int size) {
-	return tmx_alloc_func(NULL, items *size);
+	return ctx_current->alloc_func(NULL, items *size);
 }
 
 void z_free(void *opaque UNUSED, void *address) {
-	tmx_free_func(address);
+	ctx_current->free_func(address);
 }
 
 char* zlib_decompress(const char *source, unsigned int slength, unsigned int rlength) {
@@ -168,7 +312,7 @@ char* zlib_decompress(const char *source, unsigned int slength, unsigned int rle
 	strm.next_in = (Bytef*)source;
 	strm.avail_in = slength;
 
-	res = (char*) tmx_alloc_func(NULL, rlength);
+	res = (char*) ctx_current->alloc_func(NULL, rlength);
 	if (!res) {
 		tmx_errno = E_ALLOC;
 		return NULL;
@@ -201,10 +345,76 @@ char* zlib_decompress(const char *source, unsigned int slength, unsigned int rle
 
 	return res;
 cleanup:
-	tmx_free_func(res);
+	ctx_current->free_func(res);
 	return NULL;
 }
 
+/* base64 chars decoded per step of b64z_decode, the decoded chunk lives on the stack */
+#define B64Z_CHUNK 16384
+
+/* decodes base64 in chunks and inflates each chunk straight into the gids array */
+static int b64z_decode(const char *source, size_t gids_count, int32_t *gids) {
+	unsigned char chunk[(B64Z_CHUNK/4)*3 + B64_SIMD_SLACK + 3];
+	struct b64_state st;
+	size_t src_len, len, out;
+	z_stream strm;
+	int ret;
+
+	if (!source) {
+		tmx_err(E_INVAL, "b64z_decode: invalid argument: source is NULL");
+		return 0;
+	}
+
+	strm.zalloc = z_alloc;
+	strm.zfree = z_free;
+	strm.opaque = Z_NULL;
+	strm.next_in = Z_NULL;
+	strm.avail_in = 0;
+	strm.next_out = (Bytef*)gids;
+	strm.avail_out = (uInt)(gids_count * sizeof(int32_t));
+
+	/* 15+32 to enable zlib and gzip decoding with automatic header detection */
+	if ((ret=inflateInit2(&strm, 15 + 32)) != Z_OK) {
+		tmx_err(E_UNKN, "b64z_decode: inflateInit2 returned %d\n", ret);
+		return 0;
+	}
+
+	b64_init(&st);
+	src_len = strlen(source);
+
+	while (src_len > 0) {
+		len = src_len < B64Z_CHUNK ? src_len : B64Z_CHUNK;
+		if ((out = b64_decode_chunk(&st, (const unsigned char*)source, len, chunk)) == (size_t)-1) {
+			inflateEnd(&strm);
+			return 0;
+		}
+		source += len;
+		src_len -= len;
+
+		strm.next_in = chunk;
+		strm.avail_in = (uInt)out;
+		ret = inflate(&strm, Z_NO_FLUSH);
+		if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+			tmx_err(E_ZDATA, "b64z_decode: inflate returned %d\n", ret);
+			inflateEnd(&strm);
+			return 0;
+		}
+		if (ret == Z_STREAM_END || strm.avail_out == 0) break; /* FIXME There may be remains in the source */
+	}
+	inflateEnd(&strm);
+
+	if (src_len == 0 && st.quartet != 0) {
+		tmx_err(E_BDATA, "Base64: invalid source");
+		return 0;
+	}
+	if (strm.avail_out != 0) {
+		tmx_err(E_ZDATA, "layer contains not enough tiles");
+		return 0;
+	}
+
+	return 1;
+}
+
 #else
 
 char* zlib_decompress(const char *source, unsigned int slength, unsigned int rlength) {
@@ -212,53 +422,239 @@ char* zlib_decompress(const char *source, unsigned int slength, unsigned int rle
 	return NULL;
 }
 
+static int b64z_decode(const char *source UNUSED, size_t gids_count UNUSED, int32_t *gids UNUSED) {
+	tmx_err(E_FONCT, "This library was not built with the zlib/gzip support");
+	return 0;
+}
+
 #endif /* WANT_ZLIB */
 
 /*
 	Layer data decoders
 */
 
-int data_decode(const char *source, enum enccmp_t type, size_t gids_count, int32_t **gids) {
-	char *b64dec;
-	unsigned int b64_len, i;
+/* parses `gids_count` comma separated gids in one pass, blanks are allowed around every gid
+   gids are unsigned as the flip bits use the most significant bit */
+static int csv_decode(const char *source, size_t gids_count, int32_t *gids) {
+	const unsigned char *c = (const unsigned char*)source;
+	uint32_t gid, digit;
+	size_t i;
 
-	if (type==CSV) {
-		if (!(*gids = (int32_t*)tmx_alloc_func(NULL, gids_count * sizeof(int32_t)))) {
-			tmx_errno = E_ALLOC;
+	if (!source) {
+		tmx_err(E_INVAL, "csv_decode: invalid argument: source is NULL");
+		return 0;
+	}
+
+	for (i=0; i<gids_count; i++) {
+		while (*c == ' ' || *c == '\n' || *c == '\r' || *c == '\t') c++;
+
+		if ((digit = (uint32_t)(*c - '0')) > 9) {
+			tmx_err(E_CDATA, "error in CSV while reading tile #%u: expected a digit", (unsigned int)i);
 			return 0;
 		}
-		for (i=0; i<gids_count; i++) {
-			if (sscanf(source, "%d", (*gids)+i) != 1) {
-				tmx_err(E_CDATA, "error in CVS while reading tile #%d", i);
-				return 0;
-			}
-			if (!(source = strchr(source, ',')) && i!=gids_count-1) {
-				tmx_err(E_CDATA, "error in CVS after reading tile #%d", i);
+		gid = 0;
+		do {
+			if (gid > (0xFFFFFFFFu - digit) / 10) {
+				tmx_err(E_CDATA, "error in CSV while reading tile #%u: gid out of range", (unsigned int)i);
 				return 0;
 			}
-			source++;
+			gid = gid * 10 + digit;
+		} while ((digit = (uint32_t)(*++c - '0')) <= 9);
+		gids[i] = (int32_t)gid;
+
+		while (*c == ' ' || *c == '\n' || *c == '\r' || *c == '\t') c++;
+
+		if (*c == ',') {
+			c++;
+		} else if (i != gids_count-1) {
+			tmx_err(E_CDATA, "error in CSV after reading tile #%u: %s", (unsigned int)i, *c ? "expected ','" : "layer contains not enough tiles");
+			return 0;
 		}
 	}
+
+	while (*c == ' ' || *c == '\n' || *c == '\r' || *c == '\t') c++;
+	if (*c) {
+		tmx_err(E_CDATA, "error in CSV after reading tile #%u: layer contains too many tiles", (unsigned int)(gids_count-1));
+		return 0;
+	}
+
+	return 1;
+}
+
+int data_decode(const char *source, enum enccmp_t type, size_t gids_count, int32_t **gids) {
+	int ret = 1, owned = !*gids;
+
+	if (owned && !(*gids = (int32_t*)ctx_current->alloc_func(NULL, gids_count * sizeof(int32_t)))) {
+		tmx_errno = E_ALLOC;
+		return 0;
+	}
+
+	if (type==CSV) {
+		TMX_TRACE("csv_decode", 1);
+		ret = csv_decode(source, gids_count, *gids);
+		TMX_TRACE("csv_decode", 0);
+	}
 	else if (type==B64Z) {
-		if (!(b64dec = b64_decode(source, &b64_len))) return 0;
-		*gids = (int32_t*)zlib_decompress(b64dec, b64_len, (unsigned int)(gids_count*sizeof(int32_t)));
-		tmx_free_func(b64dec);
-		if (!(*gids)) return 0;
+		TMX_TRACE("b64z_decode", 1);
+		ret = b64z_decode(source, gids_count, *gids);
+		TMX_TRACE("b64z_decode", 0);
 	}
 
+	if (!ret && owned) {
+		ctx_current->free_func(*gids);
+		*gids = NULL;
+	}
+	return ret;
+}
+
+/* Source of a layer which has not been decoded yet, see tmx_lazy_layers */
+struct deferred_data {
+	enum enccmp_t type;
+	char source[];
+};
+
+int data_defer(const char *source, enum enccmp_t type, tmx_layer *layer) {
+	struct deferred_data *data;
+	size_t len = strlen(source);
+
+	if (!(data = (struct deferred_data*)ctx_current->alloc_func(NULL, sizeof(struct deferred_data) + len + 1))) {
+		tmx_errno = E_ALLOC;
+		return 0;
+	}
+	data->type = type;
+	memcpy(data->source, source, len + 1);
+	layer->encoded = data;
 	return 1;
 }
 
+int data_resolve(tmx_layer *layer, unsigned int width, unsigned int height) {
+	struct deferred_data *data = (struct deferred_data*)layer->encoded;
+
+	if (!data) return 1;
+
+	/* on error the source is kept, another access reports the same error */
+	if (!data_decode(data->source, data->type, (size_t)width * height, &(layer->content.gids))) return 0;
+	ctx_current->free_func(data);
+	layer->encoded = NULL;
+	return !ctx_current->compact_layers || gids_compact(layer, width, height);
+}
+
+/* One deferred layer decoded by data_resolve_all */
+struct resolve_job {
+	tmx_ctx *ctx;
+	tmx_layer *layer;
+	int32_t *gids;
+	size_t gids_count;
+	int ok;
+	tmx_error_codes err;
+	char msg[sizeof(custom_msg)];
+};
+
+/* Counts the deferred layers in document order, fills `jobs` if not NULL */
+static size_t collect_deferred(tmx_layer *l, struct resolve_job *jobs) {
+	size_t n = 0;
+	for (; l; l = l->next) {
+		if (l->type == L_LAYER && l->encoded) {
+			if (jobs) jobs[n].layer = l;
+			n++;
+		}
+		else if (l->type == L_GROUP) {
+			n += collect_deferred(l->content.group_head, jobs ? jobs + n : NULL);
+		}
+	}
+	return n;
+}
+
+/* May run on any thread: it only decodes into the preallocated gids and
+   keeps its error, tmx_errno, custom_msg and ctx_current are thread local */
+static void resolve_job(int index, void *arg) {
+	struct resolve_job *job = (struct resolve_job*)arg + index;
+	struct deferred_data *data = (struct deferred_data*)job->layer->encoded;
+	tmx_ctx *prev = ctx_current;
+
+	ctx_current = job->ctx;
+	if (!(job->ok = data_decode(data->source, data->type, job->gids_count, &(job->gids)))) {
+		job->err = tmx_errno;
+		memcpy(job->msg, custom_msg, sizeof(job->msg));
+	}
+	ctx_current = prev;
+}
+
+int data_resolve_all(tmx_map *map) {
+	struct resolve_job *jobs;
+	tmx_layer *layer;
+	size_t count, i;
+	void *arena;
+	int ret = 1;
+
+	if (!(count = collect_deferred(map->ly_head, NULL))) return 1;
+
+	if (!(jobs = (struct resolve_job*)ctx_current->alloc_func(NULL, count * sizeof(struct resolve_job)))) {
+		tmx_errno = E_ALLOC;
+		return 0;
+	}
+	collect_deferred(map->ly_head, jobs);
+
+	/* the gids are allocated here, the jobs must not touch the map's arena */
+	for (i = 0; i < count; i++) {
+		jobs[i].ctx = ctx_current;
+		jobs[i].gids_count = (size_t)map->width * map->height;
+		jobs[i].ok = 0;
+		if (!(jobs[i].gids = (int32_t*)ctx_current->alloc_func(NULL, jobs[i].gids_count * sizeof(int32_t)))) {
+			tmx_errno = E_ALLOC;
+			while (i--) ctx_current->free_func(jobs[i].gids);
+			ctx_current->free_func(jobs);
+			return 0;
+		}
+	}
+
+	TMX_TRACE("data_resolve_all", 1);
+	if (ctx_current->parallel_func && count > 1) {
+		arena = arena_suspend();
+		ctx_current->parallel_func(resolve_job, (int)count, jobs);
+		arena_continue(arena);
+	}
+	else {
+		for (i = 0; i < count; i++) resolve_job((int)i, jobs);
+	}
+	TMX_TRACE("data_resolve_all", 0);
+
+	/* the first layer in document order that failed is reported */
+	for (i = 0; i < count; i++) {
+		layer = jobs[i].layer;
+		layer->content.gids = jobs[i].gids;
+		if (!ret) continue;
+		if (!jobs[i].ok) {
+			tmx_errno = jobs[i].err;
+			memcpy(custom_msg, jobs[i].msg, sizeof(custom_msg));
+			ret = 0;
+			continue;
+		}
+		ctx_current->free_func(layer->encoded);
+		layer->encoded = NULL;
+		if (ctx_current->compact_layers && !gids_compact(layer, map->width, map->height)) ret = 0;
+	}
+
+	ctx_current->free_func(jobs);
+	return ret;
+}
+
 /*
 	Misc
 */
 
 void map_post_parsing(tmx_map **map) {
+	if (*map && !ctx_current->lazy_layers && !data_resolve_all(*map)) {
+		tmx_map_free(*map);
+		*map = NULL;
+	}
 	if (*map) {
+		TMX_TRACE("mk_map_tile_array", 1);
 		if (!mk_map_tile_array(*map)) {
 			tmx_map_free(*map);
 			*map = NULL;
 		}
+		TMX_TRACE("mk_map_tile_array", 0);
 	}
 }
 
@@ -331,7 +727,7 @@ int mk_map_tile_array(tmx_map *map) {
 	}
 
 	/* Allocates the GID indexed tile array */
-	if (!(map->tiles = tmx_alloc_func(NULL, map->tilecount * sizeof(void*)))) {
+	if (!(map->tiles = ctx_current->alloc_func(NULL, map->tilecount * sizeof(void*)))) {
 		tmx_errno = E_ALLOC;
 		return 0;
 	}
@@ -526,7 +922,11 @@ char* str_trim(char *str) {
 
 /* duplicate a string */
 char* tmx_strdup(const char *str) {
-	char *res =  (char*)tmx_alloc_func(NULL, strlen(str)+1);
+	char *res =  (char*)ctx_current->alloc_func(NULL, strlen(str)+1);
+	if (!res) {
+		tmx_errno = E_ALLOC;
+		return NULL;
+	}
 	strcpy(res, str);
 	return res;
 }
@@ -552,7 +952,7 @@ char* mk_absolute_path(const char *base_path, const char *rel_path) {
 	size_t rp_len = strlen(rel_path);
 	size_t ap_len = dp_len + rp_len;
 
-	char* res = (char*)tmx_alloc_func(NULL, ap_len+1);
+	char* res = (char*)ctx_current->alloc_func(NULL, ap_len+1);
 	if (!res) {
 		tmx_errno = E_ALLOC;
 		return NULL;
@@ -568,11 +968,11 @@ char* mk_absolute_path(const char *base_path, const char *rel_path) {
 /* resolves the path to the image, and delegates to the client code */
 void* load_image(void **ptr, const char *base_path, const char *rel_path) {
 	char *ap_img;
-	if (tmx_img_load_func) {
+	if (ctx_current->img_load_func) {
 		ap_img = mk_absolute_path(base_path, rel_path);
 		if (!ap_img) return 0;
-		*ptr = tmx_img_load_func(ap_img);
-		tmx_free_func(ap_img);
+		*ptr = ctx_current->img_load_func(ap_img);
+		ctx_current->free_func(ap_img);
 		return(*ptr);
 	}
 	return (void*)1;
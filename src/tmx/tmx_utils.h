@@ -29,11 +29,24 @@ tmx_tileset* parse_tsx_xml_fd(int fd);
 tmx_tileset* parse_tsx_xml_callback(tmx_read_functor callback, void *userdata);
 
 /*
-	Memory management, node allocation and free - tmx_mem.c
+	Binary map loader - tmx_bin.c
+*/
+tmx_map* parse_bin(tmx_tileset_manager *ts_mgr, const char *path);
+
+/*
+	Loader context - tmx_ctx.c
 */
-void set_alloc_functions();
-void setup_libxml_mem();
+/* Context of the current call, read by all the functions below */
+extern TMXTLS tmx_ctx *ctx_current;
+/* Makes `ctx` current, or a copy of the configuration globals if `ctx` is
+   NULL and no context is current yet, returns the context to restore */
+tmx_ctx* ctx_enter(tmx_ctx *ctx);
+/* Restores `prev`, the error is stored in the context if `ok` is 0 */
+void ctx_leave(tmx_ctx *prev, int ok);
 
+/*
+	Memory management, node allocation and free - tmx_mem.c
+*/
 tmx_property*     alloc_prop(void);
 tmx_image*        alloc_image(void);
 tmx_shape*        alloc_shape(void);
@@ -57,13 +70,45 @@ void free_tiles(tmx_tile *t, int tilecount);
 void free_ts(tmx_tileset *ts);
 void free_ts_list(tmx_tileset_list *tsl);
 
+/* Arena mode, returns NULL if tmx_arena_mode is off, arena_end hands the
+   arena over to the map or releases it if map is NULL, arena_resume takes
+   the arena back from a loaded map (NULL if it has none) */
+void* arena_begin(void);
+void* arena_resume(tmx_map *map);
+/* Steps out of the current arena for a while, while other threads allocate */
+void* arena_suspend(void);
+void  arena_continue(void *arena);
+void  arena_end(void *arena, tmx_map *map);
+void  arena_free_map(tmx_map *map);
+
 /*
 	Misc - tmx_utils.c
 */
 #define MAX(a,b) (a<b) ? b: a;
 
+/* Reports a loader phase to tmx_trace_func, if set */
+#define TMX_TRACE(name, begin) do { if (ctx_current->trace_func) ctx_current->trace_func(name, begin); } while (0)
+
+char* b64_encode(const char *source, unsigned int length);
+char* b64_decode(const char *source, unsigned int *rlength);
+char* zlib_decompress(const char *source, unsigned int slength, unsigned int rlength);
+
 enum enccmp_t {CSV, B64Z};
 int data_decode(const char *source, enum enccmp_t type, size_t gids_count, int32_t **gids);
+/* Deferred layers, data_defer keeps a copy of the source in layer->encoded,
+   data_resolve decodes it into layer->content.gids and drops the copy */
+#define DATA_DEFERRED (ctx_current->lazy_layers || ctx_current->parallel_func)
+int data_defer(const char *source, enum enccmp_t type, tmx_layer *layer);
+int data_resolve(tmx_layer *layer, unsigned int width, unsigned int height);
+/* Decodes all the deferred layers of a map, see tmx_parallel_func */
+int data_resolve_all(tmx_map *map);
+
+/*
+	Compact layer storage - tmx_store.c
+*/
+int     gids_compact(tmx_layer *layer, unsigned int width, unsigned int height);
+int32_t gids_get(const void *store, unsigned int x, unsigned int y);
+void    gids_row(const void *store, unsigned int x, unsigned int y, unsigned int count, int32_t *gids);
 
 void map_post_parsing(tmx_map **map);
 int set_tiles_runtime_props(tmx_tileset *ts);
@@ -96,11 +141,14 @@ typedef void (*hashtable_entry_deallocator)(void *val, const char *key);
 typedef void (*hashtable_foreach_functor)(void *val, void *userdata, const char *key);
 
 void* mk_hashtable(unsigned int initial_size);
-void  hashtable_set(void *hashtable, const char *key, void *val, hashtable_entry_deallocator deallocator);
+int   hashtable_set(void *hashtable, const char *key, void *val, hashtable_entry_deallocator deallocator);
 void* hashtable_get(void *hashtable, const char *key);
 void  hashtable_rm(void *hashtable, const char *key, hashtable_entry_deallocator deallocator);
 void  hashtable_foreach(void *hashtable, hashtable_foreach_functor functor, void *userdata);
 void  free_hashtable(void *hashtable, hashtable_entry_deallocator deallocator);
+/* Context a tileset manager was made with, NULL for the globals */
+void     hashtable_set_owner(void *hashtable, tmx_ctx *owner);
+tmx_ctx* hashtable_owner(void *hashtable);
 
 void property_deallocator(void *val, const char *key);
 void tileset_deallocator(void *val, const char *key);
@@ -112,7 +160,7 @@ void tileset_deallocator(void *val, const char *key);
 #define snprintf _snprintf
 #endif
 
-char custom_msg[256];
+extern TMXTLS char custom_msg[256];
 #define tmx_err(code, ...) tmx_errno = code; snprintf(custom_msg, 256, __VA_ARGS__)
 
 #endif /* TMXUTILS_H */
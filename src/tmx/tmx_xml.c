@@ -38,40 +38,68 @@ static int check_reader(xmlTextReaderPtr reader) {
 	return 1;
 }
 
+/* libxml2 allocates with its own functions, the strings kept in the map
+   are copied with the functions of the current context */
+static char* xml_string(xmlChar *str) {
+	char *res;
+	if (!str) return NULL;
+	res = tmx_strdup((const char*)str);
+	xmlFree(str);
+	return res;
+}
+
+static char* get_attribute(xmlTextReaderPtr reader, const char *name) {
+	return xml_string(xmlTextReaderGetAttribute(reader, (const xmlChar*)name));
+}
+
+static char* read_inner_xml(xmlTextReaderPtr reader) {
+	return xml_string(xmlTextReaderReadInnerXml(reader));
+}
+
+/* opens a file using tmx_file_read_func if set, from disk otherwise */
+static xmlTextReaderPtr open_reader(const char *filename) {
+	const char *buffer;
+	int len;
+	if (ctx_current->file_read_func && (buffer = ctx_current->file_read_func(filename, &len))) {
+		return xmlReaderForMemory(buffer, len, filename, NULL, 0);
+	}
+	return xmlReaderForFile(filename, NULL, 0);
+}
+
 static int parse_property(xmlTextReaderPtr reader, tmx_property *prop) {
 	char *value;
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"name"))) { /* name */
+	if ((value = get_attribute(reader, "name"))) { /* name */
 		prop->name = value;
 	} else {
 		tmx_err(E_MISSEL, "xml parser: missing 'name' attribute in the 'property' element");
 		return 0;
 	}
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*) "type"))) { /* type */
+	if ((value = get_attribute(reader, "type"))) { /* type */
 		prop->type = parse_property_type(value);
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	} else {
 		prop->type = PT_STRING;
 	}
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*) "value"))) { /* source */
+	if ((value = get_attribute(reader, "value"))) { /* source */
 		switch (prop->type) {
 			case PT_INT:
 				prop->value.integer = atoi(value);
-				tmx_free_func(value);
+				ctx_current->free_func(value);
 				break;
 			case PT_FLOAT:
 				prop->value.decimal = atof(value);
-				tmx_free_func(value);
+				ctx_current->free_func(value);
 				break;
 			case PT_BOOL:
 				prop->value.integer = parse_boolean(value);
-				tmx_free_func(value);
+				ctx_current->free_func(value);
 				break;
 			case PT_COLOR:
 				prop->value.integer = get_color_rgb(value);
-				tmx_free_func(value);
+				ctx_current->free_func(value);
 				break;
 			case PT_NONE:
 			case PT_STRING:
@@ -81,7 +109,7 @@ static int parse_property(xmlTextReaderPtr reader, tmx_property *prop) {
 				break;
 		}
 	} else if (prop->type == PT_NONE || prop->type == PT_STRING) {
-		if (!(value = (char*)xmlTextReaderReadInnerXml(reader))) {
+		if (!(value = read_inner_xml(reader))) {
 			tmx_err(E_MISSEL, "xml parser: missing 'value' attribute or inner XML for the 'property' element");
 		}
 		prop->value.string = value;
@@ -128,22 +156,22 @@ static int parse_points(xmlTextReaderPtr reader, tmx_shape *shape) {
 	char *value, *v;
 	int i;
 
-	if (!(value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"points"))) { /* points */
+	if (!(value = get_attribute(reader, "points"))) { /* points */
 		tmx_err(E_MISSEL, "xml parser: missing 'points' attribute in the 'object' element");
 		return 0;
 	}
 
 	shape->points_len = 1 + count_char_occurences(value, ' ');
 
-	shape->points = (double**)tmx_alloc_func(NULL, shape->points_len * sizeof(double*)); /* points[i][x,y] */
+	shape->points = (double**)ctx_current->alloc_func(NULL, shape->points_len * sizeof(double*)); /* points[i][x,y] */
 	if (!(shape->points)) {
 		tmx_errno = E_ALLOC;
 		return 0;
 	}
 
-	shape->points[0] = (double*)tmx_alloc_func(NULL, shape->points_len * 2 * sizeof(double));
+	shape->points[0] = (double*)ctx_current->alloc_func(NULL, shape->points_len * 2 * sizeof(double));
 	if (!(shape->points[0])) {
-		tmx_free_func(shape->points);
+		ctx_current->free_func(shape->points);
 		tmx_errno = E_ALLOC;
 		return 0;
 	}
@@ -161,70 +189,70 @@ static int parse_points(xmlTextReaderPtr reader, tmx_shape *shape) {
 		v = 1 + strchr(v, ' ');
 	}
 
-	tmx_free_func(value);
+	ctx_current->free_func(value);
 	return 1;
 }
 
 static int parse_text(xmlTextReaderPtr reader, tmx_text *text) {
 	char *value;
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"fontfamily"))) { /* fontfamily */
+	if ((value = get_attribute(reader, "fontfamily"))) { /* fontfamily */
 		text->fontfamily = value;
 	} else {
 		text->fontfamily = tmx_strdup("sans-serif");
 	}
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"pixelsize"))) { /* pixelsize */
+	if ((value = get_attribute(reader, "pixelsize"))) { /* pixelsize */
 		text->pixelsize = (int)atoi(value);
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	}
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"color"))) { /* color */
+	if ((value = get_attribute(reader, "color"))) { /* color */
 		text->color = get_color_rgb(value);
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	}
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"wrap"))) { /* wrap */
+	if ((value = get_attribute(reader, "wrap"))) { /* wrap */
 		text->color = (int)atoi(value);
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	}
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"bold"))) { /* bold */
+	if ((value = get_attribute(reader, "bold"))) { /* bold */
 		text->bold = (int)atoi(value);
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	}
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"italic"))) { /* italic */
+	if ((value = get_attribute(reader, "italic"))) { /* italic */
 		text->italic = (int)atoi(value);
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	}
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"underline"))) { /* underline */
+	if ((value = get_attribute(reader, "underline"))) { /* underline */
 		text->underline = (int)atoi(value);
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	}
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"strikeout"))) { /* strikeout */
+	if ((value = get_attribute(reader, "strikeout"))) { /* strikeout */
 		text->strikeout = (int)atoi(value);
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	}
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"kerning"))) { /* kerning */
+	if ((value = get_attribute(reader, "kerning"))) { /* kerning */
 		text->kerning = (int)atoi(value);
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	}
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"halign"))) { /* halign */
+	if ((value = get_attribute(reader, "halign"))) { /* halign */
 		text->halign = parse_horizontal_align(value);
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	}
 	
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"valign"))) { /* valign */
+	if ((value = get_attribute(reader, "valign"))) { /* valign */
 		text->valign = parse_vertical_align(value);
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	}
 
-	if ((value = (char*)xmlTextReaderReadInnerXml(reader))) {
+	if ((value = read_inner_xml(reader))) {
 		text->text = value;
 	}
 
@@ -237,63 +265,63 @@ static int parse_object(xmlTextReaderPtr reader, tmx_object *obj) {
 	char *value;
 
 	/* parses each attribute */
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"id"))) { /* id */
+	if ((value = get_attribute(reader, "id"))) { /* id */
 		obj->id = atoi(value);
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	} else {
 		tmx_err(E_MISSEL, "xml parser: missing 'id' attribute in the 'object' element");
 		return 0;
 	}
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"x"))) { /* x */
+	if ((value = get_attribute(reader, "x"))) { /* x */
 		obj->x = atof(value);
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	} else {
 		tmx_err(E_MISSEL, "xml parser: missing 'x' attribute in the 'object' element");
 		return 0;
 	}
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"y"))) { /* y */
+	if ((value = get_attribute(reader, "y"))) { /* y */
 		obj->y = atof(value);
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	} else {
 		tmx_err(E_MISSEL, "xml parser: missing 'y' attribute in the 'object' element");
 		return 0;
 	}
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"name"))) { /* name */
+	if ((value = get_attribute(reader, "name"))) { /* name */
 		obj->name = value;
 	}
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"type"))) { /* type */
+	if ((value = get_attribute(reader, "type"))) { /* type */
 		obj->type = value;
 	}
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"visible"))) { /* visible */
+	if ((value = get_attribute(reader, "visible"))) { /* visible */
 		obj->visible = (char)atoi(value);
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	}
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"height"))) { /* height */
+	if ((value = get_attribute(reader, "height"))) { /* height */
 		obj->obj_type = OT_SQUARE;
 		obj->height = atof(value);
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	}
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"width"))) { /* width */
+	if ((value = get_attribute(reader, "width"))) { /* width */
 		obj->width = atof(value);
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	}
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"gid"))) { /* gid */
+	if ((value = get_attribute(reader, "gid"))) { /* gid */
 		obj->obj_type = OT_TILE;
 		obj->content.gid = atoi(value);
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	}
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"rotation"))) { /* rotation */
+	if ((value = get_attribute(reader, "rotation"))) { /* rotation */
 		obj->rotation = atof(value);
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	}
 
 	/* If it has a child, then it's a polygon or a polyline or an ellipse */
@@ -334,23 +362,30 @@ static int parse_object(xmlTextReaderPtr reader, tmx_object *obj) {
 	return 1;
 }
 
-static int parse_data(xmlTextReaderPtr reader, int32_t **gidsadr, size_t gidscount) {
-	char *value, *inner_xml;
+/* returns the text of the current element without copying it, NULL if it is not a single text node */
+static const char* element_text(xmlTextReaderPtr reader) {
+	xmlNodePtr node;
 
-	if (!(value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"encoding"))) { /* encoding */
-		tmx_err(E_MISSEL, "xml parser: missing 'encoding' attribute in the 'data' element");
-		return 0;
-	}
+	if (!(node = xmlTextReaderExpand(reader))) return NULL;
+	node = node->children;
+	if (!node || node->next || (node->type != XML_TEXT_NODE && node->type != XML_CDATA_SECTION_NODE)) return NULL;
+
+	return (const char*)node->content;
+}
 
-	if (!(inner_xml = (char*)xmlTextReaderReadInnerXml(reader))) {
-		tmx_err(E_XDATA, "xml parser: missing content in the 'data' element");
-		tmx_free_func(value);
+static int parse_data(xmlTextReaderPtr reader, tmx_layer *layer, size_t gidscount) {
+	char *value;
+	xmlChar *inner_xml = NULL; /* freed with xmlFree, never kept */
+	const char *text;
+
+	if (!(value = get_attribute(reader, "encoding"))) { /* encoding */
+		tmx_err(E_MISSEL, "xml parser: missing 'encoding' attribute in the 'data' element");
 		return 0;
 	}
 
 	if (!strcmp(value, "base64")) {
-		tmx_free_func(value);
-		if (!(value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"compression"))) { /* compression */
+		ctx_current->free_func(value);
+		if (!(value = get_attribute(reader, "compression"))) { /* compression */
 			tmx_err(E_MISSEL, "xml parser: missing 'compression' attribute in the 'data' element");
 			goto cleanup;
 		}
@@ -358,24 +393,39 @@ static int parse_data(xmlTextReaderPtr reader, int32_t **gidsadr, size_t gidscou
 			tmx_err(E_ENCCMP, "xml parser: unsupported data compression: '%s'", value); /* unsupported compression */
 			goto cleanup;
 		}
-		if (!data_decode(str_trim(inner_xml), B64Z, gidscount, gidsadr)) goto cleanup;
+		/* decoded straight from the parsed text node, the reader holds it anyway */
+		if (!(text = element_text(reader))) {
+			if (!(inner_xml = xmlTextReaderReadInnerXml(reader))) {
+				tmx_err(E_XDATA, "xml parser: missing content in the 'data' element");
+				goto cleanup;
+			}
+			text = (const char*)inner_xml;
+		}
+		if (!(DATA_DEFERRED ? data_defer(text, B64Z, layer) : data_decode(text, B64Z, gidscount, &(layer->content.gids)))) goto cleanup;
 
 	} else if (!strcmp(value, "xml")) {
 		tmx_err(E_ENCCMP, "xml parser: unimplemented data encoding: XML");
 		goto cleanup;
 	} else if (!strcmp(value, "csv")) {
-		if (!data_decode(str_trim(inner_xml), CSV, gidscount, gidsadr)) goto cleanup;
+		if (!(text = element_text(reader))) {
+			if (!(inner_xml = xmlTextReaderReadInnerXml(reader))) {
+				tmx_err(E_XDATA, "xml parser: missing content in the 'data' element");
+				goto cleanup;
+			}
+			text = (const char*)inner_xml;
+		}
+		if (!(DATA_DEFERRED ? data_defer(text, CSV, layer) : data_decode(text, CSV, gidscount, &(layer->content.gids)))) goto cleanup;
 	} else {
 		tmx_err(E_ENCCMP, "xml parser: unknown data encoding: %s", value);
 		goto cleanup;
 	}
-	tmx_free_func(value);
-	tmx_free_func(inner_xml);
+	ctx_current->free_func(value);
+	xmlFree(inner_xml);
 	return 1;
 
 cleanup:
-	tmx_free_func(value);
-	tmx_free_func(inner_xml);
+	ctx_current->free_func(value);
+	xmlFree(inner_xml);
 	return 0;
 }
 
@@ -386,7 +436,7 @@ static int parse_image(xmlTextReaderPtr reader, tmx_image **img_adr, short stric
 	if (!(res = alloc_image())) return 0;
 	*img_adr = res;
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"source"))) { /* source */
+	if ((value = get_attribute(reader, "source"))) { /* source */
 		res->source = value;
 		if (!(load_image(&(res->resource_image), filename, value))) {
 			tmx_err(E_UNKN, "xml parser: an error occured in the delegated image loading function");
@@ -397,26 +447,26 @@ static int parse_image(xmlTextReaderPtr reader, tmx_image **img_adr, short stric
 		return 0;
 	}
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"height"))) { /* height */
+	if ((value = get_attribute(reader, "height"))) { /* height */
 		res->height = atoi(value);
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	} else if (strict) {
 		tmx_err(E_MISSEL, "xml parser: missing 'height' attribute in the 'image' element");
 		return 0;
 	}
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"width"))) { /* width */
+	if ((value = get_attribute(reader, "width"))) { /* width */
 		res->width = atoi(value);
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	} else if (strict) {
 		tmx_err(E_MISSEL, "xml parser: missing 'width' attribute in the 'image' element");
 		return 0;
 	}
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"trans"))) { /* trans */
+	if ((value = get_attribute(reader, "trans"))) { /* trans */
 		res->trans = get_color_rgb(value);
 		res->uses_trans = 1;
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	}
 
 	return 1;
@@ -441,31 +491,31 @@ static int parse_layer(xmlTextReaderPtr reader, tmx_layer **layer_headadr, int m
 	*layer_headadr = res;
 
 	/* parses each attribute */
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"name"))) { /* name */
+	if ((value = get_attribute(reader, "name"))) { /* name */
 		res->name = value;
 	} else {
 		tmx_err(E_MISSEL, "xml parser: missing 'name' attribute in the 'layer' element");
 		return 0;
 	}
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"visible"))) { /* visible */
+	if ((value = get_attribute(reader, "visible"))) { /* visible */
 		res->visible = (char)atoi(value);
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	}
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"opacity"))) { /* opacity */
+	if ((value = get_attribute(reader, "opacity"))) { /* opacity */
 		res->opacity = atof(value);
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	}
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"offsetx"))) { /* offsetx */
+	if ((value = get_attribute(reader, "offsetx"))) { /* offsetx */
 		res->offsetx = (int)atoi(value);
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	}
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"offsety"))) { /* offsety */
+	if ((value = get_attribute(reader, "offsety"))) { /* offsety */
 		res->offsety = (int)atoi(value);
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	}
 
 	/* objectgroups have more properties */
@@ -473,14 +523,14 @@ static int parse_layer(xmlTextReaderPtr reader, tmx_layer **layer_headadr, int m
 		tmx_object_group *objgr = alloc_objgr();
 		res->content.objgr = objgr;
 
-		if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"color"))) { /* color */
+		if ((value = get_attribute(reader, "color"))) { /* color */
 			objgr->color = get_color_rgb(value);
-			tmx_free_func(value);
+			ctx_current->free_func(value);
 		}
 
-		value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"draworder"); /* draworder */
+		value = get_attribute(reader, "draworder"); /* draworder */
 		objgr->draworder = parse_objgr_draworder(value);
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	}
 
 	if (type == L_OBJGR && xmlTextReaderIsEmptyElement(reader)) {
@@ -495,7 +545,8 @@ static int parse_layer(xmlTextReaderPtr reader, tmx_layer **layer_headadr, int m
 			if (!strcmp(name, "properties")) {
 				if (!parse_properties(reader, &(res->properties))) return 0;
 			} else if (!strcmp(name, "data")) {
-				if (!parse_data(reader, &(res->content.gids), map_h * map_w)) return 0;
+				if (!parse_data(reader, res, map_h * map_w)) return 0;
+				if (ctx_current->compact_layers && !gids_compact(res, map_w, map_h)) return 0;
 			} else if (!strcmp(name, "image")) {
 				if (!parse_image(reader, &(res->content.image), 0, filename)) return 0;
 			} else if (!strcmp(name, "object")) {
@@ -520,17 +571,17 @@ static int parse_layer(xmlTextReaderPtr reader, tmx_layer **layer_headadr, int m
 
 static int parse_tileoffset(xmlTextReaderPtr reader, int *x, int *y) {
 	char *value;
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"x"))) { /* x offset */
+	if ((value = get_attribute(reader, "x"))) { /* x offset */
 		*x = atoi(value);
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	} else {
 		tmx_err(E_MISSEL, "xml parser: missing 'x' attribute in the 'tileoffset' element");
 		return 0;
 	}
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"y"))) { /* y offset */
+	if ((value = get_attribute(reader, "y"))) { /* y offset */
 		*y = atoi(value);
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	} else {
 		tmx_err(E_MISSEL, "xml parser: missing 'y' attribute in the 'tileoffset' element");
 		return 0;
@@ -554,18 +605,18 @@ static tmx_anim_frame* parse_animation(xmlTextReaderPtr reader, int frame_count,
 		return 0;
 	}
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"tileid"))) { /* tileid */
+	if ((value = get_attribute(reader, "tileid"))) { /* tileid */
 		frame.tile_id = atoi(value);
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	}
 	else {
 		tmx_err(E_MISSEL, "xml parser: missing 'tileid' attribute in the 'frame' element");
 		return 0;
 	}
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"duration"))) { /* duration */
+	if ((value = get_attribute(reader, "duration"))) { /* duration */
 		frame.duration = atoi(value);
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	}
 	else {
 		tmx_err(E_MISSEL, "xml parser: missing 'duration' attribute in the 'frame' element");
@@ -582,7 +633,7 @@ static tmx_anim_frame* parse_animation(xmlTextReaderPtr reader, int frame_count,
 
 	/* no more frames, alloc on the heap and returns */
 	if (xmlTextReaderNodeType(reader) == XML_READER_TYPE_END_ELEMENT && xmlTextReaderDepth(reader) < curr_depth) {
-		res = (tmx_anim_frame*)tmx_alloc_func(NULL, (frame_count+1) * sizeof(tmx_anim_frame));
+		res = (tmx_anim_frame*)ctx_current->alloc_func(NULL, (frame_count+1) * sizeof(tmx_anim_frame));
 		if (res == NULL) {
 			tmx_err(E_ALLOC, "xml parser: failed to alloc %d animation frames", frame_count+1);
 			return NULL;
@@ -615,7 +666,7 @@ static int parse_tile(xmlTextReaderPtr reader, tmx_tileset *tileset, const char
 
 	curr_depth = xmlTextReaderDepth(reader);
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"id"))) { /* id */
+	if ((value = get_attribute(reader, "id"))) { /* id */
 		id = atoi(value);
 		/* Insertion sort */
 		len = tileset->user_data.integer;
@@ -638,14 +689,14 @@ static int parse_tile(xmlTextReaderPtr reader, tmx_tileset *tileset, const char
 		/* --- */
 		res->id = id;
 		res->tileset = tileset;
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	}
 	else {
 		tmx_err(E_MISSEL, "xml parser: missing 'id' attribute in the 'tile' element");
 		return 0;
 	}
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"type"))) { /* type */
+	if ((value = get_attribute(reader, "type"))) { /* type */
 		res->type = value;
 	}
 
@@ -712,45 +763,45 @@ static int parse_tileset(xmlTextReaderPtr reader, tmx_tileset *ts_addr, const ch
 	curr_depth = xmlTextReaderDepth(reader);
 
 	/* parses each attribute */
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"name"))) { /* name */
+	if ((value = get_attribute(reader, "name"))) { /* name */
 		ts_addr->name = value;
 	} else {
 		tmx_err(E_MISSEL, "xml parser: missing 'name' attribute in the 'tileset' element");
 		return 0;
 	}
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"tilecount"))) { /* tilecount */
+	if ((value = get_attribute(reader, "tilecount"))) { /* tilecount */
 		ts_addr->tilecount = atoi(value);
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	} else {
 		tmx_err(E_MISSEL, "xml parser: missing 'tilecount' attribute in the 'tileset' element");
 		return 0;
 	}
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"tilewidth"))) { /* tile_width */
+	if ((value = get_attribute(reader, "tilewidth"))) { /* tile_width */
 		ts_addr->tile_width = atoi(value);
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	} else {
 		tmx_err(E_MISSEL, "xml parser: missing 'tilewidth' attribute in the 'tileset' element");
 		return 0;
 	}
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"tileheight"))) { /* tile_height */
+	if ((value = get_attribute(reader, "tileheight"))) { /* tile_height */
 		ts_addr->tile_height = atoi(value);
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	} else {
 		tmx_err(E_MISSEL, "xml parser: missing 'tileheight' attribute in the 'tileset' element");
 		return 0;
 	}
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"spacing"))) { /* spacing */
+	if ((value = get_attribute(reader, "spacing"))) { /* spacing */
 		ts_addr->spacing = atoi(value);
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	}
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"margin"))) { /* margin */
+	if ((value = get_attribute(reader, "margin"))) { /* margin */
 		ts_addr->margin = atoi(value);
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	}
 
 	if (!(ts_addr->tiles = alloc_tiles(ts_addr->tilecount))) return 0;
@@ -782,56 +833,71 @@ static int parse_tileset(xmlTextReaderPtr reader, tmx_tileset *ts_addr, const ch
 	return 1;
 }
 
+/* Parses the tsx file `source` refers to, relative to `filename` */
+static int parse_extern_tileset(tmx_tileset *res, const char *filename, const char *source) {
+	int ret;
+	char *ab_path;
+	xmlTextReaderPtr sub_reader;
+
+	if (!(ab_path = mk_absolute_path(filename, source))) return 0;
+	if (!(sub_reader = open_reader(ab_path)) || !check_reader(sub_reader)) { /* opens */
+		tmx_err(E_XDATA, "xml parser: cannot open extern tileset '%s'", ab_path);
+		ctx_current->free_func(ab_path);
+		return 0;
+	}
+	ret = parse_tileset(sub_reader, res, ab_path); /* and parses the tsx file */
+	xmlFreeTextReader(sub_reader);
+	ctx_current->free_func(ab_path);
+	return ret;
+}
+
 static int parse_tileset_list(xmlTextReaderPtr reader, tmx_tileset_list **ts_headadr, tmx_tileset_manager *ts_mgr, const char *filename) {
 	tmx_tileset_list *res_list = NULL;
 	tmx_tileset *res = NULL;
 	int ret;
-	char *value, *ab_path;
-	xmlTextReaderPtr sub_reader;
+	char *value;
+	void *arena;
 
 	if (!(res_list = alloc_tileset_list())) return 0;
 	res_list->next = *ts_headadr;
 	*ts_headadr = res_list;
 
 	/* parses each attribute */
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"firstgid"))) { /* fisrtgid */
+	if ((value = get_attribute(reader, "firstgid"))) { /* fisrtgid */
 		res_list->firstgid = atoi(value);
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	} else {
 		tmx_err(E_MISSEL, "xml parser: missing 'firstgid' attribute in the 'tileset' element");
 		return 0;
 	}
 
 	/* External Tileset */
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"source"))) { /* source */
+	if ((value = get_attribute(reader, "source"))) { /* source */
 		if (ts_mgr) {
 			res = (tmx_tileset*) hashtable_get((void*)ts_mgr, value);
-			if (res) {
-				res_list->tileset = res;
-				return 1;
+			ret = 1;
+			if (!res) {
+				/* the tileset belongs to the manager, not to the arena of the map */
+				arena = arena_suspend();
+				if ((res = alloc_tileset())) {
+					hashtable_set((void*)ts_mgr, value, (void*)res, tileset_deallocator);
+					ret = parse_extern_tileset(res, filename, value);
+				}
+				arena_continue(arena);
 			}
+			ctx_current->free_func(value);
+			if (!res) return 0;
+			res_list->tileset = res;
+			return ret;
 		}
 		if (!(res = alloc_tileset())) {
-			tmx_free_func(value);
+			ctx_current->free_func(value);
 			return 0;
 		}
 		res_list->tileset = res;
-		if (ts_mgr) {
-			hashtable_set((void*)ts_mgr, value, (void*)res, tileset_deallocator);
-		}
-		else {
-			res->is_embedded = 1;
-		}
-		if (!(ab_path = mk_absolute_path(filename, value))) return 0;
-		tmx_free_func(value);
-		if (!(sub_reader = xmlReaderForFile(ab_path, NULL, 0)) || !check_reader(sub_reader)) { /* opens */
-			tmx_err(E_XDATA, "xml parser: cannot open extern tileset '%s'", ab_path);
-			tmx_free_func(ab_path);
-			return 0;
-		}
-		ret = parse_tileset(sub_reader, res, ab_path); /* and parses the tsx file */
-		xmlFreeTextReader(sub_reader);
-		tmx_free_func(ab_path);
+		res->is_embedded = 1;
+		ret = parse_extern_tileset(res, filename, value);
+		ctx_current->free_func(value);
 		return ret;
 	}
 
@@ -867,78 +933,78 @@ static tmx_map *parse_root_map(xmlTextReaderPtr reader, tmx_tileset_manager *ts_
 	if (!(res = alloc_map())) return NULL;
 
 	/* parses each attribute */
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"orientation"))) { /* orientation */
+	if ((value = get_attribute(reader, "orientation"))) { /* orientation */
 		if (res->orient = parse_orient(value), res->orient == O_NONE) {
 			tmx_err(E_XDATA, "xml parser: unsupported 'orientation' '%s'", value);
 			goto cleanup;
 		}
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	} else {
 		tmx_err(E_MISSEL, "xml parser: missing 'orientation' attribute in the 'map' element");
 		goto cleanup;
 	}
 
-	value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"staggerindex"); /* staggerindex */
+	value = get_attribute(reader, "staggerindex"); /* staggerindex */
 	if (value != NULL && (res->stagger_index = parse_stagger_index(value), res->stagger_index == SI_NONE)) {
 		tmx_err(E_XDATA, "xml parser: unsupported 'staggerindex' '%s'", value);
 		goto cleanup;
 	}
-	tmx_free_func(value);
+	ctx_current->free_func(value);
 
-	value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"staggeraxis"); /* staggeraxis */
+	value = get_attribute(reader, "staggeraxis"); /* staggeraxis */
 	if (res->stagger_axis = parse_stagger_axis(value), res->stagger_axis == SA_NONE) {
 		tmx_err(E_XDATA, "xml parser: unsupported 'staggeraxis' '%s'", value);
 		goto cleanup;
 	}
-	tmx_free_func(value);
+	ctx_current->free_func(value);
 
-	value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"renderorder"); /* renderorder */
+	value = get_attribute(reader, "renderorder"); /* renderorder */
 	if (res->renderorder = parse_renderorder(value), res->renderorder == R_NONE) {
 		tmx_err(E_XDATA, "xml parser: unsupported 'renderorder' '%s'", value);
 		goto cleanup;
 	}
-	tmx_free_func(value);
+	ctx_current->free_func(value);
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"height"))) { /* height */
+	if ((value = get_attribute(reader, "height"))) { /* height */
 		res->height = atoi(value);
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	} else {
 		tmx_err(E_MISSEL, "xml parser: missing 'height' attribute in the 'map' element");
 		goto cleanup;
 	}
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"width"))) { /* width */
+	if ((value = get_attribute(reader, "width"))) { /* width */
 		res->width = atoi(value);
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	} else {
 		tmx_err(E_MISSEL, "xml parser: missing 'width' attribute in the 'map' element");
 		goto cleanup;
 	}
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"tileheight"))) { /* tileheight */
+	if ((value = get_attribute(reader, "tileheight"))) { /* tileheight */
 		res->tile_height = atoi(value);
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	} else {
 		tmx_err(E_MISSEL, "xml parser: missing 'tileheight' attribute in the 'map' element");
 		goto cleanup;
 	}
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"tilewidth"))) { /* tilewidth */
+	if ((value = get_attribute(reader, "tilewidth"))) { /* tilewidth */
 		res->tile_width = atoi(value);
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	} else {
 		tmx_err(E_MISSEL, "xml parser: missing 'tilewidth' attribute in the 'map' element");
 		goto cleanup;
 	}
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"backgroundcolor"))) { /* backgroundcolor */
+	if ((value = get_attribute(reader, "backgroundcolor"))) { /* backgroundcolor */
 		res->backgroundcolor = get_color_rgb(value);
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	}
 
-	if ((value = (char*)xmlTextReaderGetAttribute(reader, (xmlChar*)"hexsidelength"))) { /* hexsidelength */
+	if ((value = get_attribute(reader, "hexsidelength"))) { /* hexsidelength */
 		res->hexsidelength = atoi(value);
-		tmx_free_func(value);
+		ctx_current->free_func(value);
 	}
 
 	/* Parse each child */
@@ -984,12 +1050,12 @@ tmx_map *parse_xml(tmx_tileset_manager *ts_mgr, const char *filename) {
 	xmlTextReaderPtr reader;
 	tmx_map *res = NULL;
 
-	setup_libxml_mem();
-
-	if ((reader = xmlReaderForFile(filename, NULL, 0))) {
+	if ((reader = open_reader(filename))) {
+		TMX_TRACE("parse_xml", 1);
 		if (check_reader(reader)) {
 			res = parse_root_map(reader, ts_mgr, filename);
 		}
+		TMX_TRACE("parse_xml", 0);
 		xmlFreeTextReader(reader);
 	} else {
 		tmx_err(E_UNKN, "xml parser: unable to open %s", filename);
@@ -1002,8 +1068,6 @@ tmx_map* parse_xml_buffer(tmx_tileset_manager *ts_mgr, const char *buffer, int l
 	xmlTextReaderPtr reader;
 	tmx_map *res = NULL;
 
-	setup_libxml_mem();
-
 	if ((reader = xmlReaderForMemory(buffer, len, NULL, NULL, 0))) {
 		if (check_reader(reader)) {
 			res = parse_root_map(reader, ts_mgr, NULL);
@@ -1020,8 +1084,6 @@ tmx_map* parse_xml_fd(tmx_tileset_manager *ts_mgr, int fd) {
 	xmlTextReaderPtr reader;
 	tmx_map *res = NULL;
 
-	setup_libxml_mem();
-
 	if ((reader = xmlReaderForFd(fd, NULL, NULL, 0))) {
 		if (check_reader(reader)) {
 			res = parse_root_map(reader, ts_mgr, NULL);
@@ -1038,8 +1100,6 @@ tmx_map* parse_xml_callback(tmx_tileset_manager *ts_mgr, tmx_read_functor callba
 	xmlTextReaderPtr reader;
 	tmx_map *res = NULL;
 
-	setup_libxml_mem();
-
 	if ((reader = xmlReaderForIO((xmlInputReadCallback)callback, NULL, userdata, NULL, NULL, 0))) {
 		if (check_reader(reader)) {
 			res = parse_root_map(reader, ts_mgr, NULL);
@@ -1060,9 +1120,7 @@ tmx_tileset* parse_tsx_xml(const char *filename) {
 	xmlTextReaderPtr reader;
 	tmx_tileset *res = NULL;
 
-	setup_libxml_mem();
-
-	if ((reader = xmlReaderForFile(filename, NULL, 0))) {
+	if ((reader = open_reader(filename))) {
 		if (check_reader(reader)) {
 			res = parse_root_tileset(reader, filename);
 		}
@@ -1078,8 +1136,6 @@ tmx_tileset* parse_tsx_xml_buffer(const char *buffer, int len) {
 	xmlTextReaderPtr reader;
 	tmx_tileset *res = NULL;
 
-	setup_libxml_mem();
-
 	if ((reader = xmlReaderForMemory(buffer, len, NULL, NULL, 0))) {
 		if (check_reader(reader)) {
 			res = parse_root_tileset(reader, NULL);
@@ -1096,8 +1152,6 @@ tmx_tileset* parse_tsx_xml_fd(int fd) {
 	xmlTextReaderPtr reader;
 	tmx_tileset *res = NULL;
 
-	setup_libxml_mem();
-
 	if ((reader = xmlReaderForFd(fd, NULL, NULL, 0))) {
 		if (check_reader(reader)) {
 			res = parse_root_tileset(reader, NULL);
@@ -1114,8 +1168,6 @@ tmx_tileset* parse_tsx_xml_callback(tmx_read_functor callback, void *userdata) {
 	xmlTextReaderPtr reader;
 	tmx_tileset *res = NULL;
 
-	setup_libxml_mem();
-
 	if ((reader = xmlReaderForIO((xmlInputReadCallback)callback, NULL, userdata, NULL, NULL, 0))) {
 		if (check_reader(reader)) {
 			res = parse_root_tileset(reader, NULL);
@@ -13,97 +13,155 @@
 */
 
 tmx_tileset_manager* tmx_make_tileset_manager() {
-	return (tmx_tileset_manager*)mk_hashtable(5);
+	return tmx_ctx_make_tileset_manager(NULL);
 }
 
-void tmx_free_tileset_manager(tmx_tileset_manager *h) {
-	free_hashtable((void*)h, tileset_deallocator);
+tmx_tileset_manager* tmx_ctx_make_tileset_manager(tmx_ctx *ctx) {
+	tmx_ctx *prev = ctx_enter(ctx);
+	void *res = mk_hashtable(5);
+	if (res) hashtable_set_owner(res, ctx);
+	ctx_leave(prev, res != NULL);
+	return (tmx_tileset_manager*)res;
 }
 
-int tmx_load_tileset(tmx_tileset_manager *ts_mgr, const char *path) {
-	tmx_tileset *ts;
+void tmx_free_tileset_manager(tmx_tileset_manager *h) {
+	tmx_ctx *prev;
 
-	if (ts_mgr == NULL) return 0;
+	if (h == NULL) return;
 
-	ts = parse_tsx_xml(path);
+	prev = ctx_enter(hashtable_owner((void*)h));
+	free_hashtable((void*)h, tileset_deallocator);
+	ctx_leave(prev, 1);
+}
+
+/* Stores a tileset parsed with the context of the manager */
+static int tsmgr_add(tmx_tileset_manager *ts_mgr, tmx_tileset *ts, const char *key) {
 	if (ts) {
-		hashtable_set((void*)ts_mgr, path, (void*)ts, tileset_deallocator);
+		hashtable_set((void*)ts_mgr, key, (void*)ts, tileset_deallocator);
 		return 1;
 	}
-
 	return 0;
 }
 
-int tmx_load_tileset_buffer(tmx_tileset_manager *ts_mgr, const char *buffer, int len, const char *key) {
-	tmx_tileset *ts;
+int tmx_load_tileset(tmx_tileset_manager *ts_mgr, const char *path) {
+	tmx_ctx *prev;
+	int ret;
 
 	if (ts_mgr == NULL) return 0;
 
-	ts = parse_tsx_xml_buffer(buffer, len);
-	if (ts) {
-		hashtable_set((void*)ts_mgr, key, (void*)ts, tileset_deallocator);
-		return 1;
-	}
+	prev = ctx_enter(hashtable_owner((void*)ts_mgr));
+	ret = tsmgr_add(ts_mgr, parse_tsx_xml(path), path);
+	ctx_leave(prev, ret);
+	return ret;
+}
 
-	return 0;
+int tmx_load_tileset_buffer(tmx_tileset_manager *ts_mgr, const char *buffer, int len, const char *key) {
+	tmx_ctx *prev;
+	int ret;
+
+	if (ts_mgr == NULL) return 0;
+
+	prev = ctx_enter(hashtable_owner((void*)ts_mgr));
+	ret = tsmgr_add(ts_mgr, parse_tsx_xml_buffer(buffer, len), key);
+	ctx_leave(prev, ret);
+	return ret;
 }
 
 int tmx_load_tileset_fd(tmx_tileset_manager *ts_mgr, int fd, const char *key) {
-	tmx_tileset *ts;
+	tmx_ctx *prev;
+	int ret;
 
 	if (ts_mgr == NULL) return 0;
 
-	ts = parse_tsx_xml_fd(fd);
-	if (ts) {
-		hashtable_set((void*)ts_mgr, key, (void*)ts, tileset_deallocator);
-		return 1;
-	}
-
-	return 0;
+	prev = ctx_enter(hashtable_owner((void*)ts_mgr));
+	ret = tsmgr_add(ts_mgr, parse_tsx_xml_fd(fd), key);
+	ctx_leave(prev, ret);
+	return ret;
 }
 
 int tmx_load_tileset_callback(tmx_tileset_manager *ts_mgr, tmx_read_functor callback, void *userdata, const char *key) {
-	tmx_tileset *ts;
+	tmx_ctx *prev;
+	int ret;
 
 	if (ts_mgr == NULL) return 0;
 
-	ts = parse_tsx_xml_callback(callback, userdata);
-	if (ts) {
-		hashtable_set((void*)ts_mgr, key, (void*)ts, tileset_deallocator);
-		return 1;
-	}
+	prev = ctx_enter(hashtable_owner((void*)ts_mgr));
+	ret = tsmgr_add(ts_mgr, parse_tsx_xml_callback(callback, userdata), key);
+	ctx_leave(prev, ret);
+	return ret;
+}
 
-	return 0;
+/* Maps loaded with a manager use a copy of its context, so the arena of the
+   map being loaded never shows in the context of the manager, their external
+   tilesets are shared with the manager */
+static tmx_ctx* tsmgr_enter(tmx_tileset_manager *ts_mgr, tmx_ctx *local) {
+	tmx_ctx *owner = ts_mgr ? hashtable_owner((void*)ts_mgr) : NULL;
+
+	if (!owner) return ctx_enter(NULL);
+
+	*local = *owner;
+	local->arena = NULL;
+	return ctx_enter(local);
+}
+
+static tmx_map* tsmgr_leave(tmx_tileset_manager *ts_mgr, tmx_ctx *prev, tmx_ctx *local, tmx_map *map) {
+	tmx_ctx *owner = ts_mgr ? hashtable_owner((void*)ts_mgr) : NULL;
+
+	if (map) map->ctx = owner;
+	ctx_leave(prev, map != NULL);
+	if (owner && !map) {
+		owner->error = local->error;
+		memcpy(owner->error_msg, local->error_msg, sizeof(owner->error_msg));
+	}
+	return map;
 }
 
 tmx_map* tmx_tsmgr_load(tmx_tileset_manager *ts_mgr, const char *path) {
 	tmx_map *map = NULL;
-	set_alloc_functions();
+	tmx_ctx local, *prev = tsmgr_enter(ts_mgr, &local);
+	void *arena = arena_begin();
 	map = parse_xml(ts_mgr, path);
 	map_post_parsing(&map);
-	return map;
+	arena_end(arena, map);
+	return tsmgr_leave(ts_mgr, prev, &local, map);
 }
 
 tmx_map* tmx_tsmgr_load_buffer(tmx_tileset_manager *ts_mgr, const char *buffer, int len) {
 	tmx_map *map = NULL;
-	set_alloc_functions();
+	tmx_ctx local, *prev = tsmgr_enter(ts_mgr, &local);
+	void *arena = arena_begin();
 	map = parse_xml_buffer(ts_mgr, buffer, len);
 	map_post_parsing(&map);
-	return map;
+	arena_end(arena, map);
+	return tsmgr_leave(ts_mgr, prev, &local, map);
 }
 
 tmx_map* tmx_tsmgr_load_fd(tmx_tileset_manager *ts_mgr, int fd) {
 	tmx_map *map = NULL;
-	set_alloc_functions();
+	tmx_ctx local, *prev = tsmgr_enter(ts_mgr, &local);
+	void *arena = arena_begin();
 	map = parse_xml_fd(ts_mgr, fd);
 	map_post_parsing(&map);
-	return map;
+	arena_end(arena, map);
+	return tsmgr_leave(ts_mgr, prev, &local, map);
 }
 
 tmx_map* tmx_tsmgr_load_callback(tmx_tileset_manager *ts_mgr, tmx_read_functor callback, void *userdata) {
 	tmx_map *map = NULL;
-	set_alloc_functions();
+	tmx_ctx local, *prev = tsmgr_enter(ts_mgr, &local);
+	void *arena = arena_begin();
 	map = parse_xml_callback(ts_mgr, callback, userdata);
 	map_post_parsing(&map);
-	return map;
+	arena_end(arena, map);
+	return tsmgr_leave(ts_mgr, prev, &local, map);
+}
+
+tmx_map* tmx_tsmgr_load_bin(tmx_tileset_manager *ts_mgr, const char *path) {
+	tmx_map *map = NULL;
+	tmx_ctx local, *prev = tsmgr_enter(ts_mgr, &local);
+	void *arena = arena_begin();
+	map = parse_bin(ts_mgr, path);
+	map_post_parsing(&map);
+	arena_end(arena, map);
+	return tsmgr_leave(ts_mgr, prev, &local, map);
 }
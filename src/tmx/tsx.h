@@ -30,6 +30,11 @@ typedef void tmx_tileset_manager;
    The key is the `source` attribute of a tileset element */
 TMXEXPORT tmx_tileset_manager* tmx_make_tileset_manager();
 
+/* Same as tmx_make_tileset_manager but the manager, its tilesets and the maps
+   loaded with it use `ctx` (see tmx_ctx in tmx.h), which must outlive them
+   A manager must not be used by two threads at once, give each thread its own */
+TMXEXPORT tmx_tileset_manager* tmx_ctx_make_tileset_manager(tmx_ctx *ctx);
+
 /* Frees the tilesetManager and all its loaded Tilesets
    All maps holding a pointer to external tileset loaded by the given manager
    now hold a pointer to freed memory */
@@ -57,7 +62,8 @@ TMXEXPORT int tmx_load_tileset_callback(tmx_tileset_manager *ts_mgr, tmx_read_fu
 	Load map using a Tileset Manager
 */
 
-/* Same as tmx_load (tmx.h) but with a Tileset Manager. */
+/* Same as tmx_load (tmx.h) but with a Tileset Manager.
+   The map is loaded with the context of the manager, if it has one */
 TMXEXPORT tmx_map* tmx_tsmgr_load(tmx_tileset_manager *ts_mgr, const char *path);
 
 /* Same as tmx_load_buffer (tmx.h) but with a Tileset Manager. */
@@ -69,6 +75,11 @@ TMXEXPORT tmx_map* tmx_tsmgr_load_fd(tmx_tileset_manager *ts_mgr, int fd);
 /* Same as tmx_load_callback (tmx.h) but with a Tileset Manager. */
 TMXEXPORT tmx_map* tmx_tsmgr_load_callback(tmx_tileset_manager *ts_mgr, tmx_read_functor callback, void *userdata);
 
+/* Same as tmx_load_bin (tmx.h) but with a Tileset Manager, the tilesets that
+   were external in the source map are taken from the manager by their source,
+   or stored into it */
+TMXEXPORT tmx_map* tmx_tsmgr_load_bin(tmx_tileset_manager *ts_mgr, const char *path);
+
 #ifdef __cplusplus
 }
 #endif
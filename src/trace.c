@@ -0,0 +1,348 @@
+/** @file trace.c
+ * @ingroup   Trace
+ * @defgroup  Trace
+ * @brief     Trace event writer.  Spans and counters are written in the
+ *            Chrome trace event format and can be viewed on a timeline with
+ *            chrome://tracing or Perfetto.
+ *
+ *            Events are collected in memory and written to disk by a
+ *            background thread, so the calling thread never waits for file
+ *            I/O.  Event names are stored by reference and have to be string
+ *            literals.  All functions return immediately if no trace has been
+ *            started.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "tmx/tmx.h"
+#include "trace.h"
+
+/**
+ * @ingroup Trace
+ */
+typedef struct traceEvent_t
+{
+    const char    *name;
+    char          phase;
+    unsigned long thread;
+    uint64_t      time;
+    double        value;
+} TraceEvent;
+
+/**
+ * @ingroup Trace
+ */
+typedef struct tracer_t
+{
+    FILE       *file;
+    SDL_Thread *thread;
+    SDL_mutex  *mutex;
+    SDL_cond   *cond;
+    uint8_t    running;
+    /* Events are added to front; the writer thread swaps both buffers and
+     * writes back while new events are being collected. */
+    TraceEvent *front;
+    TraceEvent *back;
+    uint32_t   frontSize;
+    uint32_t   backSize;
+    uint32_t   count;
+    uint32_t   dropped;
+    uint64_t   start;
+    double     frequency;
+} Tracer;
+
+static Tracer *tracer = NULL;
+
+/**
+ * @brief   Add an event to the buffer.  The writer thread is woken up once
+ *          TRACE_BUFFER_SIZE events have been collected.  If it falls behind,
+ *          the buffer grows instead of waiting for it.
+ * @param   name  name of the event.
+ * @param   phase event type, e.g. 'B' for begin.
+ * @param   time  timestamp returned by SDL_GetPerformanceCounter().
+ * @param   value counter value.  Ignored for other types.
+ * @ingroup Trace
+ */
+static void traceAdd(const char *name, char phase, uint64_t time, double value)
+{
+    unsigned long thread = SDL_ThreadID();
+
+    SDL_LockMutex(tracer->mutex);
+    if (tracer->count == tracer->frontSize)
+    {
+        TraceEvent *front = realloc(tracer->front, 2 * tracer->frontSize * sizeof(struct traceEvent_t));
+        if (front)
+        {
+            tracer->front      = front;
+            tracer->frontSize *= 2;
+        }
+    }
+
+    if (tracer->count == tracer->frontSize)
+    {
+        tracer->dropped++;
+    }
+    else
+    {
+        TraceEvent *event = &tracer->front[tracer->count];
+        event->name       = name;
+        event->phase      = phase;
+        event->thread     = thread;
+        event->time       = time;
+        event->value      = value;
+        tracer->count++;
+
+        if (TRACE_BUFFER_SIZE == tracer->count)
+        {
+            SDL_CondSignal(tracer->cond);
+        }
+    }
+    SDL_UnlockMutex(tracer->mutex);
+}
+
+/**
+ * @brief   Forward the loader phases of the TMX library.  See
+ *          tmx_trace_func.
+ * @ingroup Trace
+ */
+static void traceTmx(const char *name, int begin)
+{
+    if (begin)
+    {
+        traceBegin(name);
+    }
+    else
+    {
+        traceEnd(name);
+    }
+}
+
+/**
+ * @brief   Writer thread.  Waits for events and writes them to the file
+ *          until the trace is stopped.
+ * @param   data unused.
+ * @return  Always 0.
+ * @ingroup Trace
+ */
+static int traceWriter(void *data)
+{
+    uint8_t    running = 1;
+    uint32_t   count;
+    uint32_t   size;
+    TraceEvent *event;
+
+    (void)data;
+    while (running)
+    {
+        SDL_LockMutex(tracer->mutex);
+        while (tracer->running && (tracer->count < TRACE_BUFFER_SIZE))
+        {
+            SDL_CondWait(tracer->cond, tracer->mutex);
+        }
+        running           = tracer->running;
+        event             = tracer->front;
+        size              = tracer->frontSize;
+        count             = tracer->count;
+        tracer->front     = tracer->back;
+        tracer->frontSize = tracer->backSize;
+        tracer->back      = event;
+        tracer->backSize  = size;
+        tracer->count     = 0;
+        SDL_UnlockMutex(tracer->mutex);
+
+        for (uint32_t i = 0; i < count; i++, event++)
+        {
+            double time = (event->time - tracer->start) / tracer->frequency * 1000000;
+
+            fprintf(tracer->file,
+                    ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%lu",
+                    event->name, event->phase, time, event->thread);
+
+            if ('C' == event->phase)
+            {
+                fprintf(tracer->file, ",\"args\":{\"value\":%g}}", event->value);
+            }
+            else if ('X' == event->phase)
+            {
+                fprintf(tracer->file, ",\"dur\":%.3f}", event->value / tracer->frequency * 1000000);
+            }
+            else
+            {
+                fputc('}', tracer->file);
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Begin a span on the calling thread.
+ * @param   name name of the span.
+ * @ingroup Trace
+ */
+void traceBegin(const char *name)
+{
+    if (NULL == tracer)
+    {
+        return;
+    }
+
+    traceAdd(name, 'B', SDL_GetPerformanceCounter(), 0);
+}
+
+/**
+ * @brief   Add a span which has already been measured.
+ * @param   name  name of the span.
+ * @param   start timestamp returned by SDL_GetPerformanceCounter().
+ * @param   end   timestamp returned by SDL_GetPerformanceCounter().
+ * @ingroup Trace
+ */
+void traceComplete(const char *name, uint64_t start, uint64_t end)
+{
+    if (NULL == tracer)
+    {
+        return;
+    }
+
+    traceAdd(name, 'X', start, end - start);
+}
+
+/**
+ * @brief   Set a counter.
+ * @param   name  name of the counter.
+ * @param   value the new value.
+ * @ingroup Trace
+ */
+void traceCounter(const char *name, double value)
+{
+    if (NULL == tracer)
+    {
+        return;
+    }
+
+    traceAdd(name, 'C', SDL_GetPerformanceCounter(), value);
+}
+
+/**
+ * @brief   End the most recent span on the calling thread.
+ * @param   name name of the span.
+ * @ingroup Trace
+ */
+void traceEnd(const char *name)
+{
+    if (NULL == tracer)
+    {
+        return;
+    }
+
+    traceAdd(name, 'E', SDL_GetPerformanceCounter(), 0);
+}
+
+/**
+ * @brief   Stop tracing.  Remaining events are written and the file is
+ *          closed.
+ * @ingroup Trace
+ */
+void traceFree(void)
+{
+    if (NULL == tracer)
+    {
+        return;
+    }
+
+    tmx_trace_func = NULL;
+
+    if (tracer->thread)
+    {
+        SDL_LockMutex(tracer->mutex);
+        tracer->running = 0;
+        SDL_CondSignal(tracer->cond);
+        SDL_UnlockMutex(tracer->mutex);
+        SDL_WaitThread(tracer->thread, NULL);
+    }
+
+    if (tracer->file)
+    {
+        fprintf(tracer->file, "\n]}\n");
+        fclose(tracer->file);
+    }
+
+    if (tracer->dropped)
+    {
+        fprintf(stderr, "traceFree(): %u events dropped.\n", tracer->dropped);
+    }
+
+    SDL_DestroyCond(tracer->cond);
+    SDL_DestroyMutex(tracer->mutex);
+    free(tracer->front);
+    free(tracer->back);
+    free(tracer);
+    tracer = NULL;
+}
+
+/**
+ * @brief   Start tracing.  Also traces the loader phases of the TMX library.
+ * @param   filename the file to write the trace to.
+ * @return  0 on success, -1 on error.
+ * @ingroup Trace
+ */
+int8_t traceInit(const char *filename)
+{
+    if (tracer)
+    {
+        return 0;
+    }
+
+    tracer = calloc(1, sizeof(struct tracer_t));
+    if (NULL == tracer)
+    {
+        fprintf(stderr, "traceInit(): error allocating memory.\n");
+        return -1;
+    }
+
+    tracer->frontSize = 2 * TRACE_BUFFER_SIZE;
+    tracer->backSize  = 2 * TRACE_BUFFER_SIZE;
+    tracer->front     = malloc(tracer->frontSize * sizeof(struct traceEvent_t));
+    tracer->back      = malloc(tracer->backSize  * sizeof(struct traceEvent_t));
+    tracer->mutex     = SDL_CreateMutex();
+    tracer->cond      = SDL_CreateCond();
+    if ((NULL == tracer->front) || (NULL == tracer->back) || (NULL == tracer->mutex) || (NULL == tracer->cond))
+    {
+        fprintf(stderr, "traceInit(): error allocating memory.\n");
+        traceFree();
+        return -1;
+    }
+
+    tracer->file = fopen(filename, "w");
+    if (NULL == tracer->file)
+    {
+        fprintf(stderr, "traceInit(): error opening %s.\n", filename);
+        traceFree();
+        return -1;
+    }
+
+    /* The metadata event keeps the list valid JSON; every following event
+     * starts with a comma. */
+    fprintf(tracer->file,
+            "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+            "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"Rainbow Joe\"}}");
+
+    tracer->running   = 1;
+    tracer->start     = SDL_GetPerformanceCounter();
+    tracer->frequency = SDL_GetPerformanceFrequency();
+    tracer->thread    = SDL_CreateThread(traceWriter, "trace", NULL);
+    if (NULL == tracer->thread)
+    {
+        fprintf(stderr, "traceInit(): %s\n", SDL_GetError());
+        traceFree();
+        return -1;
+    }
+
+    tmx_trace_func = traceTmx;
+
+    return 0;
+}
@@ -0,0 +1,25 @@
+/** @file trace.h
+ * @ingroup Trace
+ */
+
+#ifndef TRACE_h
+#define TRACE_h
+
+#include <stdint.h>
+
+/**
+ * @def     TRACE_BUFFER_SIZE
+ *          Number of events collected before they are handed to the writer
+ *          thread.
+ * @ingroup Trace
+ */
+#define TRACE_BUFFER_SIZE 16384
+
+void   traceBegin(const char *name);
+void   traceComplete(const char *name, uint64_t start, uint64_t end);
+void   traceCounter(const char *name, double value);
+void   traceEnd(const char *name);
+void   traceFree(void);
+int8_t traceInit(const char *filename);
+
+#endif
@@ -0,0 +1,203 @@
+/** @file b64bench.c
+ * @brief     Benchmark the base64 decoder of the TMX loader against the
+ *            previous, branch-per-character implementation.
+ *
+ *            Usage: b64bench [megabytes] [iterations]
+ *
+ *            The input is formatted like the content of a TMX <data> element
+ *            (leading and trailing blanks) and both decoders are checked to
+ *            produce the same output.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../src/tmx/tmx.h"
+#include "../src/tmx/tsx.h"
+#include "../src/tmx/tmx_utils.h"
+
+/**
+ * @brief   Character classification of the previous decoder.
+ */
+static char baselineValue(char c)
+{
+    if (c >= 'A' && c <= 'Z')
+    {
+        return c - 'A';
+    }
+    else if (c >= 'a' && c <= 'z')
+    {
+        return c - 'a' + 26;
+    }
+    else if (c >= '0' && c <= '9')
+    {
+        return c - '0' + 52;
+    }
+    else if (c == '+')
+    {
+        return 62;
+    }
+    else if (c == '/')
+    {
+        return 63;
+    }
+    else if (c == '=')
+    {
+        return 0;
+    }
+    return -1;
+}
+
+/**
+ * @brief   The previous decoder.  Expects a trimmed source.
+ */
+static char *baselineDecode(const char *source, uint32_t *length)
+{
+    uint32_t srcLength = strlen(source);
+    char     *res;
+
+    if (srcLength % 4)
+    {
+        return NULL;
+    }
+
+    *length = (srcLength / 4) * 3;
+    res     = malloc(*length);
+    if (NULL == res)
+    {
+        return NULL;
+    }
+
+    for (uint32_t i = 0; i < srcLength; i += 4)
+    {
+        uint32_t in = 0;
+
+        for (uint8_t j = 0; j < 4; j++)
+        {
+            char v = baselineValue(source[i + j]);
+            if (-1 == v)
+            {
+                free(res);
+                return NULL;
+            }
+            in = in << 6;
+            in += v;
+        }
+        for (uint8_t j = 0; j < 3; j++)
+        {
+            memcpy(res + (i / 4) * 3 + j, ((char*)&in) + 2 - j, 1);
+        }
+    }
+
+    if ('=' == source[srcLength - 1])
+    {
+        (*length)--;
+    }
+    if ('=' == source[srcLength - 2])
+    {
+        (*length)--;
+    }
+
+    return res;
+}
+
+/**
+ * @brief   Trim blanks in place, as the loader did before every decode.
+ */
+static char *baselineTrim(char *str)
+{
+    int32_t end = strlen(str) - 1;
+
+    while ((end >= 0) && (' ' == str[end] || '\n' == str[end]))
+    {
+        end--;
+    }
+    str[end + 1] = '\0';
+
+    while (' ' == *str || '\n' == *str)
+    {
+        str++;
+    }
+    return str;
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t megabytes  = (argc > 1) ? atoi(argv[1]) : 16;
+    uint32_t iterations = (argc > 2) ? atoi(argv[2]) : 10;
+    uint32_t size       = megabytes * 1024 * 1024;
+
+    // The decoder allocates through the current loader context.
+    tmx_ctx ctx;
+    tmx_ctx_init(&ctx);
+    ctx_current = &ctx;
+
+    char *raw = malloc(size);
+    if ((NULL == raw) || (0 == size) || (0 == iterations))
+    {
+        fprintf(stderr, "Usage: %s [megabytes] [iterations]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    srand(42);
+    for (uint32_t i = 0; i < size; i++)
+    {
+        raw[i] = rand();
+    }
+
+    char *encoded = b64_encode(raw, size);
+    char *source  = malloc(strlen(encoded) + 8);
+    if ((NULL == encoded) || (NULL == source))
+    {
+        fprintf(stderr, "Error allocating memory.\n");
+        return EXIT_FAILURE;
+    }
+    sprintf(source, "\n   %s\n  ", encoded);
+
+    double   timeBaseline = 0;
+    double   timeDecoder  = 0;
+    uint32_t length;
+
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        // The baseline trims in place, so it works on a copy.
+        strcpy(encoded, source);
+
+        clock_t start = clock();
+        char    *res  = baselineDecode(baselineTrim(encoded), &length);
+        timeBaseline += (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        if ((NULL == res) || (length != size) || memcmp(res, raw, size))
+        {
+            fprintf(stderr, "Baseline decoder failed.\n");
+            return EXIT_FAILURE;
+        }
+        free(res);
+
+        start = clock();
+        res   = b64_decode(source, &length);
+        timeDecoder += (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        if ((NULL == res) || (length != size) || memcmp(res, raw, size))
+        {
+            fprintf(stderr, "Decoder failed: %s\n", tmx_strerr());
+            return EXIT_FAILURE;
+        }
+        free(res);
+    }
+
+    double input = (double)strlen(source) * iterations / (1024 * 1024);
+
+    printf("Baseline: %8.1f MiB/s\n", input / timeBaseline);
+    printf("Decoder:  %8.1f MiB/s (%.1fx)\n", input / timeDecoder, timeBaseline / timeDecoder);
+
+    free(source);
+    free(encoded);
+    free(raw);
+
+    return EXIT_SUCCESS;
+}
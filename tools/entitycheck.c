@@ -0,0 +1,220 @@
+/** @file entitycheck.c
+ * @brief     Check entityFrameBatch() against entityFrame().
+ *
+ *            Usage: entitycheck [entities] [ticks]
+ *
+ *            Three stores with the same random entities are updated for the
+ *            given number of ticks: one with entityFrame() for every entity,
+ *            one with entityFrameBatch() over all entities and one with the
+ *            blocks shifted by a few entities.  The entity count should not
+ *            be a multiple of ENTITY_BATCH_SIZE, so the remainder is covered
+ *            as well.  All stores have to match bit for bit after every tick.
+ *            The map collision is replaced by a flat floor.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/entity.h"
+
+#define NUM_STORES   3
+#define WORLD_WIDTH  2048
+#define WORLD_HEIGHT 1024
+#define FLOOR        (WORLD_HEIGHT - 128)
+// Start of the first block of the third store.
+#define SHIFT        5
+
+/**
+ * @brief   Hash a tick and an entity index into a pseudo-random number, so
+ *          every store gets the same input regardless of the update order.
+ */
+static uint32_t entityCheckRandom(uint32_t tick, uint32_t i)
+{
+    uint32_t x = (tick * 0x9E3779B9u) ^ (i * 0x85EBCA6Bu);
+
+    x ^= x >> 16;
+    x *= 0x7FEB352Du;
+    x ^= x >> 15;
+    x *= 0x846CA68Bu;
+    x ^= x >> 16;
+
+    return x;
+}
+
+/**
+ * @brief   Random value in [min, max).
+ */
+static double entityCheckRange(uint32_t tick, uint32_t i, double min, double max)
+{
+    return min + (entityCheckRandom(tick, i) / 4294967296.0) * (max - min);
+}
+
+/**
+ * @brief   Give every entity of a store the same random state.
+ */
+static void entityCheckSetup(EntityStore *store)
+{
+    store->worldWidth  = WORLD_WIDTH;
+    store->worldHeight = WORLD_HEIGHT;
+
+    for (uint32_t i = 0; i < store->count; i++)
+    {
+        uint32_t r = entityCheckRandom(0, i);
+
+        store->width[i]             = 8 + (r % 57);
+        store->height[i]            = 8 + ((r >> 8) % 57);
+        store->flags[i]             = (r >> 16) & ((1 << DIRECTION) | (1 << IN_MID_AIR) | (1 << IN_MOTION) | (1 << IS_JUMPING));
+        store->acceleration[i]      = entityCheckRange(1, i, 100, 800);
+        store->deceleration[i]      = entityCheckRange(2, i, 50, 400);
+        store->velocity[i]          = entityCheckRange(3, i, 0, 250);
+        store->velocityMax[i]       = entityCheckRange(4, i, 100, 250);
+        store->velocityJump[i]      = entityCheckRange(5, i, 0, 50);
+        store->jumpTimeMax[i]       = entityCheckRange(6, i, 0.05, 0.2);
+        store->jumpGravityFactor[i] = entityCheckRange(7, i, 2, 6);
+        store->worldPosX[i]         = entityCheckRange(8, i, -32, WORLD_WIDTH + 32);
+        store->worldPosY[i]         = entityCheckRange(9, i, 0, FLOOR);
+
+        store->entity[i].fps         = entityCheckRange(10, i, 6, 24);
+        store->entity[i].respawnPosX = entityCheckRange(11, i, 0, WORLD_WIDTH);
+        store->entity[i].respawnPosY = entityCheckRange(12, i, 0, FLOOR / 2);
+    }
+}
+
+/**
+ * @brief   Apply the input and the floor of one tick to an entity, as the
+ *          game does with the player input and entityCollide().
+ */
+static void entityCheckStep(EntityStore *store, uint32_t i, uint32_t tick)
+{
+    uint32_t r = entityCheckRandom(tick, i);
+
+    if ((store->flags[i] >> IS_DEAD) & 1)
+    {
+        entityRespawn(store, i);
+    }
+
+    // Change the input now and then.
+    if (0 == (r % 8))
+    {
+        store->flags[i] ^= 1 << IN_MOTION;
+    }
+    if (0 == ((r >> 8) % 32))
+    {
+        store->flags[i] ^= 1 << DIRECTION;
+    }
+    if ((0 == ((r >> 16) % 16)) && (0 == ((store->flags[i] >> IN_MID_AIR) & 1)))
+    {
+        store->flags[i] |= 1 << IS_JUMPING;
+    }
+
+    // Flat floor with a gap, so some entities fall out of the world.
+    if ((store->worldPosY[i] >= FLOOR) && (store->worldPosX[i] < WORLD_WIDTH / 2))
+    {
+        store->worldPosY[i]    = FLOOR;
+        store->velocityFall[i] = 0;
+        store->flags[i]       &= ~(1 << IN_MID_AIR);
+    }
+    else
+    {
+        store->flags[i] |= 1 << IN_MID_AIR;
+    }
+}
+
+/**
+ * @brief   Compare two stores bit for bit.
+ * @return  0 if they match, -1 otherwise.
+ */
+static int8_t entityCheckCompare(EntityStore *a, EntityStore *b)
+{
+    uint32_t n = a->count;
+
+    if (memcmp(a->bb,           b->bb,           n * sizeof(AABB))     ||
+        memcmp(a->distanceFall, b->distanceFall, n * sizeof(double))   ||
+        memcmp(a->flags,        b->flags,        n * sizeof(uint16_t)) ||
+        memcmp(a->jumpTime,     b->jumpTime,     n * sizeof(double))   ||
+        memcmp(a->velocity,     b->velocity,     n * sizeof(double))   ||
+        memcmp(a->velocityFall, b->velocityFall, n * sizeof(double))   ||
+        memcmp(a->worldPosX,    b->worldPosX,    n * sizeof(double))   ||
+        memcmp(a->worldPosY,    b->worldPosY,    n * sizeof(double)))
+    {
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        Entity *ea = &a->entity[i];
+        Entity *eb = &b->entity[i];
+
+        if ((ea->frame != eb->frame) || (ea->frameStart != eb->frameStart) || (ea->frameEnd != eb->frameEnd) ||
+            memcmp(&ea->frameTime, &eb->frameTime, sizeof(double)))
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t    count = (argc > 1) ? atoi(argv[1]) : (3 * ENTITY_BATCH_SIZE) + 37;
+    uint32_t    ticks = (argc > 2) ? atoi(argv[2]) : 10000;
+    double      dTime = 1.0 / 120;
+    EntityStore *store[NUM_STORES];
+
+    if ((count <= SHIFT) || (0 == ticks))
+    {
+        fprintf(stderr, "Usage: %s [entities] [ticks]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    for (uint8_t s = 0; s < NUM_STORES; s++)
+    {
+        store[s] = entityStoreInit(count);
+        if (NULL == store[s])
+        {
+            return EXIT_FAILURE;
+        }
+        entityCheckSetup(store[s]);
+    }
+
+    for (uint32_t tick = 1; tick <= ticks; tick++)
+    {
+        for (uint8_t s = 0; s < NUM_STORES; s++)
+        {
+            for (uint32_t i = 0; i < count; i++)
+            {
+                entityCheckStep(store[s], i, tick);
+            }
+        }
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            entityFrame(store[0], i, dTime);
+        }
+        entityFrameBatch(store[1], 0, count, dTime);
+        entityFrameBatch(store[2], 0, SHIFT, dTime);
+        entityFrameBatch(store[2], SHIFT, count - SHIFT, dTime);
+
+        for (uint8_t s = 1; s < NUM_STORES; s++)
+        {
+            if (-1 == entityCheckCompare(store[0], store[s]))
+            {
+                fprintf(stderr, "Store %u differs from entityFrame() after %u ticks.\n", s, tick);
+                return EXIT_FAILURE;
+            }
+        }
+    }
+
+    printf("%u entities, %u ticks: entityFrameBatch() matches entityFrame().\n", count, ticks);
+
+    for (uint8_t s = 0; s < NUM_STORES; s++)
+    {
+        entityStoreFree(store[s]);
+    }
+
+    return EXIT_SUCCESS;
+}
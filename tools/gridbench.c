@@ -0,0 +1,275 @@
+/** @file gridbench.c
+ * @brief     Benchmark the grid broadphase against testing every pair of
+ *            bounding boxes with doIntersect().
+ *
+ *            Usage: gridbench [iterations]
+ *
+ *            For 7 to 50000 random boxes, gridInsert(), gridQuery() and
+ *            gridPairs() are timed and checked to find exactly the same
+ *            overlaps as the brute-force test.  Some of the boxes span
+ *            several cells or stick out of the grid.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../src/aabb.h"
+#include "../src/grid.h"
+
+// Only this many queries are checked, the brute-force test is quadratic.
+#define CHECKED_QUERIES 1000
+
+typedef struct pairs_t
+{
+    uint64_t *pair;
+    uint32_t count;
+    uint32_t max;
+} Pairs;
+
+/**
+ * @brief   Store a pair with the lower ID first.  Used as callback for
+ *          gridPairs().
+ */
+static void addPair(uint32_t idA, uint32_t idB, void *userdata)
+{
+    Pairs *pairs = userdata;
+
+    if (pairs->count < pairs->max)
+    {
+        pairs->pair[pairs->count] = (idA < idB) ? ((uint64_t)idA << 32) | idB : ((uint64_t)idB << 32) | idA;
+    }
+    pairs->count++;
+}
+
+/**
+ * @brief   Count the pairs.  Used as callback for gridPairs().
+ */
+static void countPair(uint32_t idA, uint32_t idB, void *userdata)
+{
+    (void)idA;
+    (void)idB;
+    (*(uint32_t *)userdata)++;
+}
+
+static int comparePairs(const void *a, const void *b)
+{
+    uint64_t pairA = *(const uint64_t *)a;
+    uint64_t pairB = *(const uint64_t *)b;
+
+    return (pairA > pairB) - (pairA < pairB);
+}
+
+/**
+ * @brief   Random bounding box in a square world, sticking out of it a
+ *          little.  Every 16th box is large enough to span several cells.
+ */
+static AABB randomBox(double side)
+{
+    AABB   bb;
+    double size = (0 == rand() % 16) ? 64 + rand() % 192 : 8 + rand() % 40;
+
+    bb.l = (rand() / (double)RAND_MAX) * (side + 64) - 32;
+    bb.t = (rand() / (double)RAND_MAX) * (side + 64) - 32;
+    bb.r = bb.l + size;
+    bb.b = bb.t + size * (0.5 + (rand() % 3) * 0.5);
+
+    return bb;
+}
+
+/**
+ * @brief   Check the pairs reported by gridPairs() against the brute-force
+ *          test, which is timed as the baseline.
+ * @return  0 on success, -1 on mismatch.
+ */
+static int8_t checkPairs(Grid *grid, AABB *box, uint32_t count, double *timeBrute)
+{
+    uint32_t numBrute = 0;
+    uint32_t maxPairs = count * 64;
+    Pairs    pairs;
+    uint64_t *brute   = malloc(maxPairs * sizeof(uint64_t));
+
+    pairs.pair  = malloc(maxPairs * sizeof(uint64_t));
+    pairs.count = 0;
+    pairs.max   = maxPairs;
+    if ((NULL == brute) || (NULL == pairs.pair))
+    {
+        fprintf(stderr, "Error allocating memory.\n");
+        return -1;
+    }
+
+    clock_t start = clock();
+    for (uint32_t a = 0; a < count; a++)
+    {
+        for (uint32_t b = a + 1; b < count; b++)
+        {
+            if (doIntersect(box[a], box[b]))
+            {
+                if (numBrute < maxPairs)
+                {
+                    brute[numBrute] = ((uint64_t)a << 32) | b;
+                }
+                numBrute++;
+            }
+        }
+    }
+    *timeBrute = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    gridPairs(grid, addPair, &pairs);
+
+    int8_t result = 0;
+    if ((numBrute > maxPairs) || (pairs.count != numBrute))
+    {
+        fprintf(stderr, "%u boxes: gridPairs() found %u pairs, expected %u.\n", count, pairs.count, numBrute);
+        result = -1;
+    }
+    else
+    {
+        // Sorting also reveals pairs reported twice.
+        qsort(pairs.pair, pairs.count, sizeof(uint64_t), comparePairs);
+        if (memcmp(pairs.pair, brute, numBrute * sizeof(uint64_t)))
+        {
+            fprintf(stderr, "%u boxes: gridPairs() reported the wrong pairs.\n", count);
+            result = -1;
+        }
+    }
+
+    free(pairs.pair);
+    free(brute);
+    return result;
+}
+
+/**
+ * @brief   Check the results of gridQuery() against the brute-force test.
+ * @return  0 on success, -1 on mismatch.
+ */
+static int8_t checkQueries(Grid *grid, AABB *box, uint32_t count, uint32_t *result, uint8_t *hit)
+{
+    for (uint32_t q = 0; (q < count) && (q < CHECKED_QUERIES); q++)
+    {
+        AABB     bb         = randomBox(sqrt(count) * 96);
+        uint32_t numResults = gridQuery(grid, bb, result, count);
+        uint32_t numBrute   = 0;
+
+        memset(hit, 0, count);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            if (doIntersect(bb, box[i]))
+            {
+                hit[i] = 1;
+                numBrute++;
+            }
+        }
+
+        // Every expected item once; a duplicate would be counted twice.
+        for (uint32_t i = 0; i < numResults; i++)
+        {
+            if (1 != hit[result[i]])
+            {
+                numBrute = numResults + 1;
+                break;
+            }
+            hit[result[i]] = 2;
+        }
+
+        if (numResults != numBrute)
+        {
+            fprintf(stderr, "%u boxes: gridQuery() doesn't match the brute-force test.\n", count);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    static const uint32_t counts[] = { 7, 50, 500, 5000, 50000 };
+    uint32_t              iterations = (argc > 1) ? atoi(argv[1]) : 10;
+
+    if (0 == iterations)
+    {
+        fprintf(stderr, "Usage: %s [iterations]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    srand(42);
+
+    for (uint8_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++)
+    {
+        uint32_t count  = counts[c];
+        double   side   = sqrt(count) * 96;
+        AABB     *box   = malloc(count * sizeof(AABB));
+        uint32_t *query = malloc(count * sizeof(uint32_t));
+        uint8_t  *hit   = malloc(count);
+        Grid     *grid  = gridInit(side, side, GRID_CELL_SIZE);
+
+        if ((NULL == box) || (NULL == query) || (NULL == hit) || (NULL == grid))
+        {
+            fprintf(stderr, "Error allocating memory.\n");
+            return EXIT_FAILURE;
+        }
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            box[i] = randomBox(side);
+        }
+
+        double   timeInsert = 0;
+        double   timeQuery  = 0;
+        double   timePairs  = 0;
+        double   timeBrute  = 0;
+        uint32_t numPairs   = 0;
+
+        for (uint32_t n = 0; n < iterations; n++)
+        {
+            clock_t start = clock();
+            gridClear(grid);
+            for (uint32_t i = 0; i < count; i++)
+            {
+                if (-1 == gridInsert(grid, i, box[i]))
+                {
+                    return EXIT_FAILURE;
+                }
+            }
+            timeInsert += (double)(clock() - start) / CLOCKS_PER_SEC;
+
+            start = clock();
+            for (uint32_t i = 0; i < count; i++)
+            {
+                gridQuery(grid, box[i], query, count);
+            }
+            timeQuery += (double)(clock() - start) / CLOCKS_PER_SEC;
+
+            numPairs = 0;
+            start    = clock();
+            gridPairs(grid, countPair, &numPairs);
+            timePairs += (double)(clock() - start) / CLOCKS_PER_SEC;
+        }
+
+        if ((-1 == checkPairs(grid, box, count, &timeBrute)) || (-1 == checkQueries(grid, box, count, query, hit)))
+        {
+            return EXIT_FAILURE;
+        }
+
+        printf("%5u boxes: insert %9.4f ms, query %9.4f ms, pairs %9.4f ms, brute force %9.4f ms (%.1fx), %u pairs\n",
+               count,
+               timeInsert * 1000 / iterations,
+               timeQuery  * 1000 / iterations,
+               timePairs  * 1000 / iterations,
+               timeBrute  * 1000,
+               (timePairs > 0) ? timeBrute * iterations / timePairs : 0,
+               numPairs);
+
+        gridFree(grid);
+        free(hit);
+        free(query);
+        free(box);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,185 @@
+/** @file levelcheck.c
+ * @brief     Check the level manager against maps loaded on their own.
+ *
+ *            Usage: levelcheck <map.tmx> [map.tmx ...]
+ *
+ *            The maps are loaded one after the other through the level
+ *            manager, each one preloaded on the background thread while the
+ *            previous one is queried and animated, and compared to the same
+ *            map loaded with mapInit().  Run it with and without the compiled
+ *            maps (see tools/mapc.c) to check both loaders.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/level.h"
+#include "../src/map.h"
+
+/**
+ * @brief   Compare the tile layers of two TMX maps gid by gid.
+ * @return  0 if they match, -1 otherwise.
+ */
+static int8_t compareLayers(tmx_map *a, tmx_map *b)
+{
+    tmx_layer *la = a->ly_head;
+    tmx_layer *lb = b->ly_head;
+
+    for (; la && lb; la = la->next, lb = lb->next)
+    {
+        if (la->type != lb->type)
+        {
+            return -1;
+        }
+        if (L_LAYER != la->type)
+        {
+            continue;
+        }
+
+        for (uint32_t y = 0; y < a->height; y++)
+        {
+            for (uint32_t x = 0; x < a->width; x++)
+            {
+                if (tmx_get_layer_gid(a, la, x, y) != tmx_get_layer_gid(b, lb, x, y))
+                {
+                    return -1;
+                }
+            }
+        }
+    }
+
+    return (la || lb) ? -1 : 0;
+}
+
+/**
+ * @brief   Compare everything the game reads from two maps.
+ * @return  0 if they match, -1 otherwise.
+ */
+static int8_t compareMaps(Map *a, Map *b)
+{
+    uint32_t cells = a->map->width * a->map->height;
+
+    if ((a->width != b->width) || (a->height != b->height) || (a->map->tilecount != b->map->tilecount))
+    {
+        return -1;
+    }
+    if ((a->numAnimGids != b->numAnimGids) ||
+        (a->numAnimGids && memcmp(a->animGid, b->animGid, a->numAnimGids * sizeof(uint32_t))))
+    {
+        return -1;
+    }
+    if (memcmp(a->cellFlags, b->cellFlags, cells * sizeof(uint16_t)) ||
+        memcmp(a->cellProps, b->cellProps, cells * sizeof(uint16_t)))
+    {
+        return -1;
+    }
+    if ((a->numPropRows != b->numPropRows) || (a->numProps != b->numProps) ||
+        memcmp(a->propTable, b->propTable, a->numPropRows * MAX_TILE_PROPS * sizeof(double)))
+    {
+        return -1;
+    }
+
+    return compareLayers(a->map, b->map);
+}
+
+/**
+ * @brief   Load a map on its own and compare it to the one of the level
+ *          manager.
+ * @return  0 if they match, -1 otherwise.
+ */
+static int8_t checkMap(Map *map, const char *filename)
+{
+    Map    *reference = mapInit(NULL, filename);
+    int8_t result;
+
+    if (NULL == reference)
+    {
+        return -1;
+    }
+
+    result = compareMaps(map, reference);
+    if (-1 == result)
+    {
+        fprintf(stderr, "%s: mismatch between the level manager and mapInit().\n", filename);
+    }
+    mapFree(reference);
+
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    Level    *level;
+    Map      *map;
+    uint64_t queries = 0;
+    int      status  = EXIT_FAILURE;
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <map.tmx> [map.tmx ...]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // Without a renderer no images are loaded.
+    level = levelInit(NULL);
+    if (NULL == level)
+    {
+        return EXIT_FAILURE;
+    }
+
+    map = levelLoad(level, argv[1]);
+    if ((NULL == map) || (-1 == checkMap(map, argv[1])))
+    {
+        goto quit;
+    }
+
+    for (int i = 2; i < argc; i++)
+    {
+        if (-1 == levelPreload(level, argv[i]))
+        {
+            goto quit;
+        }
+
+        // The current map is played on while the next one is loaded.
+        while (0 == levelReady(level))
+        {
+            mapCoordFlags(map, (queries * 16) % map->width, (queries * 7) % map->height);
+            if (-1 == mapFrame(NULL, map, 0.001))
+            {
+                goto quit;
+            }
+            queries++;
+        }
+
+        Map *next = levelSwitch(level, argv[i]);
+        if (NULL == next)
+        {
+            goto quit;
+        }
+        mapFree(map);
+        map = next;
+
+        if (-1 == checkMap(map, argv[i]))
+        {
+            goto quit;
+        }
+    }
+
+    // A preload that is never switched to is dropped with the level manager.
+    if (-1 == levelPreload(level, argv[1]))
+    {
+        goto quit;
+    }
+
+    printf("%d map(s) checked, %llu queries during preloads.\n", argc - 1, (unsigned long long)queries);
+    status = EXIT_SUCCESS;
+
+    quit:
+    mapFree(map);
+    levelFree(level);
+
+    return status;
+}
@@ -0,0 +1,36 @@
+/** @file mapc.c
+ * @brief     Compile TMX maps into binary maps.  See @ref Map.
+ *
+ *            Usage: mapc <map.tmx> <map.tmb>
+ *
+ *            The tilesets are embedded and image paths are stored relative to
+ *            the map, so the compiled map has to be written next to the TMX
+ *            file.  mapInit() and mapInitShared() prefer it over the TMX file
+ *            if present; the latter takes the external tilesets from its
+ *            tileset manager.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../src/tmx/tmx.h"
+
+int main(int argc, char *argv[])
+{
+    if (argc != 3)
+    {
+        fprintf(stderr, "Usage: %s <map.tmx> <map.tmb>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (0 == tmx_compile(argv[1], argv[2]))
+    {
+        fprintf(stderr, "%s\n", tmx_strerr());
+        return EXIT_FAILURE;
+    }
+
+    printf("Compiled %s into %s.\n", argv[1], argv[2]);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,160 @@
+/** @file pack.c
+ * @brief     Pack files into an asset archive.  See @ref Archive.
+ *
+ *            Usage: pack <archive> <file>...
+ *
+ *            The paths are stored as given, so run it from the directory the
+ *            game is started from, e.g. `tools/pack res.pak $(find res -type f)`.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/archive.h"
+
+/**
+ * @brief   An archived file.
+ */
+typedef struct packEntry_t
+{
+    char     path[256];
+    uint32_t hash;
+    uint32_t pathOffset;
+    uint32_t offset;
+    uint32_t size;
+} PackEntry;
+
+/**
+ * @brief   Compare two entries by hash.  Used by qsort().
+ */
+static int packCompare(const void *a, const void *b)
+{
+    uint32_t x = ((const PackEntry*)a)->hash;
+    uint32_t y = ((const PackEntry*)b)->hash;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief   Write a little-endian 32-bit value.
+ */
+static void packWrite32(FILE *file, uint32_t value)
+{
+    uint8_t byte[4] =
+    {
+        value         & 0xff,
+        (value >>  8) & 0xff,
+        (value >> 16) & 0xff,
+        (value >> 24) & 0xff
+    };
+
+    fwrite(byte, 1, 4, file);
+}
+
+/**
+ * @brief   Pad the file with zeros to a multiple of ARCHIVE_ALIGN.
+ */
+static void packAlign(FILE *file)
+{
+    while (ftell(file) % ARCHIVE_ALIGN)
+    {
+        fputc(0, file);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t numEntries = argc - 2;
+
+    if (argc < 3)
+    {
+        fprintf(stderr, "Usage: %s <archive> <file>...\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    PackEntry *entry = calloc(numEntries, sizeof(struct packEntry_t));
+    if (NULL == entry)
+    {
+        fprintf(stderr, "Error allocating memory.\n");
+        return EXIT_FAILURE;
+    }
+
+    uint32_t offset = ARCHIVE_HEADER_SIZE + numEntries * ARCHIVE_ENTRY_SIZE;
+    for (uint32_t i = 0; i < numEntries; i++)
+    {
+        if (-1 == archiveNormalise(argv[i + 2], entry[i].path, sizeof(entry[i].path)))
+        {
+            fprintf(stderr, "Path too long: %s\n", argv[i + 2]);
+            return EXIT_FAILURE;
+        }
+        entry[i].hash       = archiveHash(entry[i].path);
+        entry[i].pathOffset = offset;
+        offset             += strlen(entry[i].path) + 1;
+    }
+    qsort(entry, numEntries, sizeof(struct packEntry_t), packCompare);
+
+    FILE *archive = fopen(argv[1], "wb");
+    if (NULL == archive)
+    {
+        fprintf(stderr, "Couldn't open %s.\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    // Data first; the header and index are written once all sizes are known.
+    fseek(archive, offset, SEEK_SET);
+    for (uint32_t i = 0; i < numEntries; i++)
+    {
+        packAlign(archive);
+        entry[i].offset = ftell(archive);
+
+        FILE *file = fopen(entry[i].path, "rb");
+        if (NULL == file)
+        {
+            fprintf(stderr, "Couldn't open %s.\n", entry[i].path);
+            fclose(archive);
+            return EXIT_FAILURE;
+        }
+
+        char   buffer[4096];
+        size_t length;
+        while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        {
+            fwrite(buffer, 1, length, archive);
+            entry[i].size += length;
+        }
+        fclose(file);
+    }
+
+    fseek(archive, 0, SEEK_SET);
+    fwrite("RJPK", 1, 4, archive);
+    packWrite32(archive, ARCHIVE_VERSION);
+    packWrite32(archive, numEntries);
+    packWrite32(archive, numEntries * ARCHIVE_ENTRY_SIZE);
+    for (uint32_t i = 0; i < numEntries; i++)
+    {
+        packWrite32(archive, entry[i].hash);
+        packWrite32(archive, entry[i].pathOffset);
+        packWrite32(archive, entry[i].offset);
+        packWrite32(archive, entry[i].size);
+    }
+
+    for (uint32_t i = 0; i < numEntries; i++)
+    {
+        fseek(archive, entry[i].pathOffset, SEEK_SET);
+        fwrite(entry[i].path, 1, strlen(entry[i].path) + 1, archive);
+    }
+
+    if (0 != fclose(archive))
+    {
+        fprintf(stderr, "Error writing %s.\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    printf("Packed %u files into %s.\n", numEntries, argv[1]);
+    free(entry);
+
+    return EXIT_SUCCESS;
+}